@@ -7,14 +7,15 @@
 #include "bg_operators.hpp"
 #include "bg_helpers.hpp"
 
+#include <cmath>
+#include <utility>
+
 namespace bg_helpers {
 
 // The below implementations of buffer are similar to bg::buffer but
 // always convert to floating-point before doing work, if needed, and
 // convert back afterward, if needed.  Also, they work if expand_by is
 // 0, unlike bg::buffer.
-const int points_per_circle = 32;
-
 multi_polygon_type_fp buffer(multi_polygon_type_fp const & geometry_in, coordinate_type_fp expand_by) {
   if (expand_by == 0 || geometry_in.size() == 0) {
     return geometry_in;
@@ -64,7 +65,8 @@ multi_polygon_type_fp buffer_miter(polygon_type_fp const & geometry_in, Coordina
 }
 
 template<typename CoordinateType>
-multi_polygon_type_fp buffer(linestring_type_fp const & geometry_in, CoordinateType expand_by) {
+multi_polygon_type_fp buffer(linestring_type_fp const & geometry_in, CoordinateType expand_by,
+                             unsigned int circle_points) {
   if (expand_by == 0) {
     return {};
   }
@@ -72,21 +74,22 @@ multi_polygon_type_fp buffer(linestring_type_fp const & geometry_in, CoordinateT
   auto geos_in = to_geos(geometry_in);
   return from_geos<multi_polygon_type_fp>(
       std::unique_ptr<geos::geom::Geometry>(
-          geos::operation::buffer::BufferOp::bufferOp(geos_in.get(), expand_by, points_per_circle/4)));
+          geos::operation::buffer::BufferOp::bufferOp(geos_in.get(), expand_by, circle_points/4)));
 #else
   multi_polygon_type_fp geometry_out;
   bg::buffer(geometry_in, geometry_out,
              bg::strategy::buffer::distance_symmetric<coordinate_type_fp>(expand_by),
              bg::strategy::buffer::side_straight(),
-             bg::strategy::buffer::join_round(points_per_circle),
-             bg::strategy::buffer::end_round(points_per_circle),
-             bg::strategy::buffer::point_circle(points_per_circle));
+             bg::strategy::buffer::join_round(circle_points),
+             bg::strategy::buffer::end_round(circle_points),
+             bg::strategy::buffer::point_circle(circle_points));
   return geometry_out;
 #endif
 }
 
 template<typename CoordinateType>
-multi_polygon_type_fp buffer(multi_linestring_type_fp const & geometry_in, CoordinateType expand_by) {
+multi_polygon_type_fp buffer(multi_linestring_type_fp const & geometry_in, CoordinateType expand_by,
+                             unsigned int circle_points) {
   if (expand_by == 0 || geometry_in.size() == 0) {
     return {};
   }
@@ -97,20 +100,20 @@ multi_polygon_type_fp buffer(multi_linestring_type_fp const & geometry_in, Coord
   auto geos_in = to_geos(mls);
   return from_geos<multi_polygon_type_fp>(
       std::unique_ptr<geos::geom::Geometry>(
-          geos::operation::buffer::BufferOp::bufferOp(geos_in.get(), expand_by, points_per_circle/4)));
+          geos::operation::buffer::BufferOp::bufferOp(geos_in.get(), expand_by, circle_points/4)));
 #else
   if (expand_by == 0) {
     return {};
   }
   multi_polygon_type_fp ret;
   for (const auto& ls : mls) {
-    ret = ret + buffer(ls, expand_by);
+    ret = ret + buffer(ls, expand_by, circle_points);
   }
   return ret;
 #endif
 }
 
-template multi_polygon_type_fp buffer(const multi_linestring_type_fp&, double expand_by);
+template multi_polygon_type_fp buffer(const multi_linestring_type_fp&, double expand_by, unsigned int);
 
 template<typename CoordinateType>
 multi_polygon_type_fp buffer_miter(ring_type_fp const & geometry_in, CoordinateType expand_by) {
@@ -119,4 +122,42 @@ multi_polygon_type_fp buffer_miter(ring_type_fp const & geometry_in, CoordinateT
 
 template multi_polygon_type_fp buffer_miter(ring_type_fp const&, double);
 
+Offsets::Offsets(const multi_polygon_type_fp& mpoly,
+                 std::vector<boost::optional<coordinate_type_fp>> distances,
+                 bool incremental, coordinate_type_fp tolerance) :
+    mpoly(mpoly),
+    distances(std::move(distances)),
+    incremental(incremental),
+    tolerance(tolerance),
+    buffered(this->distances.size()) {}
+
+const multi_polygon_type_fp& Offsets::get(size_t i) {
+  if (!buffered[i]) {
+    const coordinate_type_fp distance = *distances[i];
+    boost::optional<size_t> base;
+    if (incremental) {
+      for (size_t j = 0; j < distances.size(); j++) {
+        if (distances[j] &&
+            ((0 < *distances[j] && *distances[j] < distance) ||
+             (distance < *distances[j] && *distances[j] < 0)) &&
+            (!base || std::abs(*distances[*base]) < std::abs(*distances[j]))) {
+          base = j;
+        }
+      }
+    }
+    if (base) {
+      // Each step rounds more corners, adding points that barely
+      // change the shape, so simplify before buffering again.  The
+      // errors add up along the chain so each step gets a part of the
+      // tolerance.
+      multi_polygon_type_fp simplified;
+      bg::simplify(get(*base), simplified, tolerance / distances.size());
+      buffered[i] = buffer(simplified, distance - *distances[*base]);
+    } else {
+      buffered[i] = buffer(mpoly, distance);
+    }
+  }
+  return *buffered[i];
+}
+
 } // namespace bg_helpers
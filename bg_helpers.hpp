@@ -1,11 +1,18 @@
 #ifndef BG_HELPERS_HPP
 #define BG_HELPERS_HPP
 
-#include "eulerian_paths.hpp"
+#include <vector>
+
 #include <boost/functional/hash/hash.hpp>
+#include <boost/optional.hpp>
+
+#include "eulerian_paths.hpp"
 
 namespace bg_helpers {
 
+// The number of points used for a full circle when rounding corners.
+const unsigned int points_per_circle = 32;
+
 // The below implementations of buffer are similar to bg::buffer but
 // always convert to floating-point before doing work, if needed, and
 // convert back afterward, if needed.  Also, they work if expand_by is
@@ -18,7 +25,8 @@ template<typename CoordinateType>
 multi_polygon_type_fp buffer(polygon_type_fp const & geometry_in, CoordinateType expand_by);
 
 template<typename CoordinateType>
-multi_polygon_type_fp buffer(multi_linestring_type_fp const & geometry_in, CoordinateType expand_by);
+multi_polygon_type_fp buffer(multi_linestring_type_fp const & geometry_in, CoordinateType expand_by,
+                             unsigned int circle_points = points_per_circle);
 
 template<typename CoordinateType>
 multi_polygon_type_fp buffer(ring_type_fp const & geometry_in, CoordinateType expand_by);
@@ -26,6 +34,30 @@ multi_polygon_type_fp buffer(ring_type_fp const & geometry_in, CoordinateType ex
 template<typename CoordinateType>
 multi_polygon_type_fp buffer_miter(ring_type_fp const & geometry_in, CoordinateType expand_by);
 
+// A shape buffered by each of a list of distances, made when each one
+// is first needed.  Distances that are none are never needed.  Growing
+// a shape by a and then by b is the same as growing it by a+b, and the
+// same for shrinking, so with incremental each one is made by buffering
+// the one nearest to it that is on the same side of the shape and
+// closer to it.  That is much cheaper than buffering the original once
+// the passes have rounded off its detail.  Each of those is simplified
+// first, by a share of the tolerance, so that the result is within
+// tolerance of buffering the original shape.
+class Offsets {
+ public:
+  Offsets(const multi_polygon_type_fp& mpoly,
+          std::vector<boost::optional<coordinate_type_fp>> distances,
+          bool incremental, coordinate_type_fp tolerance);
+  const multi_polygon_type_fp& get(size_t i);
+
+ private:
+  const multi_polygon_type_fp& mpoly;
+  const std::vector<boost::optional<coordinate_type_fp>> distances;
+  const bool incremental;
+  const coordinate_type_fp tolerance;
+  std::vector<boost::optional<multi_polygon_type_fp>> buffered;
+};
+
 } // namespace bg_helpers
 
 #endif //BG_HELPERS_HPP
@@ -0,0 +1,109 @@
+#define BOOST_TEST_MODULE bg helpers tests
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <boost/optional.hpp>
+
+#include "geometry.hpp"
+#include "bg_helpers.hpp"
+#include "bg_operators.hpp"
+
+using std::vector;
+using boost::optional;
+using namespace bg_helpers;
+
+// The furthest that a vertex of either shape is from the boundary of
+// the other.
+coordinate_type_fp max_deviation(const multi_polygon_type_fp& a, const multi_polygon_type_fp& b) {
+  const auto boundary = [](const multi_polygon_type_fp& mpoly) {
+    multi_linestring_type_fp ret;
+    for (const auto& poly : mpoly) {
+      ret.emplace_back(poly.outer().cbegin(), poly.outer().cend());
+      for (const auto& inner : poly.inners()) {
+        ret.emplace_back(inner.cbegin(), inner.cend());
+      }
+    }
+    return ret;
+  };
+  const auto a_boundary = boundary(a);
+  const auto b_boundary = boundary(b);
+  coordinate_type_fp ret = 0;
+  for (const auto& ls : a_boundary) {
+    for (const auto& p : ls) {
+      ret = std::max(ret, bg::distance(p, b_boundary));
+    }
+  }
+  for (const auto& ls : b_boundary) {
+    for (const auto& p : ls) {
+      ret = std::max(ret, bg::distance(p, a_boundary));
+    }
+  }
+  return ret;
+}
+
+// Each incremental offset must be within tolerance of buffering the
+// original shape by the same distance.
+void check_offsets(const multi_polygon_type_fp& mpoly, const vector<optional<coordinate_type_fp>>& distances,
+                   coordinate_type_fp tolerance) {
+  Offsets direct(mpoly, distances, false, tolerance);
+  Offsets incremental(mpoly, distances, true, tolerance);
+  for (size_t i = 0; i < distances.size(); i++) {
+    if (!distances[i]) {
+      continue;
+    }
+    const auto& expected = direct.get(i);
+    const auto& actual = incremental.get(i);
+    BOOST_CHECK_LE(max_deviation(expected, actual), tolerance);
+    // On average, the outlines are much closer than that.
+    BOOST_CHECK_LE(bg::area(expected ^ actual), bg::perimeter(expected) * tolerance / 4);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE(bg_helpers_tests)
+
+// 12 isolation passes of a 10 mil tool that overlap by 2 mils.
+vector<optional<coordinate_type_fp>> growing_passes() {
+  vector<optional<coordinate_type_fp>> ret;
+  for (int i = 0; i < 12; i++) {
+    ret.push_back(0.005 + 0.008 * i);
+  }
+  return ret;
+}
+
+// The same passes from a voronoi cell inwards, with a step that isn't
+// needed.
+vector<optional<coordinate_type_fp>> shrinking_passes() {
+  vector<optional<coordinate_type_fp>> ret{boost::none};
+  for (int i = 0; i < 12; i++) {
+    ret.push_back(-0.008 * i);
+  }
+  return ret;
+}
+
+BOOST_AUTO_TEST_CASE(convex_offsets) {
+  multi_polygon_type_fp trace;
+  bg::read_wkt("MULTIPOLYGON(((0 0,0 0.05,0.5 0.05,0.55 0.02,0.5 0,0 0)))", trace);
+  check_offsets(trace, growing_passes(), 0.001);
+  multi_polygon_type_fp cell;
+  bg::read_wkt("MULTIPOLYGON(((-0.3 -0.3,-0.3 0.35,0.9 0.4,1 -0.2,-0.3 -0.3)))", cell);
+  check_offsets(cell, shrinking_passes(), 0.001);
+}
+
+BOOST_AUTO_TEST_CASE(concave_offsets) {
+  // A comb with teeth closer than the passes, so they merge.
+  multi_polygon_type_fp trace;
+  bg::read_wkt("MULTIPOLYGON(((0 0,0 0.3,0.02 0.3,0.02 0.05,0.06 0.05,0.06 0.3,0.08 0.3,"
+               "0.08 0.05,0.12 0.05,0.12 0.3,0.14 0.3,0.14 0.05,0.5 0.05,0.5 0,0 0),"
+               "(0.3 0.01,0.3 0.04,0.4 0.04,0.4 0.01,0.3 0.01)))", trace);
+  check_offsets(trace, growing_passes(), 0.001);
+  // A cell with a notch and a hole, which split apart as they shrink.
+  multi_polygon_type_fp cell;
+  bg::read_wkt("MULTIPOLYGON(((0 0,0 0.5,0.2 0.5,0.2 0.1,0.3 0.1,0.3 0.5,0.6 0.5,0.6 0,0 0),"
+               "(0.4 0.2,0.5 0.2,0.5 0.3,0.4 0.3,0.4 0.2)))", cell);
+  check_offsets(cell, shrinking_passes(), 0.001);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
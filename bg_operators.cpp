@@ -1,6 +1,7 @@
 #include "geometry.hpp"
 #include "geometry_int.hpp"
 #include "bg_helpers.hpp"
+#include "cascaded_union.hpp"
 #ifdef GEOS_VERSION
 #include <geos/operation/union/CascadedUnion.h>
 #include <geos/util/TopologyException.h>
@@ -175,49 +176,6 @@ bg::model::multi_polygon<polygon_type_t> operator+(const bg::model::multi_polygo
 
 template multi_polygon_type_fp operator+(const multi_polygon_type_fp&, const multi_polygon_type_fp&);
 
-template <typename Addition>
-multi_polygon_type_fp reduce(const std::vector<multi_polygon_type_fp>& mpolys,
-                             const Addition& adder,
-                             const std::vector<box_type_fp>& bboxes) {
-  if (mpolys.size() == 0) {
-    return multi_polygon_type_fp();
-  } else if (mpolys.size() == 1) {
-    return mpolys.front();
-  }
-  size_t current = 0;
-  std::vector<multi_polygon_type_fp> new_mpolys;
-  std::vector<box_type_fp> new_bboxes;
-  if (mpolys.size() % 2 == 1) {
-    new_mpolys.push_back(mpolys[current]);
-    new_bboxes.push_back(bboxes[current]);
-    current++;
-  }
-  // There are at least two and the total number is even.
-  for (; current < mpolys.size(); current += 2) {
-    box_type_fp new_bbox = bboxes[current];
-    bg::expand(new_bbox, bboxes[current+1]);
-    new_bboxes.push_back(new_bbox);
-    if (!bg::intersects(bboxes[current], bboxes[current+1])) {
-      new_mpolys.push_back(mpolys[current]);
-      new_mpolys.back().insert(new_mpolys.back().cend(), mpolys[current+1].cbegin(), mpolys[current+1].cend());
-    } else {
-      new_mpolys.push_back(adder(mpolys[current], mpolys[current+1]));
-    }
-  }
-  return reduce(new_mpolys, adder, new_bboxes);
-}
-
-template <typename Addition>
-multi_polygon_type_fp reduce(const std::vector<multi_polygon_type_fp>& mpolys,
-                             const Addition& adder) {
-  std::vector<box_type_fp> bboxes;
-  bboxes.reserve(mpolys.size());
-  for (const auto& mpoly : mpolys) {
-    bboxes.push_back(bg::return_envelope<box_type_fp>(mpoly));
-  }
-  return reduce(mpolys, adder, bboxes);
-}
-
 void round(ring_type_fp& ring) {
   for (auto& point : ring) {
     point.x(std::round(point.x() * 1e10)/1e10);
@@ -238,50 +196,48 @@ void round(multi_polygon_type_fp& mp) {
   }
 }
 
-multi_polygon_type_fp sum(const std::vector<multi_polygon_type_fp>& mpolys) {
+multi_polygon_type_fp sum(std::vector<multi_polygon_type_fp> mpolys) {
   if (mpolys.size() == 0) {
     return {};
   } else if (mpolys.size() == 1) {
-    return mpolys[0];
+    return std::move(mpolys[0]);
   }
 #ifdef GEOS_VERSION
+  // GEOS has its own cascaded union, which is what this always used, so
+  // GEOS builds keep it and its output.
   std::vector<geos::geom::Geometry*> geos_mpolys;
   std::vector<std::unique_ptr<geos::geom::Geometry>> geos_mpolys_tmp;
-  for (const auto& mpoly : mpolys) {
+  for (auto& mpoly : mpolys) {
     if (bg::area(mpoly) == 0) {
       continue;
     }
-    auto mpoly_temp = mpoly;
-    round(mpoly_temp);
-    geos_mpolys_tmp.push_back(to_geos(mpoly_temp));
+    round(mpoly);
+    geos_mpolys_tmp.push_back(to_geos(mpoly));
     geos_mpolys.push_back(geos_mpolys_tmp.back().get());
   }
   if (geos_mpolys.size() == 0) {
     return {};
   }
   try {
+    const auto start = std::chrono::steady_clock::now();
     std::unique_ptr<geos::geom::Geometry> geos_out(
         geos::operation::geounion::CascadedUnion::Union(&geos_mpolys));
+    cascaded_union::stats().add(geos_mpolys.size() - 1, std::chrono::steady_clock::now() - start);
     return from_geos<multi_polygon_type_fp>(geos_out);
   } catch (const geos::util::TopologyException& e) {
     std::cerr << "\nError: Internal error with libgeos.  Upgrading geos may help." << std::endl;
     throw;
   }
 #else // !GEOS_VERSION
-  return reduce(mpolys, operator+<polygon_type_fp, multi_polygon_type_fp>);
+  return cascaded_union::reduce(std::move(mpolys), operator+<polygon_type_fp, multi_polygon_type_fp>);
 #endif // GEOS_VERSION
 }
 
-multi_polygon_type_fp symdiff(const std::vector<multi_polygon_type_fp>& mpolys) {
+multi_polygon_type_fp symdiff(std::vector<multi_polygon_type_fp> mpolys) {
   if (mpolys.size() == 0) {
     return multi_polygon_type_fp();
   } else if (mpolys.size() == 1) {
-    return mpolys[0];
-  }
-  std::vector<box_type_fp> bboxes;
-  bboxes.reserve(mpolys.size());
-  for (const auto& mpoly : mpolys) {
-    bboxes.push_back(bg::return_envelope<box_type_fp>(mpoly));
+    return std::move(mpolys[0]);
   }
-  return reduce(mpolys, operator^<polygon_type_fp>);
+  return cascaded_union::reduce(std::move(mpolys), operator^<polygon_type_fp>);
 }
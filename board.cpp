@@ -36,7 +36,11 @@ using std::pair;
 #include <vector>
 using std::vector;
 
+#include <boost/optional.hpp>
+using boost::optional;
+
 #include "bg_operators.hpp"
+#include "thread_pool.hpp"
 
 typedef pair<string, shared_ptr<Layer> > layer_t;
 
@@ -46,14 +50,19 @@ typedef pair<string, shared_ptr<Layer> > layer_t;
 /******************************************************************************/
 Board::Board(bool fill_outline, string outputdir, bool tsp_2opt,
              MillFeedDirection::MillFeedDirection mill_feed_direction, bool invert_gerbers,
-             bool render_paths_to_shapes) :
+             bool render_paths_to_shapes, bool adaptive_tessellation,
+             bool check_self_intersections,
+             DebugImages::DebugImages debug_images) :
     margin(0.0),
     fill_outline(fill_outline),
     outputdir(outputdir),
     tsp_2opt(tsp_2opt),
     mill_feed_direction(mill_feed_direction),
     invert_gerbers(invert_gerbers),
-    render_paths_to_shapes(render_paths_to_shapes) {}
+    render_paths_to_shapes(render_paths_to_shapes),
+    adaptive_tessellation(adaptive_tessellation),
+    check_self_intersections(check_self_intersections),
+    debug_images(debug_images) {}
 
 double Board::get_width() {
   if (layers.size() < 1) {
@@ -74,6 +83,28 @@ void Board::prepareLayer(string layername, shared_ptr<GerberImporter> importer,
   prepared_layers.insert(std::make_pair(layername, make_tuple(importer, manufacturer, backside, ymirror)));
 }
 
+// How far the isolation might reach beyond the copper.
+coordinate_type_fp Board::isolation_margin(shared_ptr<RoutingMill> mill) const {
+  shared_ptr<Isolator> trace_mill = static_pointer_cast<Isolator>(mill);
+  coordinate_type_fp margin = 0;
+  for (const auto& tool : trace_mill->tool_diameters_and_overlap_widths) {
+    // Testing showed that 2 was not enough by 3 and above remove all
+    // the small connecting lines that would potentially be created.
+    double extra_passes_margin = trace_mill->tolerance * 3;
+    if (!invert_gerbers) {
+      auto tool_diameter = tool.first;
+      auto overlap_width = tool.second;
+      auto extra_passes = std::max(
+          int(std::ceil((trace_mill->isolation_width - tool_diameter) / (tool_diameter - overlap_width))),
+          trace_mill->extra_passes);
+      // Figure out how much margin the extra passes might make.
+      extra_passes_margin = tool_diameter + (tool_diameter - overlap_width) * extra_passes;
+    }
+    margin = std::max(margin, extra_passes_margin + trace_mill->offset);
+  }
+  return margin;
+}
+
 /******************************************************************************/
 /*
  */
@@ -98,55 +129,71 @@ void Board::createLayers()
       for (const auto& layer_name : std::vector<std::string>{"front", "back"}) {
         const auto current_layer = prepared_layers.find(layer_name);
         if (current_layer != prepared_layers.cend()) {
-          shared_ptr<Isolator> trace_mill = static_pointer_cast<Isolator>(get<1>(current_layer->second));
           const auto& importer = get<0>(current_layer->second);
-          for (const auto& tool : trace_mill->tool_diameters_and_overlap_widths) {
-            // Testing showed that 2 was not enough by 3 and above remove all
-            // the small connecting lines that would potentially be created.
-            double extra_passes_margin = trace_mill->tolerance * 3;
-            if (!invert_gerbers) {
-              auto tool_diameter = tool.first;
-              auto overlap_width = tool.second;
-              auto extra_passes = std::max(
-                  int(std::ceil((trace_mill->isolation_width - tool_diameter) / (tool_diameter - overlap_width))),
-                  trace_mill->extra_passes);
-              // Figure out how much margin the extra passes might make.
-              extra_passes_margin = tool_diameter + (tool_diameter - overlap_width) * extra_passes;
-            }
-            auto current_bounding_box = bg::return_buffer<box_type_fp>(importer->get_bounding_box(), extra_passes_margin + trace_mill->offset);
-            bg::expand(bounding_box, current_bounding_box);
-          }
+          auto current_bounding_box = bg::return_buffer<box_type_fp>(importer->get_bounding_box(),
+                                                                     isolation_margin(get<1>(current_layer->second)));
+          bg::expand(bounding_box, current_bounding_box);
         }
       }
     }
 
-    // board size calculated. create layers
-    for (const auto& prepared_layer : prepared_layers) {
-      // prepare the surface
-      shared_ptr<GerberImporter> importer = get<0>(prepared_layer.second);
-      const bool fill = fill_outline && prepared_layer.first == "outline";
-
-      auto surface = make_shared<Surface_vectorial>(
-          30,
-          bounding_box,
-          prepared_layer.first, outputdir, tsp_2opt,
-          mill_feed_direction, invert_gerbers,
-          render_paths_to_shapes || (prepared_layer.first == "outline"));
-      if (fill) {
-        surface->enable_filling();
+    // Copper outside of the outline is masked away after rendering.  Drop
+    // it as soon as it is rendered so that it doesn't slow down the
+    // validity check, the simplification and the masking.  Keep some
+    // margin so that nothing near the outline changes.
+    optional<box_type_fp> crop;
+    if (outline != prepared_layers.cend() &&
+        (get<0>(outline->second)->get_bounding_box().min_corner() <
+         get<0>(outline->second)->get_bounding_box().max_corner())) {
+      coordinate_type_fp margin = 0;
+      for (const auto& layer_name : std::vector<std::string>{"front", "back"}) {
+        const auto current_layer = prepared_layers.find(layer_name);
+        if (current_layer != prepared_layers.cend()) {
+          margin = std::max(margin, isolation_margin(get<1>(current_layer->second)));
+        }
       }
-      surface->render(importer, get<1>(prepared_layer.second)->optimise);
-      auto layer = make_shared<Layer>(prepared_layer.first,
-                                      surface,
-                                      get<1>(prepared_layer.second),
-                                      get<2>(prepared_layer.second),
-                                      get<3>(prepared_layer.second)); // see comment for prep_t in board.hpp
+      crop = bg::return_buffer<box_type_fp>(get<0>(outline->second)->get_bounding_box(), margin);
+    }
+
+    // board size calculated. create layers.  The layers are independent
+    // until they are masked by the outline so render them all at once.
+    const vector<pair<string, prep_t>> to_create(prepared_layers.cbegin(), prepared_layers.cend());
+    const auto created_layers = thread_pool::parallel_map(
+        to_create,
+        [&](const pair<string, prep_t>& prepared_layer) {
+          // prepare the surface
+          shared_ptr<GerberImporter> importer = get<0>(prepared_layer.second);
+          const bool fill = fill_outline && prepared_layer.first == "outline";
+
+          const auto mill = get<1>(prepared_layer.second);
+          auto surface = make_shared<Surface_vectorial>(
+              tessellation::Tessellation(30, adaptive_tessellation ? mill->tolerance : 0),
+              bounding_box,
+              prepared_layer.first, outputdir, tsp_2opt,
+              mill_feed_direction, invert_gerbers,
+              render_paths_to_shapes || (prepared_layer.first == "outline"),
+              debug_images);
+          if (fill) {
+            surface->enable_filling();
+          }
+          surface->render(importer, mill->optimise, check_self_intersections,
+                          prepared_layer.first == "outline" ? boost::none : crop);
+          return make_shared<Layer>(prepared_layer.first,
+                                    surface,
+                                    get<1>(prepared_layer.second),
+                                    get<2>(prepared_layer.second),
+                                    get<3>(prepared_layer.second)); // see comment for prep_t in board.hpp
+        });
+    // All the layers are done before masking.
+    for (const auto& layer : created_layers) {
       layers.insert(std::make_pair(layer->get_name(), layer));
     }
 
     // DEBUG output
-    for (layer_t layer : layers) {
-      layer.second->surface->save_debug_image(string("original_") + layer.second->get_name());
+    if (debug_images != DebugImages::NONE) {
+      for (layer_t layer : layers) {
+        layer.second->surface->save_debug_image(string("original_") + layer.second->get_name());
+      }
     }
 
     // mask layers with outline
@@ -158,7 +205,9 @@ void Board::createLayers()
       for (const auto& layer : layers) {
         if (layer.second != outline_layer) {
           layer.second->add_mask(outline_layer);
-          layer.second->surface->save_debug_image(string("masked_") + layer.second->get_name());
+          if (debug_images == DebugImages::FULL) {
+            layer.second->surface->save_debug_image(string("masked_") + layer.second->get_name());
+          }
         }
       }
     }
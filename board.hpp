@@ -52,7 +52,9 @@ public:
     Board(bool fill_outline,
           std::string outputdir, bool tsp_2opt,
           MillFeedDirection::MillFeedDirection mill_feed_direction, bool invert_gerbers,
-          bool render_paths_to_shapes);
+          bool render_paths_to_shapes, bool adaptive_tessellation,
+          bool check_self_intersections,
+          DebugImages::DebugImages debug_images);
 
     void prepareLayer(std::string layername, std::shared_ptr<GerberImporter> importer,
                       std::shared_ptr<RoutingMill> manufacturer, bool backside, bool ymirror);
@@ -69,6 +71,8 @@ public:
     void createLayers(); // should be private
 
 private:
+    coordinate_type_fp isolation_margin(std::shared_ptr<RoutingMill> mill) const;
+
     coordinate_type_fp margin;
     const bool fill_outline;
     const std::string outputdir;
@@ -76,6 +80,11 @@ private:
     const MillFeedDirection::MillFeedDirection mill_feed_direction;
     const bool invert_gerbers;
     const bool render_paths_to_shapes;
+    // If set, circles get as many points as the mill's tolerance needs
+    // instead of a fixed number.
+    const bool adaptive_tessellation;
+    const bool check_self_intersections;
+    const DebugImages::DebugImages debug_images;
 
     box_type_fp bounding_box{{INFINITY, INFINITY}, {-INFINITY, -INFINITY}};
 
@@ -0,0 +1,102 @@
+#ifndef CASCADED_UNION_HPP
+#define CASCADED_UNION_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "geometry.hpp"
+#include "thread_pool.hpp"
+
+// Combine many multipolygons with a binary operation, like union or
+// symmetric difference, by merging them pairwise in a balanced tree.
+// Merging a small shape into a large, growing shape over and over is
+// quadratic.  The tree keeps the two sides of each merge similar in
+// size.  The tree is the same one that the serial merge always used:
+// neighbors in the input are merged and an odd one out at the front
+// moves up a level untouched.  All the merges on one level of the tree
+// are independent so they are run in parallel.  Each merge gets the
+// same inputs as in the serial merge so the output is identical, no
+// matter how many threads are used.
+namespace cascaded_union {
+
+// Counters for how much work the merging did, for reporting.
+struct Stats {
+  std::atomic<size_t> calls{0};
+  std::atomic<uint64_t> nanoseconds{0};
+  double seconds() const { return nanoseconds / 1e9; }
+  void add(size_t more_calls, std::chrono::steady_clock::duration duration) {
+    calls += more_calls;
+    nanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+  }
+  void reset() {
+    calls = 0;
+    nanoseconds = 0;
+  }
+};
+
+inline Stats& stats() {
+  static Stats stats;
+  return stats;
+}
+
+// Merge all of mpolys with the binary operation.  If the bounding
+// boxes of two shapes don't intersect, disjoint_merge is used instead
+// of the operation to simply put the polygons together.  It must only
+// be true for operations where that is correct, like union and
+// symmetric difference.  mpolys is taken by value so that callers
+// that are done with their shapes can move them in without a copy.
+template <typename Operation>
+multi_polygon_type_fp reduce(std::vector<multi_polygon_type_fp> mpolys,
+                             const Operation& operation,
+                             bool disjoint_merge = true) {
+  if (mpolys.size() == 0) {
+    return {};
+  }
+  std::vector<multi_polygon_type_fp> current;
+  current.swap(mpolys);
+  std::vector<box_type_fp> bboxes;
+  bboxes.reserve(current.size());
+  for (const auto& mpoly : current) {
+    bboxes.push_back(bg::return_envelope<box_type_fp>(mpoly));
+  }
+  while (current.size() > 1) {
+    // The odd one out is the first one.
+    const size_t odd = current.size() % 2;
+    const size_t pairs = current.size() / 2;
+    std::vector<multi_polygon_type_fp> next(odd + pairs);
+    std::vector<box_type_fp> next_bboxes(next.size());
+    if (odd) {
+      next.front().swap(current.front());
+      next_bboxes.front() = bboxes.front();
+    }
+    thread_pool::parallel_for(pairs, [&](size_t i) {
+      auto& lhs = current[odd + 2*i];
+      auto& rhs = current[odd + 2*i + 1];
+      const auto& lhs_bbox = bboxes[odd + 2*i];
+      const auto& rhs_bbox = bboxes[odd + 2*i + 1];
+      auto& out = next[odd + i];
+      next_bboxes[odd + i] = lhs_bbox;
+      bg::expand(next_bboxes[odd + i], rhs_bbox);
+      if (disjoint_merge && !bg::intersects(lhs_bbox, rhs_bbox)) {
+        out.swap(lhs);
+        out.insert(out.cend(), rhs.cbegin(), rhs.cend());
+      } else {
+        const auto start = std::chrono::steady_clock::now();
+        out = operation(lhs, rhs);
+        stats().add(1, std::chrono::steady_clock::now() - start);
+      }
+      multi_polygon_type_fp().swap(lhs);
+      multi_polygon_type_fp().swap(rhs);
+    });
+    current.swap(next);
+    bboxes.swap(next_bboxes);
+  }
+  return std::move(current.front());
+}
+
+} // namespace cascaded_union
+
+#endif // CASCADED_UNION_HPP
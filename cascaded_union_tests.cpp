@@ -0,0 +1,136 @@
+#define BOOST_TEST_MODULE cascaded union tests
+#include <boost/test/unit_test.hpp>
+
+#include <iomanip>
+#include <sstream>
+
+#include "geometry.hpp"
+#include "bg_operators.hpp"
+#include "cascaded_union.hpp"
+
+using namespace cascaded_union;
+
+multi_polygon_type_fp square(double x, double y, double size) {
+  box_type_fp box(point_type_fp(x, y), point_type_fp(x + size, y + size));
+  multi_polygon_type_fp ret;
+  bg::convert(box, ret);
+  return ret;
+}
+
+std::vector<multi_polygon_type_fp> grid(size_t n, double spacing) {
+  std::vector<multi_polygon_type_fp> ret;
+  for (size_t i = 0; i < n; i++) {
+    for (size_t j = 0; j < n; j++) {
+      ret.push_back(square(i * spacing, j * spacing, 1));
+    }
+  }
+  return ret;
+}
+
+std::string to_wkt(const multi_polygon_type_fp& mpoly) {
+  // Enough digits to tell apart any two doubles.
+  std::ostringstream out;
+  out << std::setprecision(17) << bg::wkt(mpoly);
+  return out.str();
+}
+
+// The merge that sum did before it ran in parallel, one level of the
+// tree at a time.
+multi_polygon_type_fp serial_reduce(const std::vector<multi_polygon_type_fp>& mpolys,
+                                    const std::vector<box_type_fp>& bboxes) {
+  if (mpolys.size() == 0) {
+    return multi_polygon_type_fp();
+  } else if (mpolys.size() == 1) {
+    return mpolys.front();
+  }
+  size_t current = 0;
+  std::vector<multi_polygon_type_fp> new_mpolys;
+  std::vector<box_type_fp> new_bboxes;
+  if (mpolys.size() % 2 == 1) {
+    new_mpolys.push_back(mpolys[current]);
+    new_bboxes.push_back(bboxes[current]);
+    current++;
+  }
+  for (; current < mpolys.size(); current += 2) {
+    box_type_fp new_bbox = bboxes[current];
+    bg::expand(new_bbox, bboxes[current+1]);
+    new_bboxes.push_back(new_bbox);
+    if (!bg::intersects(bboxes[current], bboxes[current+1])) {
+      new_mpolys.push_back(mpolys[current]);
+      new_mpolys.back().insert(new_mpolys.back().cend(), mpolys[current+1].cbegin(), mpolys[current+1].cend());
+    } else {
+      new_mpolys.push_back(mpolys[current] + mpolys[current+1]);
+    }
+  }
+  return serial_reduce(new_mpolys, new_bboxes);
+}
+
+BOOST_AUTO_TEST_SUITE(cascaded_union_tests)
+
+BOOST_AUTO_TEST_CASE(empty) {
+  BOOST_CHECK(sum(std::vector<multi_polygon_type_fp>()).empty());
+  BOOST_CHECK(sum(std::vector<multi_polygon_type_fp>(3)).empty());
+}
+
+BOOST_AUTO_TEST_CASE(overlapping_union) {
+  thread_pool::set_jobs(4);
+  // Squares of size 1 every 0.5 overlap into one 10.5x10.5 square.
+  const auto result = sum(grid(20, 0.5));
+  BOOST_CHECK_EQUAL(result.size(), 1);
+  BOOST_CHECK_CLOSE(bg::area(result), 10.5 * 10.5, 1e-3);
+}
+
+BOOST_AUTO_TEST_CASE(disjoint_union) {
+  thread_pool::set_jobs(4);
+  const auto result = sum(grid(10, 2));
+  BOOST_CHECK_EQUAL(result.size(), 100);
+  BOOST_CHECK_CLOSE(bg::area(result), 100, 1e-6);
+}
+
+BOOST_AUTO_TEST_CASE(deterministic) {
+  const auto inputs = grid(16, 0.75);
+  thread_pool::set_jobs(1);
+  const auto serial = to_wkt(sum(inputs));
+  thread_pool::set_jobs(4);
+  for (int i = 0; i < 3; i++) {
+    BOOST_CHECK_EQUAL(to_wkt(sum(inputs)), serial);
+  }
+}
+
+// The output must be the same, to the bit, as the serial merge.
+BOOST_AUTO_TEST_CASE(same_as_serial) {
+  for (size_t n : {1, 2, 5, 13}) {
+    for (double spacing : {0.3, 0.75, 2.0}) {
+      auto inputs = grid(n, spacing);
+      // An empty one in the middle and an odd count.
+      inputs.insert(inputs.begin() + inputs.size() / 2, multi_polygon_type_fp());
+      std::vector<box_type_fp> bboxes;
+      for (const auto& mpoly : inputs) {
+        bboxes.push_back(bg::return_envelope<box_type_fp>(mpoly));
+      }
+      const auto expected = to_wkt(serial_reduce(inputs, bboxes));
+      for (size_t jobs : {1, 4}) {
+        thread_pool::set_jobs(jobs);
+        BOOST_CHECK_EQUAL(to_wkt(reduce(inputs, operator+<polygon_type_fp, multi_polygon_type_fp>)), expected);
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(symmetric_difference) {
+  thread_pool::set_jobs(4);
+  // Three squares stacked on the same spot xor to just one.
+  const auto result = symdiff({square(0, 0, 2), square(0, 0, 2), square(0, 0, 2)});
+  BOOST_CHECK_CLOSE(bg::area(result), 4, 1e-6);
+}
+
+BOOST_AUTO_TEST_CASE(counts_calls) {
+  thread_pool::set_jobs(1);
+  stats().reset();
+  sum({square(0, 0, 2), square(1, 1, 2)});
+  BOOST_CHECK_EQUAL(stats().calls, 1);
+  stats().reset();
+  BOOST_CHECK_EQUAL(stats().calls, 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,141 @@
+#include "clearance.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+#include <boost/optional.hpp>
+
+namespace clearance {
+
+namespace bgi = boost::geometry::index;
+using std::vector;
+using boost::optional;
+
+namespace {
+
+// The point of the segment that is closest to p.
+point_type_fp closest_point(const segment_type_fp& segment, const point_type_fp& p) {
+  const auto& a = segment.first;
+  const auto& b = segment.second;
+  const coordinate_type_fp dx = b.x() - a.x();
+  const coordinate_type_fp dy = b.y() - a.y();
+  const coordinate_type_fp length_squared = dx * dx + dy * dy;
+  if (length_squared == 0) {
+    return a;
+  }
+  const coordinate_type_fp t = std::max(0.0, std::min(1.0, ((p.x() - a.x()) * dx + (p.y() - a.y()) * dy) / length_squared));
+  return point_type_fp(a.x() + t * dx, a.y() + t * dy);
+}
+
+// Sets location to the point of path that is closest to edge and
+// returns the distance between them.
+coordinate_type_fp closest_approach(const segment_type_fp& path, const segment_type_fp& edge,
+                                    point_type_fp& location) {
+  vector<point_type_fp> crossings;
+  bg::intersection(path, edge, crossings);
+  if (!crossings.empty()) {
+    location = crossings.front();
+    return 0;
+  }
+  // Without a crossing, the closest approach includes an endpoint of
+  // one of the segments.
+  location = path.first;
+  coordinate_type_fp best = bg::distance(path.first, closest_point(edge, path.first));
+  for (const auto& candidate : {path.second,
+                                closest_point(path, edge.first),
+                                closest_point(path, edge.second)}) {
+    const coordinate_type_fp distance = bg::distance(candidate, closest_point(edge, candidate));
+    if (distance < best) {
+      best = distance;
+      location = candidate;
+    }
+  }
+  return best;
+}
+
+} // namespace
+
+ClearanceChecker::ClearanceChecker(const multi_polygon_type_fp& copper) :
+    copper(copper) {
+  edges.reserve(copper.size());
+  for (const auto& polygon : copper) {
+    vector<segment_type_fp> segments;
+    auto add_ring = [&](const ring_type_fp& ring) {
+      for (size_t i = 1; i < ring.size(); i++) {
+        segments.push_back(segment_type_fp(ring[i-1], ring[i]));
+      }
+    };
+    add_ring(polygon.outer());
+    for (const auto& inner : polygon.inners()) {
+      add_ring(inner);
+    }
+    // The packing constructor builds a better tree than inserting.
+    edges.emplace_back(segments);
+  }
+}
+
+vector<Violation> ClearanceChecker::check(size_t polygon_index,
+                                          const multi_linestring_type_fp& paths,
+                                          coordinate_type_fp clearance,
+                                          coordinate_type_fp slack) const {
+  vector<Violation> violations;
+  const coordinate_type_fp too_close = clearance - slack;
+  if (polygon_index >= copper.size() || too_close <= 0) {
+    return violations;
+  }
+  const auto& polygon = copper[polygon_index];
+  const auto& tree = edges[polygon_index];
+  for (const auto& path : paths) {
+    optional<Violation> current;
+    // Whether the path is inside the copper, if known.  It can only
+    // change where the path crosses an edge.
+    optional<bool> inside;
+    for (size_t i = 1; i < path.size(); i++) {
+      const segment_type_fp segment(path[i-1], path[i]);
+      auto box = bg::return_envelope<box_type_fp>(segment);
+      box.min_corner().x(box.min_corner().x() - clearance);
+      box.min_corner().y(box.min_corner().y() - clearance);
+      box.max_corner().x(box.max_corner().x() + clearance);
+      box.max_corner().y(box.max_corner().y() + clearance);
+      vector<segment_type_fp> near_edges;
+      tree.query(bgi::intersects(box), std::back_inserter(near_edges));
+      coordinate_type_fp actual = clearance;
+      point_type_fp location = segment.first;
+      for (const auto& edge : near_edges) {
+        point_type_fp edge_location;
+        const coordinate_type_fp distance = closest_approach(segment, edge, edge_location);
+        if (distance < actual) {
+          actual = distance;
+          location = edge_location;
+        }
+      }
+      if (actual == 0) {
+        inside = boost::none;
+      } else {
+        if (!inside) {
+          inside = bg::covered_by(segment.first, polygon);
+        }
+        if (*inside) {
+          actual = 0;
+        }
+      }
+      if (actual < too_close) {
+        if (!current) {
+          current = Violation{location, clearance, actual};
+        } else if (actual < current->actual) {
+          current->location = location;
+          current->actual = actual;
+        }
+      } else if (current) {
+        violations.push_back(*current);
+        current = boost::none;
+      }
+    }
+    if (current) {
+      violations.push_back(*current);
+    }
+  }
+  return violations;
+}
+
+} // namespace clearance
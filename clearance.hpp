@@ -0,0 +1,48 @@
+#ifndef CLEARANCE_HPP
+#define CLEARANCE_HPP
+
+#include <vector>
+
+#include <boost/geometry/index/rtree.hpp>
+
+#include "geometry.hpp"
+
+// Checks how close toolpaths come to the copper that they isolate.
+// The edges of each copper polygon are kept in an R-tree so each
+// segment of a toolpath is only measured against the edges near it,
+// which is much cheaper than buffering the copper and intersecting the
+// toolpaths with it.
+namespace clearance {
+
+// A place where a toolpath comes too close to the copper.
+struct Violation {
+  // The point of the toolpath that is closest to the copper.
+  point_type_fp location;
+  coordinate_type_fp required;
+  // 0 if the toolpath is on or inside the copper.
+  coordinate_type_fp actual;
+};
+
+class ClearanceChecker {
+ public:
+  explicit ClearanceChecker(const multi_polygon_type_fp& copper);
+
+  // The places where the paths come closer than clearance to the
+  // copper polygon at polygon_index.  Each run of segments in a path
+  // that are too close is one violation, at its closest point.  Paths
+  // that are only short by up to slack are not violations, which
+  // allows for arcs that are approximated by chords.  This may be
+  // called from many threads at once.
+  std::vector<Violation> check(size_t polygon_index,
+                               const multi_linestring_type_fp& paths,
+                               coordinate_type_fp clearance,
+                               coordinate_type_fp slack = 0) const;
+
+ private:
+  const multi_polygon_type_fp copper;
+  std::vector<boost::geometry::index::rtree<segment_type_fp, boost::geometry::index::rstar<16>>> edges;
+};
+
+} // namespace clearance
+
+#endif // CLEARANCE_HPP
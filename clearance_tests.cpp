@@ -0,0 +1,73 @@
+#define BOOST_TEST_MODULE clearance tests
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+
+#include "geometry.hpp"
+#include "clearance.hpp"
+
+using namespace clearance;
+
+multi_polygon_type_fp read_multi_polygon(const std::string& wkt) {
+  multi_polygon_type_fp mpoly;
+  bg::read_wkt(wkt, mpoly);
+  bg::correct(mpoly);
+  return mpoly;
+}
+
+multi_linestring_type_fp read_multi_linestring(const std::string& wkt) {
+  multi_linestring_type_fp mls;
+  bg::read_wkt(wkt, mls);
+  return mls;
+}
+
+BOOST_AUTO_TEST_SUITE(clearance_tests)
+
+BOOST_AUTO_TEST_CASE(clear) {
+  ClearanceChecker checker(read_multi_polygon("MULTIPOLYGON(((0 0,0 10,10 10,10 0,0 0)))"));
+  BOOST_CHECK(checker.check(0, read_multi_linestring("MULTILINESTRING((-1 -1,-1 11,11 11))"), 1).empty());
+  // Past the end of the copper.
+  BOOST_CHECK(checker.check(1, read_multi_linestring("MULTILINESTRING((0 0,10 10))"), 1).empty());
+}
+
+BOOST_AUTO_TEST_CASE(too_close) {
+  ClearanceChecker checker(read_multi_polygon("MULTIPOLYGON(((0 0,0 10,10 10,10 0,0 0)))"));
+  const auto violations = checker.check(
+      0, read_multi_linestring("MULTILINESTRING((-1 5,-0.5 5,-0.25 6,-1 7,-1 8))"), 1);
+  // One run of segments that are too close.
+  BOOST_REQUIRE_EQUAL(violations.size(), 1);
+  BOOST_CHECK_EQUAL(violations[0].required, 1);
+  BOOST_CHECK_CLOSE(violations[0].actual, 0.25, 1e-9);
+  BOOST_CHECK_CLOSE(violations[0].location.x(), -0.25, 1e-9);
+  BOOST_CHECK_CLOSE(violations[0].location.y(), 6, 1e-9);
+  // Short by less than the slack.
+  BOOST_CHECK(checker.check(
+      0, read_multi_linestring("MULTILINESTRING((-1 5,-0.5 5,-0.25 6,-1 7,-1 8))"), 1, 0.8).empty());
+}
+
+BOOST_AUTO_TEST_CASE(crossing_and_inside) {
+  ClearanceChecker checker(read_multi_polygon(
+      "MULTIPOLYGON(((0 0,0 10,10 10,10 0,0 0),(3 3,7 3,7 7,3 7,3 3)))"));
+  // Crosses into the copper.
+  auto violations = checker.check(0, read_multi_linestring("MULTILINESTRING((-5 5,1 5))"), 1);
+  BOOST_REQUIRE_EQUAL(violations.size(), 1);
+  BOOST_CHECK_EQUAL(violations[0].actual, 0);
+  BOOST_CHECK_EQUAL(violations[0].location.x(), 0);
+  // Entirely inside the copper and far from its edges.
+  violations = checker.check(0, read_multi_linestring("MULTILINESTRING((1.5 5,1.5 6))"), 1);
+  BOOST_REQUIRE_EQUAL(violations.size(), 1);
+  BOOST_CHECK_EQUAL(violations[0].actual, 0);
+  // In the hole, which isn't copper.
+  BOOST_CHECK(checker.check(0, read_multi_linestring("MULTILINESTRING((5 4.5,5 5.5))"), 1).empty());
+}
+
+BOOST_AUTO_TEST_CASE(each_polygon) {
+  ClearanceChecker checker(read_multi_polygon(
+      "MULTIPOLYGON(((0 0,0 1,1 1,1 0,0 0)),((10 0,10 1,11 1,11 0,10 0)))"));
+  const auto paths = read_multi_linestring("MULTILINESTRING((1.5 0,1.5 1),(9.9 2,9.9 3))");
+  BOOST_CHECK_EQUAL(checker.check(0, paths, 1).size(), 1);
+  BOOST_CHECK_EQUAL(checker.check(1, paths, 1).size(), 0);
+  BOOST_CHECK_EQUAL(checker.check(1, paths, 2).size(), 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,98 @@
+// Times splitting a region with cut-ins into rings.  Copper pours from
+// KiCad and EasyEDA draw each hole in the pour with a cut-in from the
+// outline so their contours have thousands of repeated vertices.
+//
+//   make cutins_benchmark && ./cutins_benchmark
+//
+// The synthetic pour is a long strip with a round hole every unit
+// along it, each reached by a cut-in from the bottom edge.  The
+// previous algorithm, which compares every pair of points, is timed on
+// the same input for comparison, which takes about a minute for the
+// largest pour.
+
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+
+#include "gerberimporter.hpp"
+#include "bg_operators.hpp"
+
+using std::cout;
+using std::endl;
+
+// The pour has holes * (points_per_hole + 3) + 5 vertices.
+linestring_type_fp make_pour(size_t holes, size_t points_per_hole) {
+  linestring_type_fp pour;
+  pour.push_back(point_type_fp(0, 0));
+  for (size_t i = 0; i < holes; i++) {
+    const double x = i + 0.5;
+    const point_type_fp cut_in(x, 0);
+    pour.push_back(cut_in);
+    const point_type_fp hole_start(x, 0.2);
+    pour.push_back(hole_start);
+    for (size_t j = 1; j < points_per_hole; j++) {
+      const double angle = -bg::math::pi<double>() / 2 + 2 * bg::math::pi<double>() * j / points_per_hole;
+      pour.push_back(point_type_fp(x + 0.3 * std::cos(angle), 0.5 + 0.3 * std::sin(angle)));
+    }
+    pour.push_back(hole_start);
+    pour.push_back(cut_in);
+  }
+  pour.push_back(point_type_fp(holes, 0));
+  pour.push_back(point_type_fp(holes, 1));
+  pour.push_back(point_type_fp(0, 1));
+  pour.push_back(point_type_fp(0, 0));
+  return pour;
+}
+
+// The previous algorithm, which looks for the first repeated point by
+// comparing all pairs and recurses on both sides of the cut.
+multi_linestring_type_fp quadratic_get_all_ls(const linestring_type_fp& ls) {
+  for (auto start = ls.cbegin(); start != ls.cend(); start++) {
+    for (auto end = std::next(start); end != ls.cend(); end++) {
+      if (bg::equals(*start, *end)) {
+        if (start == ls.cbegin() && end == std::prev(ls.cend())) {
+          continue;
+        }
+        linestring_type_fp inner(start, end);
+        inner.push_back(inner.front());
+        linestring_type_fp outer(ls.cbegin(), start);
+        outer.insert(outer.cend(), end, ls.cend());
+        auto all = quadratic_get_all_ls(outer);
+        auto all_inner = quadratic_get_all_ls(inner);
+        all.insert(all.cend(), all_inner.cbegin(), all_inner.cend());
+        return all;
+      }
+    }
+  }
+  return multi_linestring_type_fp{ls};
+}
+
+template <typename Function>
+double time(const Function& f, multi_linestring_type_fp& result) {
+  const auto start = std::chrono::steady_clock::now();
+  result = f();
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main() {
+  cout << std::setw(10) << "vertices"
+       << std::setw(10) << "rings"
+       << std::setw(14) << "hashed (s)"
+       << std::setw(14) << "pairwise (s)"
+       << std::setw(10) << "same" << endl;
+  for (size_t holes : {10, 100, 1000}) {
+    const auto pour = make_pour(holes, 97);
+    multi_linestring_type_fp hashed;
+    multi_linestring_type_fp pairwise;
+    const double hashed_time = time([&]() { return get_all_ls(pour); }, hashed);
+    const double pairwise_time = time([&]() { return quadratic_get_all_ls(pour); }, pairwise);
+    cout << std::setw(10) << pour.size()
+         << std::setw(10) << hashed.size()
+         << std::fixed << std::setprecision(4)
+         << std::setw(14) << hashed_time
+         << std::setw(14) << pairwise_time
+         << std::setw(10) << (hashed == pairwise ? "yes" : "no") << endl;
+  }
+}
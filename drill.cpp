@@ -59,6 +59,7 @@ using std::map;
 #include "units.hpp"
 #include "available_drills.hpp"
 #include "bg_operators.hpp"
+#include "svg_writer.hpp"
 
 using std::pair;
 using std::make_pair;
@@ -95,6 +96,7 @@ ExcellonProcessor::ExcellonProcessor(const boost::program_options::variables_map
     min_milldrill_diameter(options["min-milldrill-hole-diameter"].as<Length>()),
     mill_feed_direction(options["mill-feed-direction"].as<MillFeedDirection::MillFeedDirection>()),
     available_drills(flatten(options["drills-available"].as<std::vector<AvailableDrills>>())),
+    debug_images(options["debug-images"].as<DebugImages::DebugImages>()),
     ocodes(1),
     globalVars(100),
     tileInfo(Tiling::generateTileInfo(options, max.y() - min.y(), max.x() - min.x())) {
@@ -672,7 +674,7 @@ void ExcellonProcessor::export_ngc(const string of_dir, const boost::optional<st
 void ExcellonProcessor::save_svg(
     const map<int, drillbit>& bits, const map<int, multi_linestring_type_fp>& holes,
     const string& of_dir, const string& of_name) {
-    if (holes.size() == 0) {
+    if (holes.size() == 0 || debug_images == DebugImages::NONE) {
       return;
     }
     const coordinate_type_fp width = (board_dimensions.max_corner().x() - board_dimensions.min_corner().x()) * SVG_PIX_PER_IN;
@@ -684,21 +686,31 @@ void ExcellonProcessor::save_svg(
     const string svg_dimensions =
         str(boost::format("width=\"%1%\" height=\"%2%\" viewBox=\"0 0 %3% %4%\"") % width % height % viewBox_width % viewBox_height);
 
-    ofstream svg_out (build_filename(of_dir, of_name));
-    bg::svg_mapper<point_type_fp> mapper (svg_out, viewBox_width, viewBox_height, svg_dimensions);
-
-    mapper.add(board_dimensions);
-
+    // Each hole and its radius, to be drawn in the background.
+    vector<pair<point_type_fp, double>> hole_points;
     for (const auto& hole : holes) {
         const auto& bit = bits.at(hole.first);
         const double radius = bit.unit == "mm" ? (bit.diameter / 25.4) / 2 : bit.diameter / 2;
 
         for (const linestring_type_fp& line : hole.second) {
             for (auto& hole : line_to_holes(line, radius*2)) {
-                mapper.map(hole, "", radius * SVG_DOTS_PER_IN);
+                hole_points.push_back(make_pair(hole, radius));
             }
         }
     }
+
+    write_svg_in_background(
+        [filename = build_filename(of_dir, of_name), board_dimensions = board_dimensions,
+         viewBox_width, viewBox_height, svg_dimensions, hole_points]() {
+          ofstream svg_out (filename);
+          bg::svg_mapper<point_type_fp> mapper (svg_out, viewBox_width, viewBox_height, svg_dimensions);
+
+          mapper.add(board_dimensions);
+
+          for (const auto& hole_point : hole_points) {
+              mapper.map(hole_point.first, "", hole_point.second * SVG_DOTS_PER_IN);
+          }
+        });
 }
 
 std::unique_ptr<gerbv_project_t, ExcellonProcessor::GerbvDeleter> ExcellonProcessor::parse_project(const string& filename) {
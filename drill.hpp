@@ -141,6 +141,7 @@ private:
     const boost::optional<Length> min_milldrill_diameter;
     const MillFeedDirection::MillFeedDirection mill_feed_direction;
     const std::vector<AvailableDrill> available_drills;
+    const DebugImages::DebugImages debug_images;
     uniqueCodes ocodes;
     uniqueCodes globalVars;
     const Tiling::TileInfo tileInfo;
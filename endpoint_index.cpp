@@ -0,0 +1,46 @@
+#include "endpoint_index.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+namespace endpoint_index {
+
+namespace bgi = boost::geometry::index;
+using std::vector;
+
+void EndpointIndex::add(const linestring_type_fp& toolpath) {
+  const size_t index = ends.size();
+  ends.push_back(std::make_pair(toolpath.front(), toolpath.back()));
+  tree.insert(value_type(toolpath.front(), index));
+  tree.insert(value_type(toolpath.back(), index));
+}
+
+void EndpointIndex::update(size_t index, const linestring_type_fp& toolpath) {
+  auto& old_ends = ends[index];
+  if (bg::equals(old_ends.first, toolpath.front()) && bg::equals(old_ends.second, toolpath.back())) {
+    return;
+  }
+  tree.remove(value_type(old_ends.first, index));
+  tree.remove(value_type(old_ends.second, index));
+  old_ends = std::make_pair(toolpath.front(), toolpath.back());
+  tree.insert(value_type(toolpath.front(), index));
+  tree.insert(value_type(toolpath.back(), index));
+}
+
+vector<size_t> EndpointIndex::near(const box_type_fp& box, coordinate_type_fp distance) const {
+  const box_type_fp search(
+      point_type_fp(box.min_corner().x() - distance, box.min_corner().y() - distance),
+      point_type_fp(box.max_corner().x() + distance, box.max_corner().y() + distance));
+  vector<value_type> found;
+  tree.query(bgi::intersects(search), std::back_inserter(found));
+  vector<size_t> indices;
+  indices.reserve(found.size());
+  for (const auto& value : found) {
+    indices.push_back(value.second);
+  }
+  std::sort(indices.begin(), indices.end());
+  indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+  return indices;
+}
+
+} // namespace endpoint_index
@@ -0,0 +1,36 @@
+#ifndef ENDPOINT_INDEX_HPP
+#define ENDPOINT_INDEX_HPP
+
+#include <utility>
+#include <vector>
+
+#include <boost/geometry/index/rtree.hpp>
+
+#include "geometry.hpp"
+
+// The ends of a list of toolpaths, kept in an R-tree so that finding
+// the toolpaths that a new path might attach to doesn't need to look
+// at all of them.  The index has to be told about each toolpath that
+// is added and each time that the ends of one change.
+namespace endpoint_index {
+
+class EndpointIndex {
+ public:
+  // Add the next toolpath.  Toolpaths are numbered in the order added.
+  void add(const linestring_type_fp& toolpath);
+  // The toolpath at index has new ends.
+  void update(size_t index, const linestring_type_fp& toolpath);
+  // The toolpaths with an end no further than distance from the box,
+  // in order.  Some toolpaths further away might also be included.
+  std::vector<size_t> near(const box_type_fp& box, coordinate_type_fp distance) const;
+  size_t size() const { return ends.size(); }
+
+ private:
+  typedef std::pair<point_type_fp, size_t> value_type;
+  std::vector<std::pair<point_type_fp, point_type_fp>> ends;
+  boost::geometry::index::rtree<value_type, boost::geometry::index::rstar<16>> tree;
+};
+
+} // namespace endpoint_index
+
+#endif // ENDPOINT_INDEX_HPP
@@ -0,0 +1,47 @@
+#define BOOST_TEST_MODULE endpoint index tests
+#include <boost/test/unit_test.hpp>
+
+#include <vector>
+
+#include "geometry.hpp"
+#include "endpoint_index.hpp"
+
+using namespace endpoint_index;
+using std::vector;
+
+BOOST_AUTO_TEST_SUITE(endpoint_index_tests)
+
+BOOST_AUTO_TEST_CASE(empty) {
+  EndpointIndex ends;
+  BOOST_CHECK_EQUAL(ends.size(), 0);
+  BOOST_CHECK(ends.near(box_type_fp({0, 0}, {10, 10}), 1).empty());
+}
+
+BOOST_AUTO_TEST_CASE(near_in_order) {
+  EndpointIndex ends;
+  ends.add(linestring_type_fp{{20, 0}, {30, 0}});
+  ends.add(linestring_type_fp{{0, 0}, {1, 0}});
+  ends.add(linestring_type_fp{{5, 5}, {2, 0}});
+  BOOST_CHECK(ends.near(box_type_fp({1.5, 0}, {1.5, 0}), 0.6) == (vector<size_t>{1, 2}));
+  BOOST_CHECK(ends.near(box_type_fp({1.5, 0}, {1.5, 0}), 0.1).empty());
+  // Only the ends count.
+  BOOST_CHECK(ends.near(box_type_fp({25, 0}, {25, 0}), 1).empty());
+  BOOST_CHECK(ends.near(box_type_fp({3, 3}, {31, 3}), 3) == (vector<size_t>{0, 1, 2}));
+}
+
+BOOST_AUTO_TEST_CASE(update) {
+  EndpointIndex ends;
+  ends.add(linestring_type_fp{{0, 0}, {1, 0}});
+  ends.add(linestring_type_fp{{10, 0}, {11, 0}});
+  ends.update(0, linestring_type_fp{{0, 0}, {1, 0}, {9, 0}});
+  BOOST_CHECK(ends.near(box_type_fp({1, 0}, {1, 0}), 0.1).empty());
+  BOOST_CHECK(ends.near(box_type_fp({9.5, 0}, {9.5, 0}), 0.6) == (vector<size_t>{0, 1}));
+  // A ring has the same point at both ends.
+  ends.update(1, linestring_type_fp{{10, 0}, {11, 0}, {10, 0}});
+  BOOST_CHECK(ends.near(box_type_fp({11, 0}, {11, 0}), 0.1).empty());
+  ends.update(1, linestring_type_fp{{20, 0}, {21, 0}});
+  BOOST_CHECK(ends.near(box_type_fp({10, 0}, {10, 0}), 0.1).empty());
+  BOOST_CHECK(ends.near(box_type_fp({20, 0}, {20, 0}), 0.1) == (vector<size_t>{1}));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,1004 @@
+#include "config.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+using std::cerr;
+using std::endl;
+
+#include <string>
+using std::string;
+
+#include <vector>
+using std::vector;
+
+#ifdef HAVE_SYS_MMAN_H
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <fstream>
+#include <iterator>
+#endif
+
+#include <boost/noncopyable.hpp>
+
+#include "gerber_parser.hpp"
+
+namespace gerber_parser {
+
+namespace {
+
+const double pi = bg::math::pi<double>();
+
+// The contents of a file, mapped into memory where possible so that
+// large files aren't copied.
+class MappedFile : private boost::noncopyable {
+ public:
+  explicit MappedFile(const string& path) {
+#ifdef HAVE_SYS_MMAN_H
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw parse_error("Can't open " + path);
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || !S_ISREG(file_stat.st_mode)) {
+      close(fd);
+      throw parse_error("Can't read " + path);
+    }
+    size = file_stat.st_size;
+    if (size > 0) {
+      data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (data == MAP_FAILED) {
+        close(fd);
+        throw parse_error("Can't map " + path);
+      }
+      // The parser only reads forward.
+      madvise(data, size, MADV_SEQUENTIAL);
+    }
+    close(fd);
+#else
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+      throw parse_error("Can't open " + path);
+    }
+    contents.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+#endif
+  }
+
+  ~MappedFile() {
+#ifdef HAVE_SYS_MMAN_H
+    if (size > 0) {
+      munmap(data, size);
+    }
+#endif
+  }
+
+#ifdef HAVE_SYS_MMAN_H
+  const char* begin() const { return static_cast<const char*>(data); }
+  const char* end() const { return begin() + size; }
+
+ private:
+  void* data = nullptr;
+  size_t size = 0;
+#else
+  const char* begin() const { return contents.data(); }
+  const char* end() const { return contents.data() + contents.size(); }
+
+ private:
+  string contents;
+#endif
+};
+
+inline bool is_digit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+inline bool is_space(char c) {
+  return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+// Multiply value by 10^exponent.
+double scale10(double value, int exponent) {
+  static const double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7,
+                                  1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15};
+  if (exponent >= 0 && exponent < 16) {
+    return value * powers[exponent];
+  } else if (exponent < 0 && exponent > -16) {
+    return value / powers[-exponent];
+  }
+  return value * std::pow(10.0, exponent);
+}
+
+unsigned int read_int(const char*& p, const char* end) {
+  if (p == end || !is_digit(*p)) {
+    throw parse_error("Expected a number");
+  }
+  unsigned int ret = 0;
+  for (; p < end && is_digit(*p); p++) {
+    ret = ret * 10 + (*p - '0');
+  }
+  return ret;
+}
+
+// Reads a number like 12.345 or .5, without regard to the locale.
+double read_decimal(const char*& p, const char* end) {
+  bool negative = false;
+  if (p < end && (*p == '+' || *p == '-')) {
+    negative = *p == '-';
+    p++;
+  }
+  bool digits = false;
+  double ret = 0;
+  for (; p < end && is_digit(*p); p++) {
+    ret = ret * 10 + (*p - '0');
+    digits = true;
+  }
+  if (p < end && *p == '.') {
+    p++;
+    double fraction = 0;
+    int fraction_digits = 0;
+    for (; p < end && is_digit(*p); p++) {
+      fraction = fraction * 10 + (*p - '0');
+      fraction_digits++;
+      digits = true;
+    }
+    ret += scale10(fraction, -fraction_digits);
+  }
+  if (!digits) {
+    throw parse_error("Expected a number");
+  }
+  return negative ? -ret : ret;
+}
+
+vector<string> split(const string& text, char separator) {
+  vector<string> ret;
+  size_t start = 0;
+  while (true) {
+    const size_t stop = text.find(separator, start);
+    ret.push_back(text.substr(start, stop - start));
+    if (stop == string::npos) {
+      return ret;
+    }
+    start = stop + 1;
+  }
+}
+
+bool starts_with(const string& text, const char* prefix) {
+  return text.compare(0, strlen(prefix), prefix) == 0;
+}
+
+// The signed angle from start to stop around center, in the direction
+// requested.
+double get_angle(const point_type_fp& start, const point_type_fp& center,
+                 const point_type_fp& stop, bool clockwise) {
+  const double start_angle = atan2(start.y() - center.y(), start.x() - center.x());
+  const double stop_angle = atan2(stop.y() - center.y(), stop.x() - center.x());
+  double delta_angle = stop_angle - start_angle;
+  while (clockwise && delta_angle > 0) {
+    delta_angle -= 2 * pi;
+  }
+  while (!clockwise && delta_angle < 0) {
+    delta_angle += 2 * pi;
+  }
+  return delta_angle;
+}
+
+// Arithmetic in aperture macros.  x and X are multiplication and $n are
+// the variables, starting from 1.
+class Expression {
+ public:
+  Expression(const string& text, const vector<double>& variables) :
+      text(text), variables(variables), pos(0) {}
+
+  double evaluate() {
+    const double ret = sum();
+    if (pos != text.size()) {
+      throw parse_error("Bad expression in aperture macro: " + text);
+    }
+    return ret;
+  }
+
+ private:
+  double sum() {
+    double ret = product();
+    while (pos < text.size()) {
+      if (text[pos] == '+') {
+        pos++;
+        ret += product();
+      } else if (text[pos] == '-') {
+        pos++;
+        ret -= product();
+      } else {
+        break;
+      }
+    }
+    return ret;
+  }
+
+  double product() {
+    double ret = factor();
+    while (pos < text.size()) {
+      if (text[pos] == 'x' || text[pos] == 'X') {
+        pos++;
+        ret *= factor();
+      } else if (text[pos] == '/') {
+        pos++;
+        ret /= factor();
+      } else {
+        break;
+      }
+    }
+    return ret;
+  }
+
+  double factor() {
+    if (pos >= text.size()) {
+      throw parse_error("Bad expression in aperture macro: " + text);
+    }
+    const char c = text[pos];
+    if (c == '+') {
+      pos++;
+      return factor();
+    } else if (c == '-') {
+      pos++;
+      return -factor();
+    } else if (c == '(') {
+      pos++;
+      const double ret = sum();
+      if (pos >= text.size() || text[pos] != ')') {
+        throw parse_error("Missing ) in aperture macro: " + text);
+      }
+      pos++;
+      return ret;
+    } else if (c == '$') {
+      pos++;
+      const char* p = text.data() + pos;
+      const size_t index = read_int(p, text.data() + text.size());
+      pos = p - text.data();
+      return index >= 1 && index <= variables.size() ? variables[index - 1] : 0;
+    } else {
+      const char* p = text.data() + pos;
+      const double ret = read_decimal(p, text.data() + text.size());
+      pos = p - text.data();
+      return ret;
+    }
+  }
+
+  const string& text;
+  const vector<double>& variables;
+  size_t pos;
+};
+
+struct Format {
+  int x_integer = 2;
+  int x_decimal = 4;
+  int y_integer = 2;
+  int y_decimal = 4;
+  bool omit_trailing = false;
+  bool incremental = false;
+};
+
+class Parser {
+ public:
+  Parser(const char* begin, const char* end, Handler& handler) :
+      begin(begin), end(end), pos(begin), handler(handler) {}
+
+  void run() {
+    try {
+      while (true) {
+        while (pos < end && is_space(*pos)) {
+          pos++;
+        }
+        if (pos == end) {
+          return;
+        }
+        if (*pos == '%') {
+          pos++;
+          const char* stop = static_cast<const char*>(memchr(pos, '%', end - pos));
+          if (stop == nullptr) {
+            throw parse_error("Missing % at the end of an extended command");
+          }
+          extended(string(pos, stop));
+          pos = stop + 1;
+        } else {
+          const char* stop = static_cast<const char*>(memchr(pos, '*', end - pos));
+          if (stop == nullptr) {
+            stop = end; // Be lenient about the last command.
+          }
+          const bool done = word(pos, stop);
+          pos = stop == end ? end : stop + 1;
+          if (done) {
+            return;
+          }
+        }
+      }
+    } catch (const parse_error& e) {
+      throw parse_error(string(e.what()) + " on line " + std::to_string(line()));
+    }
+  }
+
+ private:
+  size_t line() const {
+    size_t ret = 1;
+    for (const char* p = begin; p < pos && p < end; p++) {
+      if (*p == '\n') {
+        ret++;
+      }
+    }
+    return ret;
+  }
+
+  // Handles one data block, like X100Y200D01.  Returns true at the end
+  // of the file.
+  bool word(const char* p, const char* stop) {
+    int operation = -1;
+    point_type_fp target = current;
+    coordinate_type_fp i = 0;
+    coordinate_type_fp j = 0;
+    bool has_coordinates = false;
+    while (p < stop) {
+      const char c = *p++;
+      switch (c) {
+        case 'G': {
+          const unsigned int code = read_int(p, stop);
+          switch (code) {
+            case 1: interpolation = Interpolation::LINEAR; break;
+            case 2: interpolation = Interpolation::CW_CIRCULAR; break;
+            case 3: interpolation = Interpolation::CCW_CIRCULAR; break;
+            case 4: return false; // The rest is a comment.
+            case 10:
+            case 11:
+            case 12: interpolation = Interpolation::LINEAR_ZOOMED; break;
+            case 36: region(true); break;
+            case 37: region(false); break;
+            case 54:
+            case 55: break; // Select aperture and prepare for flash, both deprecated.
+            case 70: scale = 1; break;
+            case 71: scale = 1 / 25.4; break;
+            case 74: multi_quadrant = false; break;
+            case 75: multi_quadrant = true; break;
+            case 90: format.incremental = false; break;
+            case 91: format.incremental = true; break;
+            default:
+              cerr << "Unrecognized G code G" << code << ": skipping" << endl;
+              break;
+          }
+          break;
+        }
+        case 'D': {
+          const unsigned int code = read_int(p, stop);
+          if (code >= 10) {
+            aperture = code;
+          } else {
+            operation = code;
+          }
+          break;
+        }
+        case 'X':
+          target.x(coordinate(p, stop, format.x_integer, format.x_decimal) +
+                   (format.incremental ? current.x() : 0));
+          has_coordinates = true;
+          break;
+        case 'Y':
+          target.y(coordinate(p, stop, format.y_integer, format.y_decimal) +
+                   (format.incremental ? current.y() : 0));
+          has_coordinates = true;
+          break;
+        case 'I':
+          i = coordinate(p, stop, format.x_integer, format.x_decimal);
+          has_coordinates = true;
+          break;
+        case 'J':
+          j = coordinate(p, stop, format.y_integer, format.y_decimal);
+          has_coordinates = true;
+          break;
+        case 'M': {
+          const unsigned int code = read_int(p, stop);
+          if (code == 0 || code == 2) {
+            return true;
+          }
+          break;
+        }
+        case 'N':
+          read_int(p, stop); // Line numbers are ignored.
+          break;
+        default:
+          if (!is_space(c)) {
+            throw parse_error(string("Unexpected character '") + c + "'");
+          }
+      }
+    }
+    if (operation < 0 && has_coordinates) {
+      // Old files leave out the operation if it is the same as before.
+      operation = last_operation;
+    }
+    if (operation >= 1 && operation <= 3) {
+      last_operation = operation;
+      operate(operation, target, i, j);
+    } else if (operation >= 0) {
+      throw parse_error("Unrecognized operation D0" + std::to_string(operation));
+    }
+    return false;
+  }
+
+  void operate(int operation, const point_type_fp& target, coordinate_type_fp i, coordinate_type_fp j) {
+    Net net;
+    net.layer = layer;
+    net.aperture = aperture;
+    net.start = current;
+    net.stop = target;
+    if (operation == 1) {
+      net.interpolation = interpolation;
+      net.aperture_state = ApertureState::ON;
+      if (interpolation == Interpolation::CW_CIRCULAR ||
+          interpolation == Interpolation::CCW_CIRCULAR) {
+        net.arc = make_arc(current, target, i, j, interpolation == Interpolation::CW_CIRCULAR);
+      }
+    } else if (operation == 2) {
+      net.interpolation = Interpolation::LINEAR;
+      net.aperture_state = ApertureState::OFF;
+    } else {
+      net.interpolation = Interpolation::LINEAR;
+      net.aperture_state = ApertureState::FLASH;
+      net.start = target;
+    }
+    current = target;
+    handler.net(net);
+  }
+
+  Arc make_arc(const point_type_fp& start, const point_type_fp& stop,
+               coordinate_type_fp i, coordinate_type_fp j, bool clockwise) const {
+    Arc arc;
+    if (multi_quadrant) {
+      arc.center = point_type_fp(start.x() + i, start.y() + j);
+      if (bg::equals(start, stop)) {
+        arc.delta_angle = clockwise ? -2 * pi : 2 * pi;
+      } else {
+        arc.delta_angle = get_angle(start, arc.center, stop, clockwise);
+      }
+    } else {
+      // The signs of i and j are not given so pick the center that
+      // makes an arc of at most 90 degrees that is closest to being
+      // circular.
+      bool found = false;
+      double best_error = 0;
+      for (const double i_sign : {1, -1}) {
+        for (const double j_sign : {1, -1}) {
+          const point_type_fp center(start.x() + std::abs(i) * i_sign,
+                                     start.y() + std::abs(j) * j_sign);
+          const double delta_angle = get_angle(start, center, stop, clockwise);
+          if (std::abs(delta_angle) > pi / 2 + 1e-6) {
+            continue;
+          }
+          const double error = std::abs(bg::distance(start, center) - bg::distance(stop, center));
+          if (!found || error < best_error) {
+            found = true;
+            best_error = error;
+            arc.center = center;
+            arc.delta_angle = delta_angle;
+          }
+        }
+      }
+      if (!found) {
+        arc.center = point_type_fp(start.x() + i, start.y() + j);
+        arc.delta_angle = get_angle(start, arc.center, stop, clockwise);
+      }
+      if (bg::equals(start, stop)) {
+        arc.delta_angle = 0;
+      }
+    }
+    arc.radius = bg::distance(start, arc.center);
+    arc.radius2 = arc.radius;
+    return arc;
+  }
+
+  void region(bool start) {
+    Net net;
+    net.layer = layer;
+    net.aperture = aperture;
+    net.start = current;
+    net.stop = current;
+    net.interpolation = start ? Interpolation::REGION_START : Interpolation::REGION_END;
+    handler.net(net);
+  }
+
+  // Reads a coordinate in the format from the FS command and returns it
+  // in inches.
+  coordinate_type_fp coordinate(const char*& p, const char* stop, int integer_digits, int decimal_digits) const {
+    const char* const number_start = p;
+    bool negative = false;
+    if (p < stop && (*p == '+' || *p == '-')) {
+      negative = *p == '-';
+      p++;
+    }
+    int64_t value = 0;
+    int digits = 0;
+    for (; p < stop && is_digit(*p); p++) {
+      value = value * 10 + (*p - '0');
+      digits++;
+    }
+    double ret;
+    if (p < stop && *p == '.') {
+      // Some writers put the decimal point in anyway.
+      p = number_start;
+      return read_decimal(p, stop) * scale;
+    }
+    if (digits == 0) {
+      throw parse_error("Expected a coordinate");
+    }
+    if (format.omit_trailing) {
+      ret = scale10(value, integer_digits - digits);
+    } else {
+      ret = scale10(value, -decimal_digits);
+    }
+    return (negative ? -ret : ret) * scale;
+  }
+
+  void extended(const string& block) {
+    vector<string> commands;
+    for (const auto& command : split(block, '*')) {
+      if (is_macro_comment(command)) {
+        // Comments are free text so look for them before the spaces are
+        // removed.  Otherwise "0 1 circle" would become "01circle".
+        continue;
+      }
+      string stripped;
+      for (const char c : command) {
+        if (!is_space(c)) {
+          stripped.push_back(c);
+        }
+      }
+      if (!stripped.empty()) {
+        commands.push_back(stripped);
+      }
+    }
+    for (size_t i = 0; i < commands.size(); i++) {
+      const string& command = commands[i];
+      if (starts_with(command, "AM")) {
+        // The rest of the block is the body of the macro.
+        macros[command.substr(2)] = vector<string>(commands.cbegin() + i + 1, commands.cend());
+        return;
+      } else if (starts_with(command, "FS")) {
+        format_specification(command);
+      } else if (command == "MOIN") {
+        scale = 1;
+      } else if (command == "MOMM") {
+        scale = 1 / 25.4;
+      } else if (starts_with(command, "AD")) {
+        aperture_definition(command);
+      } else if (command == "LPD") {
+        layer.polarity = Polarity::DARK;
+      } else if (command == "LPC") {
+        layer.polarity = Polarity::CLEAR;
+      } else if (starts_with(command, "SR")) {
+        step_and_repeat(command);
+      } else if (command == "IPNEG") {
+        throw parse_error("Non-positive image polarity is deprecated by the Gerber "
+                          "standard and unsupported");
+      } else if (starts_with(command, "OF") || starts_with(command, "SF") ||
+                 starts_with(command, "MI") || starts_with(command, "IR") ||
+                 starts_with(command, "AS")) {
+        image_transformation(command);
+      }
+      // The rest are attributes and other commands that don't change the
+      // image.
+    }
+  }
+
+  // A comment in an aperture macro is the code 0 followed by a space and
+  // any text.
+  static bool is_macro_comment(const string& command) {
+    size_t i = 0;
+    while (i < command.size() && is_space(command[i])) {
+      i++;
+    }
+    return i < command.size() && command[i] == '0' &&
+        (i + 1 == command.size() || is_space(command[i+1]));
+  }
+
+  // The deprecated image transformations: offset, scale factor, mirror
+  // image, image rotation and axis select.  gerbv applies them but this
+  // parser doesn't so, rather than draw something different, only their
+  // default values are accepted.
+  void image_transformation(const string& command) {
+    bool is_default;
+    if (starts_with(command, "AS")) {
+      is_default = command == "AS" || command == "ASAXBY";
+    } else if (starts_with(command, "IR")) {
+      is_default = command == "IR" || transformation_value(command, 2) == 0;
+    } else {
+      const double default_value = starts_with(command, "SF") ? 1 : 0;
+      is_default = true;
+      for (size_t i = 2; i < command.size(); i++) {
+        if (command[i] == 'A' || command[i] == 'B') {
+          is_default = is_default && transformation_value(command, i + 1) == default_value;
+        }
+      }
+    }
+    if (!is_default) {
+      throw parse_error("Unsupported image transformation: " + command);
+    }
+  }
+
+  static double transformation_value(const string& command, size_t start) {
+    const char* p = command.data() + start;
+    return read_decimal(p, command.data() + command.size());
+  }
+
+  void format_specification(const string& command) {
+    for (size_t i = 2; i < command.size(); i++) {
+      const char c = command[i];
+      if (c == 'T') {
+        format.omit_trailing = true;
+      } else if (c == 'L') {
+        format.omit_trailing = false;
+      } else if (c == 'A') {
+        format.incremental = false;
+      } else if (c == 'I') {
+        format.incremental = true;
+      } else if ((c == 'X' || c == 'Y') && i + 2 < command.size() &&
+                 is_digit(command[i+1]) && is_digit(command[i+2])) {
+        (c == 'X' ? format.x_integer : format.y_integer) = command[i+1] - '0';
+        (c == 'X' ? format.x_decimal : format.y_decimal) = command[i+2] - '0';
+        i += 2;
+      }
+    }
+  }
+
+  void step_and_repeat(const string& command) {
+    layer.step_and_repeat = StepAndRepeat();
+    const char* p = command.data() + 2;
+    const char* const stop = command.data() + command.size();
+    while (p < stop) {
+      const char c = *p++;
+      if (c == 'X') {
+        layer.step_and_repeat.x = read_int(p, stop);
+      } else if (c == 'Y') {
+        layer.step_and_repeat.y = read_int(p, stop);
+      } else if (c == 'I') {
+        layer.step_and_repeat.dist_x = read_decimal(p, stop) * scale;
+      } else if (c == 'J') {
+        layer.step_and_repeat.dist_y = read_decimal(p, stop) * scale;
+      } else {
+        throw parse_error("Bad step and repeat: " + command);
+      }
+    }
+  }
+
+  void aperture_definition(const string& command) {
+    if (command.size() < 4 || command[2] != 'D') {
+      throw parse_error("Bad aperture definition: " + command);
+    }
+    const char* p = command.data() + 3;
+    const int number = read_int(p, command.data() + command.size());
+    const string rest(p);
+    const size_t comma = rest.find(',');
+    const string name = rest.substr(0, comma);
+    vector<double> parameters;
+    if (comma != string::npos) {
+      for (const auto& parameter : split(rest.substr(comma + 1), 'X')) {
+        // Like gerbv, keep the number at the start of a malformed
+        // parameter and ignore the rest.
+        const char* number = parameter.data();
+        const char* const end = number + parameter.size();
+        parameters.push_back(read_decimal(number, end));
+        if (number != end) {
+          break;
+        }
+      }
+    }
+    Aperture aperture;
+    vector<size_t> lengths;
+    if (name == "C") {
+      aperture.type = ApertureType::CIRCLE;
+      lengths = {0, 1, 2};
+    } else if (name == "R") {
+      aperture.type = ApertureType::RECTANGLE;
+      lengths = {0, 1, 2};
+    } else if (name == "O") {
+      aperture.type = ApertureType::OVAL;
+      lengths = {0, 1, 2};
+    } else if (name == "P") {
+      aperture.type = ApertureType::POLYGON;
+      lengths = {0, 3};
+    } else {
+      const auto macro = macros.find(name);
+      if (macro == macros.cend()) {
+        throw parse_error("Unknown aperture macro " + name);
+      }
+      aperture.type = ApertureType::MACRO;
+      aperture.primitives = instantiate(macro->second, parameters);
+      handler.aperture(number, aperture);
+      return;
+    }
+    if (parameters.size() < 4) {
+      parameters.resize(4, 0);
+    }
+    for (const auto& length : lengths) {
+      parameters[length] *= scale;
+    }
+    aperture.parameters.swap(parameters);
+    handler.aperture(number, aperture);
+  }
+
+  vector<MacroPrimitive> instantiate(const vector<string>& statements, vector<double> variables) const {
+    vector<MacroPrimitive> primitives;
+    for (const auto& statement : statements) {
+      if (statement[0] == '$') {
+        const size_t equals = statement.find('=');
+        if (equals == string::npos) {
+          throw parse_error("Bad statement in aperture macro: " + statement);
+        }
+        const char* p = statement.data() + 1;
+        const size_t index = read_int(p, statement.data() + equals);
+        if (index < 1) {
+          throw parse_error("Bad variable in aperture macro: " + statement);
+        }
+        const double value = Expression(statement.substr(equals + 1), variables).evaluate();
+        if (variables.size() < index) {
+          variables.resize(index, 0);
+        }
+        variables[index - 1] = value;
+        continue;
+      }
+      const auto fields = split(statement, ',');
+      const int code = std::lround(Expression(fields[0], variables).evaluate());
+      MacroPrimitive primitive;
+      switch (code) {
+        case 1: primitive.type = PrimitiveType::CIRCLE; break;
+        case 2:
+        case 20: primitive.type = PrimitiveType::VECTOR_LINE; break;
+        case 21: primitive.type = PrimitiveType::CENTER_LINE; break;
+        case 22: primitive.type = PrimitiveType::LOWER_LEFT_LINE; break;
+        case 4: primitive.type = PrimitiveType::OUTLINE; break;
+        case 5: primitive.type = PrimitiveType::POLYGON; break;
+        case 6: primitive.type = PrimitiveType::MOIRE; break;
+        case 7: primitive.type = PrimitiveType::THERMAL; break;
+        default:
+          cerr << "Unrecognized macro primitive " << code << ": skipping" << endl;
+          continue;
+      }
+      for (size_t i = 1; i < fields.size(); i++) {
+        primitive.parameters.push_back(Expression(fields[i], variables).evaluate());
+      }
+      finish_primitive(primitive);
+      primitives.push_back(primitive);
+    }
+    return primitives;
+  }
+
+  // Pads the parameters of the primitive with zeros and converts the
+  // lengths among them to inches.
+  void finish_primitive(MacroPrimitive& primitive) const {
+    auto& parameters = primitive.parameters;
+    size_t count = 0;
+    vector<size_t> lengths;
+    switch (primitive.type) {
+      case PrimitiveType::CIRCLE:
+        count = 5;
+        lengths = {1, 2, 3};
+        break;
+      case PrimitiveType::VECTOR_LINE:
+        count = 7;
+        lengths = {1, 2, 3, 4, 5};
+        break;
+      case PrimitiveType::CENTER_LINE:
+      case PrimitiveType::LOWER_LEFT_LINE:
+        count = 6;
+        lengths = {1, 2, 3, 4};
+        break;
+      case PrimitiveType::OUTLINE: {
+        const long vertices = parameters.size() > 1 ? std::max(0l, std::lround(parameters[1])) : 0;
+        count = 2 * vertices + 5;
+        for (long i = 2; i < 2 * vertices + 4; i++) {
+          lengths.push_back(i);
+        }
+        break;
+      }
+      case PrimitiveType::POLYGON:
+        count = 6;
+        lengths = {2, 3, 4};
+        break;
+      case PrimitiveType::MOIRE:
+        count = 9;
+        lengths = {0, 1, 2, 3, 4, 6, 7};
+        break;
+      case PrimitiveType::THERMAL:
+        count = 6;
+        lengths = {0, 1, 2, 3, 4};
+        break;
+    }
+    if (parameters.size() < count) {
+      parameters.resize(count, 0);
+    }
+    for (const auto& length : lengths) {
+      parameters[length] *= scale;
+    }
+  }
+
+  const char* const begin;
+  const char* const end;
+  const char* pos;
+  Handler& handler;
+
+  Format format;
+  double scale = 1; // From the units of the file to inches.
+  point_type_fp current{0, 0};
+  Interpolation interpolation = Interpolation::LINEAR;
+  bool multi_quadrant = false;
+  int aperture = 0;
+  int last_operation = 2;
+  Layer layer;
+  std::map<string, vector<string>> macros;
+};
+
+// Expand the box to include box rotated around the origin.
+void expand_rotated(box_type_fp& box, const box_type_fp& to_add, double degrees) {
+  const double angle = degrees * pi / 180;
+  for (const auto& x : {to_add.min_corner().x(), to_add.max_corner().x()}) {
+    for (const auto& y : {to_add.min_corner().y(), to_add.max_corner().y()}) {
+      bg::expand(box, point_type_fp(x * cos(angle) - y * sin(angle),
+                                    x * sin(angle) + y * cos(angle)));
+    }
+  }
+}
+
+box_type_fp centered_box(double x, double y, double width, double height) {
+  return box_type_fp(point_type_fp(x - width / 2, y - height / 2),
+                     point_type_fp(x + width / 2, y + height / 2));
+}
+
+// A box around everything that the aperture draws, relative to its
+// center.
+box_type_fp aperture_extents(const Aperture& aperture) {
+  const auto& p = aperture.parameters;
+  switch (aperture.type) {
+    case ApertureType::CIRCLE:
+    case ApertureType::POLYGON:
+      return centered_box(0, 0, p[0], p[0]);
+    case ApertureType::RECTANGLE:
+    case ApertureType::OVAL:
+      return centered_box(0, 0, p[0], p[1]);
+    case ApertureType::MACRO:
+      break;
+  }
+  box_type_fp ret;
+  bg::assign_inverse(ret);
+  for (const auto& primitive : aperture.primitives) {
+    const auto& p = primitive.parameters;
+    switch (primitive.type) {
+      case PrimitiveType::CIRCLE:
+        if (p[0] != 0) {
+          expand_rotated(ret, centered_box(p[2], p[3], p[1], p[1]), p[4]);
+        }
+        break;
+      case PrimitiveType::VECTOR_LINE:
+        if (p[0] != 0) {
+          box_type_fp line = centered_box(p[2], p[3], p[1], p[1]);
+          bg::expand(line, centered_box(p[4], p[5], p[1], p[1]));
+          expand_rotated(ret, line, p[6]);
+        }
+        break;
+      case PrimitiveType::CENTER_LINE:
+        if (p[0] != 0) {
+          expand_rotated(ret, centered_box(p[3], p[4], p[1], p[2]), p[5]);
+        }
+        break;
+      case PrimitiveType::LOWER_LEFT_LINE:
+        if (p[0] != 0) {
+          expand_rotated(ret, box_type_fp(point_type_fp(p[3], p[4]),
+                                          point_type_fp(p[3] + p[1], p[4] + p[2])), p[5]);
+        }
+        break;
+      case PrimitiveType::OUTLINE:
+        if (p[0] != 0) {
+          const size_t vertices = std::lround(p[1]);
+          box_type_fp outline;
+          bg::assign_inverse(outline);
+          for (size_t i = 0; i <= vertices; i++) {
+            bg::expand(outline, point_type_fp(p[2*i + 2], p[2*i + 3]));
+          }
+          expand_rotated(ret, outline, p[2 * vertices + 4]);
+        }
+        break;
+      case PrimitiveType::POLYGON:
+        if (p[0] != 0) {
+          expand_rotated(ret, centered_box(p[2], p[3], p[4], p[4]), p[5]);
+        }
+        break;
+      case PrimitiveType::MOIRE: {
+        const double size = std::max(p[2], p[7]);
+        expand_rotated(ret, centered_box(p[0], p[1], size, size), p[8]);
+        break;
+      }
+      case PrimitiveType::THERMAL:
+        expand_rotated(ret, centered_box(p[0], p[1], p[2], p[2]), p[5]);
+        break;
+    }
+  }
+  if (ret.min_corner().x() > ret.max_corner().x()) {
+    return centered_box(0, 0, 0, 0); // Nothing is drawn.
+  }
+  return ret;
+}
+
+} // namespace
+
+void parse(const char* begin, const char* end, Handler& handler) {
+  Parser(begin, end, handler).run();
+}
+
+void parse_file(const string& path, Handler& handler) {
+  const MappedFile file(path);
+  parse(file.begin(), file.end(), handler);
+}
+
+BoundingBoxHandler::BoundingBoxHandler() : in_region(false) {
+  bg::assign_inverse(bounding_box);
+}
+
+void BoundingBoxHandler::aperture(int number, const Aperture& aperture) {
+  extents[number] = aperture_extents(aperture);
+}
+
+void BoundingBoxHandler::expand(const point_type_fp& point, int aperture) {
+  const auto extent = extents.find(aperture);
+  box_type_fp box(point, point);
+  if (!in_region && extent != extents.cend()) {
+    box = box_type_fp(point_type_fp(point.x() + extent->second.min_corner().x(),
+                                    point.y() + extent->second.min_corner().y()),
+                      point_type_fp(point.x() + extent->second.max_corner().x(),
+                                    point.y() + extent->second.max_corner().y()));
+  }
+  bg::expand(bounding_box, box);
+  // The first and the last copy of a step and repeat bound all of them.
+  const double last_x = (step_and_repeat.x - 1) * step_and_repeat.dist_x;
+  const double last_y = (step_and_repeat.y - 1) * step_and_repeat.dist_y;
+  if (last_x != 0 || last_y != 0) {
+    bg::expand(bounding_box,
+               box_type_fp(point_type_fp(box.min_corner().x() + last_x, box.min_corner().y() + last_y),
+                           point_type_fp(box.max_corner().x() + last_x, box.max_corner().y() + last_y)));
+  }
+}
+
+void BoundingBoxHandler::net(const Net& net) {
+  step_and_repeat = net.layer.step_and_repeat;
+  if (net.interpolation == Interpolation::REGION_START) {
+    in_region = true;
+    return;
+  }
+  if (net.interpolation == Interpolation::REGION_END) {
+    in_region = false;
+    return;
+  }
+  if (net.aperture_state == ApertureState::FLASH) {
+    expand(net.stop, net.aperture);
+    return;
+  }
+  if (net.aperture_state != ApertureState::ON) {
+    return;
+  }
+  expand(net.start, net.aperture);
+  expand(net.stop, net.aperture);
+  if (net.arc) {
+    // Include the bulge of the arc.
+    const Arc& arc = *net.arc;
+    const double start_angle = atan2(net.start.y() - arc.center.y(), net.start.x() - arc.center.x());
+    const double start_radius = bg::distance(net.start, arc.center);
+    const double stop_radius = bg::distance(net.stop, arc.center);
+    const unsigned int steps = std::ceil(std::abs(arc.delta_angle) / (2 * pi) * 64) + 1;
+    for (unsigned int i = 1; i < steps; i++) {
+      const double weight = double(i) / steps;
+      const double angle = start_angle + arc.delta_angle * weight;
+      const double radius = start_radius * (1 - weight) + stop_radius * weight;
+      expand(point_type_fp(cos(angle) * radius + arc.center.x(),
+                           sin(angle) * radius + arc.center.y()),
+             net.aperture);
+    }
+  }
+}
+
+} // namespace gerber_parser
@@ -0,0 +1,139 @@
+#ifndef GERBER_PARSER_HPP
+#define GERBER_PARSER_HPP
+
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/optional.hpp>
+
+#include "geometry.hpp"
+
+// A streaming parser for RS-274X gerber files.  Instead of building a
+// model of the whole file in memory, each aperture definition and each
+// operation is passed to a Handler as soon as it is read.  All
+// coordinates and sizes are converted to inches.
+namespace gerber_parser {
+
+class parse_error : public std::runtime_error {
+ public:
+  explicit parse_error(const std::string& what) : std::runtime_error(what) {}
+};
+
+enum class Polarity { DARK, CLEAR, UNSUPPORTED };
+
+// x and y are the number of repeats, dist_x and dist_y are the step
+// between them.
+struct StepAndRepeat {
+  int x = 1;
+  int y = 1;
+  double dist_x = 0;
+  double dist_y = 0;
+};
+
+// The graphics state that applies to all the nets after it until the
+// next %LP or %SR command.
+struct Layer {
+  Polarity polarity = Polarity::DARK;
+  StepAndRepeat step_and_repeat;
+};
+
+enum class Interpolation {
+  LINEAR,
+  CW_CIRCULAR,
+  CCW_CIRCULAR,
+  REGION_START,
+  REGION_END,
+  LINEAR_ZOOMED, // Deprecated G10, G11 and G12.
+  UNKNOWN
+};
+
+enum class ApertureState { OFF, ON, FLASH };
+
+// delta_angle is in radians, positive is counterclockwise.  radius and
+// radius2 are the distances from the center to the start and stop.
+struct Arc {
+  point_type_fp center;
+  double delta_angle;
+  coordinate_type_fp radius;
+  coordinate_type_fp radius2;
+};
+
+// A single operation: a draw (D01), a move (D02) or a flash (D03), or
+// the start or end of a region.  arc is set for circular draws.
+struct Net {
+  Layer layer;
+  Interpolation interpolation = Interpolation::LINEAR;
+  ApertureState aperture_state = ApertureState::OFF;
+  point_type_fp start;
+  point_type_fp stop;
+  int aperture = 0;
+  boost::optional<Arc> arc;
+};
+
+enum class ApertureType { CIRCLE, RECTANGLE, OVAL, POLYGON, MACRO };
+
+// The values are the primitive codes from the specification.
+enum class PrimitiveType {
+  CIRCLE = 1,
+  OUTLINE = 4,
+  POLYGON = 5,
+  MOIRE = 6,
+  THERMAL = 7,
+  VECTOR_LINE = 20,
+  CENTER_LINE = 21,
+  LOWER_LEFT_LINE = 22
+};
+
+// A primitive of an aperture macro with all the variables substituted.
+// The parameters are in the order of the specification, including the
+// exposure if the primitive has one.
+struct MacroPrimitive {
+  PrimitiveType type;
+  std::vector<double> parameters;
+};
+
+// parameters are in the order of the specification and padded with
+// zeros for the optional ones.  Macros have their primitives instead.
+struct Aperture {
+  ApertureType type;
+  std::vector<double> parameters;
+  std::vector<MacroPrimitive> primitives;
+};
+
+class Handler {
+ public:
+  virtual ~Handler() {}
+  virtual void aperture(int number, const Aperture& aperture) = 0;
+  virtual void net(const Net& net) = 0;
+};
+
+// Parse the gerber in [begin, end).  Throws parse_error on failure.
+void parse(const char* begin, const char* end, Handler& handler);
+// Map the file into memory and parse it.
+void parse_file(const std::string& path, Handler& handler);
+
+// Computes the bounding box of everything drawn, including the size of
+// the apertures and the copies of step and repeats.
+class BoundingBoxHandler : public Handler {
+ public:
+  BoundingBoxHandler();
+  void aperture(int number, const Aperture& aperture) override;
+  void net(const Net& net) override;
+  const box_type_fp& get() const {
+    return bounding_box;
+  }
+
+ private:
+  void expand(const point_type_fp& point, int aperture);
+
+  std::map<int, box_type_fp> extents;
+  box_type_fp bounding_box;
+  bool in_region;
+  StepAndRepeat step_and_repeat;
+};
+
+} // namespace gerber_parser
+
+#endif // GERBER_PARSER_HPP
@@ -0,0 +1,241 @@
+#define BOOST_TEST_MODULE gerber parser tests
+#include <boost/test/unit_test.hpp>
+
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "gerber_parser.hpp"
+
+using std::string;
+using std::vector;
+using namespace gerber_parser;
+
+// Remembers everything that the parser found.
+class Recorder : public Handler {
+ public:
+  void aperture(int number, const Aperture& aperture) override {
+    apertures[number] = aperture;
+  }
+  void net(const Net& net) override {
+    nets.push_back(net);
+  }
+  std::map<int, Aperture> apertures;
+  vector<Net> nets;
+};
+
+Recorder parse_string(const string& gerber) {
+  Recorder recorder;
+  parse(gerber.data(), gerber.data() + gerber.size(), recorder);
+  return recorder;
+}
+
+void check_point(const point_type_fp& actual, double x, double y) {
+  BOOST_CHECK_CLOSE_FRACTION(actual.x() + 1, x + 1, 1e-9);
+  BOOST_CHECK_CLOSE_FRACTION(actual.y() + 1, y + 1, 1e-9);
+}
+
+BOOST_AUTO_TEST_SUITE(gerber_parser_tests)
+
+BOOST_AUTO_TEST_CASE(draws_and_flashes) {
+  const auto recorder = parse_string(
+      "G04 A comment*\n"
+      "%FSLAX24Y24*%\n"
+      "%MOIN*%\n"
+      "%ADD10C,0.01*%\n"
+      "%ADD11R,0.02X0.03*%\n"
+      "D10*\n"
+      "X10000Y5000D02*\n"
+      "G01X20000D01*\n"
+      "Y15000*\n"
+      "D11*\n"
+      "X-5Y25D03*\n"
+      "M02*\n"
+      "X0Y0D01*\n");
+  BOOST_REQUIRE_EQUAL(recorder.apertures.size(), 2);
+  const Aperture& circle = recorder.apertures.at(10);
+  BOOST_CHECK(circle.type == ApertureType::CIRCLE);
+  BOOST_CHECK_EQUAL(circle.parameters[0], 0.01);
+  const Aperture& rectangle = recorder.apertures.at(11);
+  BOOST_CHECK(rectangle.type == ApertureType::RECTANGLE);
+  BOOST_CHECK_EQUAL(rectangle.parameters[1], 0.03);
+
+  BOOST_REQUIRE_EQUAL(recorder.nets.size(), 4);
+  BOOST_CHECK(recorder.nets[0].aperture_state == ApertureState::OFF);
+  check_point(recorder.nets[0].stop, 1, 0.5);
+  BOOST_CHECK(recorder.nets[1].aperture_state == ApertureState::ON);
+  BOOST_CHECK_EQUAL(recorder.nets[1].aperture, 10);
+  check_point(recorder.nets[1].start, 1, 0.5);
+  check_point(recorder.nets[1].stop, 2, 0.5);
+  // The operation is modal in old files.
+  BOOST_CHECK(recorder.nets[2].aperture_state == ApertureState::ON);
+  check_point(recorder.nets[2].stop, 2, 1.5);
+  BOOST_CHECK(recorder.nets[3].aperture_state == ApertureState::FLASH);
+  BOOST_CHECK_EQUAL(recorder.nets[3].aperture, 11);
+  check_point(recorder.nets[3].stop, -0.0005, 0.0025);
+}
+
+BOOST_AUTO_TEST_CASE(millimeters_and_trailing_zeros) {
+  const auto recorder = parse_string(
+      "%FSTAX33Y33*%%MOMM*%\n"
+      "%ADD10O,2.54X1.27*%\n"
+      "D10*X0254Y-1D03*\n");
+  const Aperture& oval = recorder.apertures.at(10);
+  BOOST_CHECK(oval.type == ApertureType::OVAL);
+  BOOST_CHECK_CLOSE(oval.parameters[0], 0.1, 1e-9);
+  BOOST_CHECK_CLOSE(oval.parameters[1], 0.05, 1e-9);
+  BOOST_REQUIRE_EQUAL(recorder.nets.size(), 1);
+  check_point(recorder.nets[0].stop, 1, -100 / 25.4);
+}
+
+BOOST_AUTO_TEST_CASE(incremental) {
+  const auto recorder = parse_string(
+      "%FSLIX24Y24*%%MOIN*%%ADD10C,0.01*%D10*\n"
+      "X10000Y10000D02*X10000D01*Y-5000D01*\n");
+  BOOST_REQUIRE_EQUAL(recorder.nets.size(), 3);
+  check_point(recorder.nets[1].stop, 2, 1);
+  check_point(recorder.nets[2].stop, 2, 0.5);
+}
+
+BOOST_AUTO_TEST_CASE(macro) {
+  const auto recorder = parse_string(
+      "%FSLAX24Y24*%%MOMM*%\n"
+      "%AMDONUT*\n"
+      "0 A circle with a hole*\n"
+      "0 1 circle, then 1 more*\n"
+      "$3=$1x2*\n"
+      "1,1,$3,0,0*\n"
+      "1,0,($1-$2)/2,1+1,-1*\n"
+      "21,1,25.4,$2,0,0,45*%\n"
+      "%ADD20DONUT,12.7X0.5*%\n");
+  const Aperture& donut = recorder.apertures.at(20);
+  BOOST_CHECK(donut.type == ApertureType::MACRO);
+  BOOST_REQUIRE_EQUAL(donut.primitives.size(), 3);
+  const auto& outer = donut.primitives[0];
+  BOOST_CHECK(outer.type == PrimitiveType::CIRCLE);
+  BOOST_REQUIRE_EQUAL(outer.parameters.size(), 5); // Padded for the rotation.
+  BOOST_CHECK_EQUAL(outer.parameters[0], 1);
+  BOOST_CHECK_CLOSE(outer.parameters[1], 1, 1e-9);
+  const auto& inner = donut.primitives[1];
+  BOOST_CHECK_EQUAL(inner.parameters[0], 0);
+  BOOST_CHECK_CLOSE(inner.parameters[1], 6.1 / 25.4, 1e-9);
+  BOOST_CHECK_CLOSE(inner.parameters[2], 2 / 25.4, 1e-9);
+  BOOST_CHECK_CLOSE(inner.parameters[3], -1 / 25.4, 1e-9);
+  const auto& line = donut.primitives[2];
+  BOOST_CHECK(line.type == PrimitiveType::CENTER_LINE);
+  BOOST_CHECK_CLOSE(line.parameters[1], 1, 1e-9);
+  BOOST_CHECK_EQUAL(line.parameters[5], 45); // Angles aren't scaled.
+}
+
+BOOST_AUTO_TEST_CASE(multi_quadrant_arc) {
+  const auto recorder = parse_string(
+      "%FSLAX24Y24*%%MOIN*%%ADD10C,0.01*%D10*G75*\n"
+      "X10000Y0D02*G03X0Y10000I-10000J0D01*\n"
+      "G02X0Y10000I0J-10000D01*\n");
+  BOOST_REQUIRE_EQUAL(recorder.nets.size(), 3);
+  const auto& quarter = recorder.nets[1];
+  BOOST_CHECK(quarter.interpolation == Interpolation::CCW_CIRCULAR);
+  BOOST_REQUIRE(quarter.arc);
+  check_point(quarter.arc->center, 0, 0);
+  BOOST_CHECK_CLOSE(quarter.arc->delta_angle, bg::math::pi<double>() / 2, 1e-9);
+  BOOST_CHECK_CLOSE(quarter.arc->radius, 1, 1e-9);
+  const auto& full = recorder.nets[2];
+  BOOST_REQUIRE(full.arc);
+  BOOST_CHECK_CLOSE(full.arc->delta_angle, -2 * bg::math::pi<double>(), 1e-9);
+}
+
+BOOST_AUTO_TEST_CASE(single_quadrant_arc) {
+  const auto recorder = parse_string(
+      "%FSLAX24Y24*%%MOIN*%%ADD10C,0.01*%D10*G74*\n"
+      "X10000Y0D02*G02X0Y-10000I10000J0D01*\n");
+  BOOST_REQUIRE_EQUAL(recorder.nets.size(), 2);
+  const auto& arc = recorder.nets[1].arc;
+  BOOST_REQUIRE(arc);
+  // The signs of I and J are ignored.
+  check_point(arc->center, 0, 0);
+  BOOST_CHECK_CLOSE(arc->delta_angle, -bg::math::pi<double>() / 2, 1e-9);
+}
+
+BOOST_AUTO_TEST_CASE(regions_and_layers) {
+  const auto recorder = parse_string(
+      "%FSLAX24Y24*%%MOIN*%\n"
+      "G36*X0Y0D02*X10000D01*Y10000D01*X0Y0D01*G37*\n"
+      "%LPC*%\n"
+      "%SRX2Y3I1.5J0.5*%\n"
+      "G36*X0Y0D02*X10000D01*Y10000D01*X0Y0D01*G37*\n"
+      "%SR*%%LPD*%\n");
+  BOOST_REQUIRE_EQUAL(recorder.nets.size(), 12);
+  BOOST_CHECK(recorder.nets[0].interpolation == Interpolation::REGION_START);
+  BOOST_CHECK(recorder.nets[5].interpolation == Interpolation::REGION_END);
+  BOOST_CHECK(recorder.nets[5].layer.polarity == Polarity::DARK);
+  const auto& layer = recorder.nets[6].layer;
+  BOOST_CHECK(layer.polarity == Polarity::CLEAR);
+  BOOST_CHECK_EQUAL(layer.step_and_repeat.x, 2);
+  BOOST_CHECK_EQUAL(layer.step_and_repeat.y, 3);
+  BOOST_CHECK_EQUAL(layer.step_and_repeat.dist_x, 1.5);
+  BOOST_CHECK_EQUAL(layer.step_and_repeat.dist_y, 0.5);
+}
+
+BOOST_AUTO_TEST_CASE(bounding_box) {
+  const string gerber =
+      "%FSLAX24Y24*%%MOIN*%%ADD10C,0.2*%%ADD11R,1X2*%\n"
+      "D10*X0Y0D02*X10000D01*D11*X-10000Y0D03*\n"
+      "G36*X0Y0D02*Y30000D01*X10000D01*X0Y0D01*G37*\n";
+  BoundingBoxHandler handler;
+  parse(gerber.data(), gerber.data() + gerber.size(), handler);
+  check_point(handler.get().min_corner(), -1.5, -1);
+  check_point(handler.get().max_corner(), 1.1, 3);
+}
+
+BOOST_AUTO_TEST_CASE(bounding_box_step_and_repeat) {
+  const string gerber =
+      "%FSLAX24Y24*%%MOIN*%%ADD10C,0.2*%\n"
+      "%SRX3Y2I1.5J-2*%D10*X0Y0D03*%SR*%\n";
+  BoundingBoxHandler handler;
+  parse(gerber.data(), gerber.data() + gerber.size(), handler);
+  check_point(handler.get().min_corner(), -0.1, -2.1);
+  check_point(handler.get().max_corner(), 3.1, 0.1);
+}
+
+BOOST_AUTO_TEST_CASE(file) {
+  const string path = "gerber_parser_tests.gbr";
+  {
+    std::ofstream out(path);
+    out << "%FSLAX24Y24*%%MOIN*%%ADD10C,0.5*%D10*X10000Y10000D03*M02*\n";
+  }
+  BoundingBoxHandler handler;
+  parse_file(path, handler);
+  std::remove(path.c_str());
+  check_point(handler.get().min_corner(), 0.75, 0.75);
+  check_point(handler.get().max_corner(), 1.25, 1.25);
+  BOOST_CHECK_THROW(parse_file(path, handler), parse_error);
+}
+
+BOOST_AUTO_TEST_CASE(malformed_aperture) {
+  const auto recorder = parse_string("%FSLAX24Y24*%%ADD10R,0.03260.326*%");
+  const Aperture& rectangle = recorder.apertures.at(10);
+  BOOST_CHECK_EQUAL(rectangle.parameters[0], 0.0326);
+  BOOST_CHECK_EQUAL(rectangle.parameters[1], 0);
+}
+
+BOOST_AUTO_TEST_CASE(errors) {
+  BOOST_CHECK_THROW(parse_string("%FSLAX24Y24*%%ADD10FOO*%"), parse_error);
+  BOOST_CHECK_THROW(parse_string("%FSLAX24Y24*%\n%ADD10C,0.1*\n"), parse_error);
+  BOOST_CHECK_THROW(parse_string("%FSLAX24Y24*%\nX1Y1D09*\n"), parse_error);
+  BOOST_CHECK_THROW(parse_string("%FSLAX24Y24*%\nX1Q1D01*\n"), parse_error);
+}
+
+BOOST_AUTO_TEST_CASE(image_transformations) {
+  // The defaults don't change anything.
+  BOOST_CHECK_NO_THROW(parse_string("%FSLAX24Y24*%%OFA0B0*%%SFA1B1*%%MIA0B0*%%IR0*%%ASAXBY*%"));
+  BOOST_CHECK_NO_THROW(parse_string("%FSLAX24Y24*%%OFA0.0000B-0.0*%%SFA1.0*%"));
+  BOOST_CHECK_THROW(parse_string("%FSLAX24Y24*%%OFA0.1B0*%"), parse_error);
+  BOOST_CHECK_THROW(parse_string("%FSLAX24Y24*%%SFA1B2*%"), parse_error);
+  BOOST_CHECK_THROW(parse_string("%FSLAX24Y24*%%MIA1*%"), parse_error);
+  BOOST_CHECK_THROW(parse_string("%FSLAX24Y24*%%IR90*%"), parse_error);
+  BOOST_CHECK_THROW(parse_string("%FSLAX24Y24*%%ASAYBX*%"), parse_error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -20,6 +20,7 @@
 #include <algorithm>
 #include <utility>
 using std::pair;
+using std::make_pair;
 using std::reverse;
 using std::swap;
 
@@ -49,29 +50,62 @@ using std::forward_list;
 #include <map>
 using std::map;
 
+#include <unordered_map>
+
+#include <mutex>
+using std::mutex;
+using std::lock_guard;
+
 #include <boost/format.hpp>
 
 #include "gerberimporter.hpp"
+#include "gerber_parser.hpp"
 #include "eulerian_paths.hpp"
 #include "bg_operators.hpp"
 #include "bg_helpers.hpp"
 #include "merge_near_points.hpp"
+#include "thread_pool.hpp"
 
 namespace bg = boost::geometry;
+using tessellation::Tessellation;
 
 typedef bg::strategy::transform::rotate_transformer<bg::degree, double, 2, 2> rotate_deg;
 typedef bg::strategy::transform::translate_transformer<coordinate_type_fp, 2, 2> translate;
 
-GerberImporter::GerberImporter() {
-  project = gerbv_create_project();
+// The gerbv parser keeps some of its state in globals so only one
+// thread may use it at a time.
+static mutex gerbv_mutex;
+
+GerberImporter::GerberImporter(bool native_parser) : project(nullptr) {
+  if (!native_parser) {
+    lock_guard<mutex> lock(gerbv_mutex);
+    project = gerbv_create_project();
+  }
 }
 
 GerberImporter::~GerberImporter() {
-  gerbv_destroy_project(project);
+  if (project) {
+    lock_guard<mutex> lock(gerbv_mutex);
+    gerbv_destroy_project(project);
+  }
 }
 
 /* Returns true iff successful. */
 bool GerberImporter::load_file(const string& path) {
+  if (!project) {
+    // Only measure the file now, it is parsed again when rendering.
+    try {
+      gerber_parser::BoundingBoxHandler bounding_box_handler;
+      gerber_parser::parse_file(path, bounding_box_handler);
+      bounding_box = bounding_box_handler.get();
+      this->path = path;
+      return true;
+    } catch (const gerber_parser::parse_error& e) {
+      cerr << "Error reading " << path << ": " << e.what() << endl;
+      return false;
+    }
+  }
+  lock_guard<mutex> lock(gerbv_mutex);
   gchar *filename = g_strdup(path.c_str());
   gerbv_open_layer_from_filename(project, filename);
   g_free(filename);
@@ -79,6 +113,9 @@ bool GerberImporter::load_file(const string& path) {
 }
 
 box_type_fp GerberImporter::get_bounding_box() const {
+  if (!project) {
+    return bounding_box;
+  }
   return box_type_fp{
     {project->file[0]->image->info->min_x,  project->file[0]->image->info->min_y},
     {project->file[0]->image->info->max_x,  project->file[0]->image->info->max_y}
@@ -109,18 +146,18 @@ multi_polygon_type_fp make_regular_polygon(point_type_fp center, coordinate_type
 // Same as above but potentially puts a hole in the center.
 multi_polygon_type_fp make_regular_polygon(point_type_fp center, coordinate_type_fp diameter, unsigned int vertices,
                                            coordinate_type_fp offset, coordinate_type_fp hole_diameter,
-                                           unsigned int circle_points) {
+                                           const Tessellation& circle_points) {
   multi_polygon_type_fp ret;
   ret = make_regular_polygon(center, diameter, vertices, offset);
 
   if (hole_diameter > 0) {
-    ret = ret - make_regular_polygon(center, hole_diameter, circle_points, 0);
+    ret = ret - make_regular_polygon(center, hole_diameter, circle_points.use_points(hole_diameter), 0);
   }
   return ret;
 }
 
 multi_polygon_type_fp make_rectangle(point_type_fp center, double width, double height,
-                                     coordinate_type_fp hole_diameter, unsigned int circle_points) {
+                                     coordinate_type_fp hole_diameter, const Tessellation& circle_points) {
   const coordinate_type_fp x = center.x();
   const coordinate_type_fp y = center.y();
 
@@ -134,7 +171,7 @@ multi_polygon_type_fp make_rectangle(point_type_fp center, double width, double
   polygon.outer().push_back(polygon.outer().front());
 
   if (hole_diameter > 0) {
-    ret = ret - make_regular_polygon(center, hole_diameter, circle_points, 0);
+    ret = ret - make_regular_polygon(center, hole_diameter, circle_points.use_points(hole_diameter), 0);
   }
   return ret;
 }
@@ -154,7 +191,7 @@ multi_polygon_type_fp make_rectangle(point_type_fp point1, point_type_fp point2,
 }
 
 multi_polygon_type_fp make_oval(point_type_fp center, coordinate_type_fp width, coordinate_type_fp height,
-                                coordinate_type_fp hole_diameter, unsigned int circle_points) {
+                                coordinate_type_fp hole_diameter, const Tessellation& circle_points) {
   point_type_fp start(center.x(), center.y());
   point_type_fp end(center.x(), center.y());
   if (width > height) {
@@ -168,9 +205,10 @@ multi_polygon_type_fp make_oval(point_type_fp center, coordinate_type_fp width,
   } else {
     // This is just a circle.  Older boost doesn't handle a line with no length
     // though new boost does.
-    return make_regular_polygon(center, width, circle_points, 0, hole_diameter, circle_points);
+    return make_regular_polygon(center, width, circle_points.use_points(width), 0, hole_diameter, circle_points);
   }
 
+  const unsigned int end_points = circle_points.use_points(std::min(width, height));
   multi_polygon_type_fp oval;
   linestring_type_fp line;
   line.push_back(start);
@@ -178,12 +216,12 @@ multi_polygon_type_fp make_oval(point_type_fp center, coordinate_type_fp width,
   bg::buffer(line, oval,
              bg::strategy::buffer::distance_symmetric<coordinate_type_fp>(std::min(width, height)/2),
              bg::strategy::buffer::side_straight(),
-             bg::strategy::buffer::join_round(circle_points),
-             bg::strategy::buffer::end_round(circle_points),
-             bg::strategy::buffer::point_circle(circle_points));
+             bg::strategy::buffer::join_round(end_points),
+             bg::strategy::buffer::end_round(end_points),
+             bg::strategy::buffer::point_circle(end_points));
 
   if (hole_diameter > 0) {
-    multi_polygon_type_fp hole = make_regular_polygon(center, hole_diameter, circle_points, 0);
+    multi_polygon_type_fp hole = make_regular_polygon(center, hole_diameter, circle_points.use_points(hole_diameter), 0);
     multi_polygon_type_fp hole_fp;
     bg::convert(hole, hole_fp);
     oval = oval - hole_fp;
@@ -226,7 +264,7 @@ double get_angle(point_type_fp start, point_type_fp center, point_type_fp stop,
 // delta_angle is in radians.  Positive signed is counterclockwise, like math.
 linestring_type_fp circular_arc(const point_type_fp& start, const point_type_fp& stop,
                                 point_type_fp center, const coordinate_type_fp& radius, const coordinate_type_fp& radius2,
-                                double delta_angle, const bool& clockwise, const unsigned int& circle_points) {
+                                double delta_angle, const bool& clockwise, const Tessellation& circle_points) {
   // We can't trust gerbv to calculate single-quadrant vs multi-quadrant
   // correctly so we must so it ourselves.
   bool definitely_sq = false;
@@ -274,7 +312,9 @@ linestring_type_fp circular_arc(const point_type_fp& start, const point_type_fp&
   const double stop_angle = start_angle + delta_angle;
   const coordinate_type_fp start_radius = bg::distance(start, center);
   const coordinate_type_fp stop_radius = bg::distance(stop, center);
-  const unsigned int steps = ceil(std::abs(delta_angle) / (2 * bg::math::pi<double>()) * circle_points)
+  const double fraction = std::abs(delta_angle) / (2 * bg::math::pi<double>());
+  const unsigned int steps = ceil(fraction * circle_points.use_points(2 * std::max(start_radius, stop_radius),
+                                                                       fraction))
                              + 1; // One more for the end point.
   linestring_type_fp linestring;
   // First place the start;
@@ -315,23 +355,149 @@ struct mp_pair {
   multi_polygon_type_fp filled_closed_lines;
 };
 
-// To speed up the merging, we do them in pairs so that we're mostly merging
-// equal-sized shapes.
-mp_pair merge_multi_draws(const vector<mp_pair>& multi_draws) {
-  if (multi_draws.size() == 0) {
+// The shape of an aperture, kept once no matter how many times it is
+// flashed.  The points of all the rings are in a single buffer so that
+// making a copy at an offset is one pass over it, with exactly one
+// allocation per ring.
+class ApertureTemplate {
+ public:
+  explicit ApertureTemplate(const multi_polygon_type_fp& shape) {
+    for (const auto& poly : shape) {
+      ring_sizes.emplace_back();
+      add_ring(poly.outer());
+      for (const auto& inner : poly.inners()) {
+        add_ring(inner);
+      }
+    }
+  }
+
+  multi_polygon_type_fp at(const point_type_fp& offset) const {
+    multi_polygon_type_fp ret;
+    ret.resize(ring_sizes.size());
+    auto point = points.cbegin();
+    for (size_t i = 0; i < ring_sizes.size(); i++) {
+      const vector<size_t>& sizes = ring_sizes[i];
+      ret[i].inners().resize(sizes.size() - 1);
+      for (size_t j = 0; j < sizes.size(); j++) {
+        ring_type_fp& ring = j == 0 ? ret[i].outer() : ret[i].inners()[j-1];
+        ring.reserve(sizes[j]);
+        for (size_t k = 0; k < sizes[j]; k++, point++) {
+          ring.push_back(*point + offset);
+        }
+      }
+    }
+    return ret;
+  }
+
+ private:
+  void add_ring(const ring_type_fp& ring) {
+    ring_sizes.back().push_back(ring.size());
+    points.insert(points.cend(), ring.cbegin(), ring.cend());
+  }
+
+  vector<point_type_fp> points;
+  // For each polygon, the sizes of its rings, outer ring first.
+  vector<vector<size_t>> ring_sizes;
+};
+
+// A flash is recorded as the aperture and where it goes.  The shape is
+// only made when the layer is merged.  draws_before is the number of
+// other draws in the layer before it, to keep the inputs of the merge
+// in the order that they were drawn.
+struct Flash {
+  std::shared_ptr<const ApertureTemplate> aperture;
+  point_type_fp offset;
+  size_t draws_before;
+};
+
+// To speed up the merging, we do them with a cascaded union so that we're
+// mostly merging equal-sized shapes that are near each other.  The
+// flashes are made straight into the inputs of the union.
+mp_pair merge_multi_draws(vector<mp_pair> multi_draws, const vector<Flash>& flashes) {
+  if (multi_draws.size() + flashes.size() == 0) {
     return multi_polygon_type_fp();
-  } else if (multi_draws.size() == 1) {
-    return multi_draws.front();
+  } else if (multi_draws.size() == 1 && flashes.size() == 0) {
+    return std::move(multi_draws.front());
   }
   vector<multi_polygon_type_fp> shapes;
   vector<multi_polygon_type_fp> filled_closed_lines;
-  shapes.reserve(multi_draws.size());
+  shapes.reserve(multi_draws.size() + flashes.size());
   filled_closed_lines.reserve(multi_draws.size());
-  for (const auto& multi_draw : multi_draws) {
-    shapes.push_back(multi_draw.shapes);
-    filled_closed_lines.push_back(multi_draw.filled_closed_lines);
+  auto flash = flashes.cbegin();
+  for (size_t i = 0; i <= multi_draws.size(); i++) {
+    for (; flash != flashes.cend() && flash->draws_before == i; flash++) {
+      shapes.push_back(flash->aperture->at(flash->offset));
+    }
+    if (i < multi_draws.size()) {
+      shapes.push_back(std::move(multi_draws[i].shapes));
+      filled_closed_lines.push_back(std::move(multi_draws[i].filled_closed_lines));
+    }
+  }
+  return mp_pair(sum(std::move(shapes)), symdiff(std::move(filled_closed_lines)));
+}
+
+// The union of two shapes that are mostly far apart, like neighboring
+// copies in a step and repeat.  Only the polygons that are near the
+// other shape are merged, the rest are copied to the output.
+multi_polygon_type_fp sum_near(const multi_polygon_type_fp& lhs, const multi_polygon_type_fp& rhs) {
+  if (lhs.empty() || rhs.empty()) {
+    return lhs.empty() ? rhs : lhs;
+  }
+  const auto lhs_box = bg::return_envelope<box_type_fp>(lhs);
+  const auto rhs_box = bg::return_envelope<box_type_fp>(rhs);
+  multi_polygon_type_fp ret;
+  multi_polygon_type_fp lhs_near;
+  multi_polygon_type_fp rhs_near;
+  for (const auto& poly : lhs) {
+    if (bg::intersects(bg::return_envelope<box_type_fp>(poly), rhs_box)) {
+      lhs_near.push_back(poly);
+    } else {
+      ret.push_back(poly);
+    }
+  }
+  for (const auto& poly : rhs) {
+    if (bg::intersects(bg::return_envelope<box_type_fp>(poly), lhs_box)) {
+      rhs_near.push_back(poly);
+    } else {
+      ret.push_back(poly);
+    }
+  }
+  if (!lhs_near.empty() || !rhs_near.empty()) {
+    const auto merged = sum({lhs_near, rhs_near});
+    ret.insert(ret.cend(), merged.cbegin(), merged.cend());
+  }
+  return ret;
+}
+
+// Repeat the shape count times, each copy offset by step from the
+// previous one.  The copies are built by doubling: a row of 2n copies
+// is a row of n copies merged with itself, shifted by n steps.  That
+// needs only about log2(count) merges instead of one per copy.
+multi_polygon_type_fp repeat(const multi_polygon_type_fp& shape, int count,
+                             coordinate_type_fp step_x, coordinate_type_fp step_y) {
+  if (count <= 1) {
+    return shape;
+  }
+  const auto shifted = [&](const multi_polygon_type_fp& mpoly, int steps) {
+    multi_polygon_type_fp ret;
+    bg::transform(mpoly, ret, translate(step_x * steps, step_y * steps));
+    return ret;
+  };
+  const auto half = repeat(shape, count / 2, step_x, step_y);
+  auto ret = sum_near(half, shifted(half, count / 2));
+  if (count % 2 == 1) {
+    ret = sum_near(ret, shifted(shape, count - 1));
   }
-  return mp_pair(sum(shapes), symdiff(filled_closed_lines));
+  return ret;
+}
+
+// The copies of a step and repeat.  The prototype is repeated along x
+// to make a row and then the row is repeated along y.  Copies that
+// don't touch are never unioned.
+multi_polygon_type_fp step_and_repeat(const multi_polygon_type_fp& prototype,
+                                      const gerber_parser::StepAndRepeat& step_and_repeat) {
+  const auto row = repeat(prototype, step_and_repeat.x, step_and_repeat.dist_x, 0);
+  return repeat(row, step_and_repeat.y, 0, step_and_repeat.dist_y);
 }
 
 // layers is a vector of layers.  Each layer has a polarity, which can
@@ -344,40 +510,24 @@ mp_pair merge_multi_draws(const vector<mp_pair>& multi_draws) {
 // overrides the layer polarity if set and causes each layer to be
 // xored with the previous layer, instead of drawn or erased (dark or
 // clear).
-multi_polygon_type_fp generate_layers(vector<pair<const gerbv_layer_t *, mp_pair>>& layers,
+multi_polygon_type_fp generate_layers(vector<pair<gerber_parser::Layer, mp_pair>>& layers,
                                       multi_polygon_type_fp mp_pair::* member, bool xor_layers) {
+  using gerber_parser::Polarity;
   multi_polygon_type_fp output;
-  vector<ring_type_fp> rings;
 
   for (auto layer = layers.cbegin(); layer != layers.cend(); layer++) {
-    const gerbv_polarity_t polarity = layer->first->polarity;
-    const gerbv_step_and_repeat_t& stepAndRepeat = layer->first->stepAndRepeat;
-    mp_pair draw_pair = layer->second;
-    multi_polygon_type_fp draws = draw_pair.*member;
-    if (stepAndRepeat.X > 0 || stepAndRepeat.Y > 0) {
-      vector<multi_polygon_type_fp> to_sum{draws};
-
-      to_sum.reserve(stepAndRepeat.X * stepAndRepeat.Y);
-      for (int sr_x = 0; sr_x < stepAndRepeat.X; sr_x++) {
-        for (int sr_y = 0; sr_y < stepAndRepeat.Y; sr_y++) {
-          if (sr_x == 0 && sr_y == 0) {
-            continue; // Already got this one.
-          }
-          multi_polygon_type_fp translated_draws;
-          bg::transform(draws, translated_draws,
-                        translate(stepAndRepeat.dist_X * sr_x,
-                                  stepAndRepeat.dist_Y * sr_y));
-          to_sum.push_back(translated_draws);
-        }
-      }
-      draws = sum(to_sum);
+    const Polarity polarity = layer->first.polarity;
+    const gerber_parser::StepAndRepeat& stepAndRepeat = layer->first.step_and_repeat;
+    multi_polygon_type_fp draws = layer->second.*member;
+    if (stepAndRepeat.x > 1 || stepAndRepeat.y > 1) {
+      draws = step_and_repeat(draws, stepAndRepeat);
     }
 
     if (xor_layers) {
       output = output ^ draws;
-    } else if (polarity == GERBV_POLARITY_DARK) {
+    } else if (polarity == Polarity::DARK) {
       output = output + draws;
-    } else if (polarity == GERBV_POLARITY_CLEAR) {
+    } else if (polarity == Polarity::CLEAR) {
       output = output - draws;
     } else {
       unsupported_polarity_throw_exception();
@@ -386,14 +536,14 @@ multi_polygon_type_fp generate_layers(vector<pair<const gerbv_layer_t *, mp_pair
   return output;
 }
 
-multi_polygon_type_fp make_moire(const double * const parameters, unsigned int circle_points) {
+multi_polygon_type_fp make_moire(const double * const parameters, const Tessellation& circle_points) {
   const point_type_fp center(parameters[0], parameters[1]);
   vector<multi_polygon_type_fp> moire_parts;
 
   double crosshair_thickness = parameters[6];
   double crosshair_length = parameters[7];
-  moire_parts.push_back(make_rectangle(center, crosshair_thickness, crosshair_length, 0, 0));
-  moire_parts.push_back(make_rectangle(center, crosshair_length, crosshair_thickness, 0, 0));
+  moire_parts.push_back(make_rectangle(center, crosshair_thickness, crosshair_length, 0, circle_points));
+  moire_parts.push_back(make_rectangle(center, crosshair_length, crosshair_thickness, 0, circle_points));
   const int max_number_of_rings = parameters[5];
   const double outer_ring_diameter = parameters[2];
   const double ring_thickness = parameters[3];
@@ -405,19 +555,21 @@ multi_polygon_type_fp make_moire(const double * const parameters, unsigned int c
       break;
     if (internal_diameter < 0)
       internal_diameter = 0;
-    moire_parts.push_back(make_regular_polygon(center, external_diameter, circle_points, 0,
+    moire_parts.push_back(make_regular_polygon(center, external_diameter,
+                                               circle_points.use_points(external_diameter), 0,
                                                internal_diameter, circle_points));
   }
   return sum(moire_parts);
 }
 
 multi_polygon_type_fp make_thermal(point_type_fp center, coordinate_type_fp external_diameter, coordinate_type_fp internal_diameter,
-                                   coordinate_type_fp gap_width, unsigned int circle_points) {
-  multi_polygon_type_fp ring = make_regular_polygon(center, external_diameter, circle_points,
+                                   coordinate_type_fp gap_width, const Tessellation& circle_points) {
+  multi_polygon_type_fp ring = make_regular_polygon(center, external_diameter,
+                                                    circle_points.use_points(external_diameter),
                                                     0, internal_diameter, circle_points);
 
-  multi_polygon_type_fp rect1 = make_rectangle(center, gap_width, 2 * external_diameter, 0, 0);
-  multi_polygon_type_fp rect2 = make_rectangle(center, 2 * external_diameter, gap_width, 0, 0);
+  multi_polygon_type_fp rect1 = make_rectangle(center, gap_width, 2 * external_diameter, 0, circle_points);
+  multi_polygon_type_fp rect2 = make_rectangle(center, 2 * external_diameter, gap_width, 0, circle_points);
   return ring - rect1 - rect2;
 }
 
@@ -425,29 +577,52 @@ multi_polygon_type_fp make_thermal(point_type_fp center, coordinate_type_fp exte
 // the return value is a series of rings such that no ring has the same point in
 // it twice except for the front and back.  There is also one linestring that
 // isn't a ring in the output if the input isn't a ring.
+//
+// Cutting out the first repeated point that we find leaves the points before
+// it without repeats, so we can keep going from where the cut ends.  Each cut
+// is itself a piece of ls that gets the same treatment.  With the index of the
+// next repeat of each point, found by hashing, the whole thing is linear.
 multi_linestring_type_fp get_all_ls(const linestring_type_fp& ls) {
-  for (auto start = ls.cbegin(); start != ls.cend(); start++) {
-    for (auto end = std::next(start); end != ls.cend(); end++) {
-      if (bg::equals(*start, *end)) {
-        if (start == ls.cbegin() && end == std::prev(ls.cend())) {
-          continue; // This is just the entire ls, no need to try to recurse here.
-        }
-        linestring_type_fp inner(start, end); // Build the ring that we've found.
-        inner.push_back(inner.front()); // Close the ring.
-
-        // Connect up the rest.
-        linestring_type_fp outer(ls.cbegin(), start);
-        outer.insert(outer.cend(), end, ls.cend());
-        // Recurse on outer and inner and put together.
-        auto all = get_all_ls(outer);
-        auto all_inner = get_all_ls(inner);
-        all.insert(all.cend(), all_inner.cbegin(), all_inner.cend());
-        return all;
+  if (ls.empty()) {
+    return multi_linestring_type_fp{ls};
+  }
+  // The index of the next point that is the same as ls[i], or 0 if none.
+  vector<size_t> next_repeat(ls.size(), 0);
+  std::unordered_map<point_type_fp, size_t> later;
+  later.reserve(ls.size());
+  for (size_t i = ls.size(); i-- > 0; ) {
+    auto found = later.emplace(ls[i], i);
+    if (!found.second) {
+      next_repeat[i] = found.first->second;
+      found.first->second = i;
+    }
+  }
+  multi_linestring_type_fp ret;
+  // Pieces of ls, inclusive, that are still to be split.  The most recently
+  // found cut goes into the output first.
+  vector<pair<size_t, size_t>> pieces{{0, ls.size() - 1}};
+  while (!pieces.empty()) {
+    const size_t first = pieces.back().first;
+    const size_t last = pieces.back().second;
+    pieces.pop_back();
+    linestring_type_fp remaining;
+    size_t i = first;
+    while (i < last) {
+      const size_t repeat = next_repeat[i];
+      if (repeat != 0 && repeat <= last && !(remaining.empty() && repeat == last)) {
+        // The piece from i to repeat is a ring that we cut out.  The
+        // entire piece is not a cut.
+        pieces.emplace_back(i, repeat);
+        i = repeat;
+      } else {
+        remaining.push_back(ls[i]);
+        i++;
       }
     }
+    remaining.push_back(ls[last]);
+    ret.push_back(std::move(remaining));
   }
-  // No points repeated so just return the original without recursion.
-  return multi_linestring_type_fp{ls};
+  return ret;
 }
 
 vector<ring_type_fp> get_all_rings(const ring_type_fp& ring) {
@@ -485,61 +660,172 @@ multi_polygon_type_fp simplify_cutins(const ring_type_fp& ring) {
   return ret;
 }
 
-map<int, multi_polygon_type_fp> generate_apertures_map(const gerbv_aperture_t * const apertures[], unsigned int circle_points) {
+// Draw the aperture centered on the origin.
+multi_polygon_type_fp make_aperture(const gerber_parser::Aperture& aperture, const Tessellation& circle_points) {
+  using gerber_parser::ApertureType;
+  using gerber_parser::PrimitiveType;
   const point_type_fp origin (0, 0);
-  map<int, multi_polygon_type_fp> apertures_map;
+  const double * const parameters = aperture.parameters.data();
+  multi_polygon_type_fp input;
+
+  switch (aperture.type) {
+    case ApertureType::CIRCLE:
+      input = make_regular_polygon(origin,
+                                   parameters[0],
+                                   circle_points.use_points(parameters[0]),
+                                   parameters[1],
+                                   parameters[2],
+                                   circle_points);
+      break;
+    case ApertureType::RECTANGLE:
+      input = make_rectangle(origin,
+                             parameters[0],
+                             parameters[1],
+                             parameters[2],
+                             circle_points);
+      break;
+    case ApertureType::OVAL:
+      input = make_oval(origin,
+                        parameters[0],
+                        parameters[1],
+                        parameters[2],
+                        circle_points);
+      break;
+    case ApertureType::POLYGON:
+      input = make_regular_polygon(origin,
+                                   parameters[0],
+                                   parameters[1],
+                                   parameters[2],
+                                   parameters[3],
+                                   circle_points);
+      break;
+    case ApertureType::MACRO:
+      for (const auto& primitive : aperture.primitives) {
+        const double * const parameters = primitive.parameters.data();
+        double rotation = 0;
+        int polarity = 1;
+        multi_polygon_type_fp mpoly;
+        multi_polygon_type_fp mpoly_rotated;
+
+        switch (primitive.type) {
+          case PrimitiveType::CIRCLE:
+            mpoly = make_regular_polygon(point_type_fp(parameters[2], parameters[3]),
+                                         parameters[1],
+                                         circle_points.use_points(parameters[1]),
+                                         0);
+            polarity = parameters[0];
+            rotation = parameters[4];
+            break;
+          case PrimitiveType::OUTLINE: // 4.5.2.6 Outline, Code 4
+            {
+              ring_type_fp ring;
+              for (unsigned int i = 0; i < round(parameters[1]) + 1; i++){
+                ring.push_back(point_type_fp(parameters[i * 2 + 2],
+                                             parameters [i * 2 + 3]));
+              }
+              bg::correct(ring);
+              mpoly = simplify_cutins(ring);
+            }
+            polarity = parameters[0];
+            rotation = parameters[(2 * int(round(parameters[1])) + 4)];
+            break;
+          case PrimitiveType::POLYGON: // 4.12.4.6 Polygon, Primitve Code 5
+            mpoly = make_regular_polygon(point_type_fp(parameters[2], parameters[3]),
+                                         parameters[4],
+                                         parameters[1],
+                                         0);
+            polarity = parameters[0];
+            rotation = parameters[5];
+            break;
+          case PrimitiveType::MOIRE: // 4.12.4.7 Moire, Primitive Code 6
+            mpoly = make_moire(parameters, circle_points);
+            polarity = 1;
+            rotation = parameters[8];
+            break;
+          case PrimitiveType::THERMAL: // 4.12.4.8 Thermal, Primitive Code 7
+            mpoly = make_thermal(point_type_fp(parameters[0], parameters[1]),
+                                 parameters[2],
+                                 parameters[3],
+                                 parameters[4],
+                                 circle_points);
+            polarity = 1;
+            rotation = parameters[5];
+            break;
+          case PrimitiveType::VECTOR_LINE: // 4.12.4.3 Vector Line, Primitive Code 20
+            mpoly = make_rectangle(point_type_fp(parameters[2], parameters[3]),
+                                   point_type_fp(parameters[4], parameters[5]),
+                                   parameters[1]);
+            polarity = parameters[0];
+            rotation = parameters[6];
+            break;
+          case PrimitiveType::CENTER_LINE: // 4.12.4.4 Center Line, Primitive Code 21
+            mpoly = make_rectangle(point_type_fp(parameters[3], parameters[4]),
+                                   parameters[1],
+                                   parameters[2],
+                                   0, circle_points);
+            polarity = parameters[0];
+            rotation = parameters[5];
+            break;
+          case PrimitiveType::LOWER_LEFT_LINE:
+            mpoly = make_rectangle(point_type_fp((parameters[3] + parameters[1] / 2),
+                                                 (parameters[4] + parameters[2] / 2)),
+                                   parameters[1],
+                                   parameters[2],
+                                   0, circle_points);
+            polarity = parameters[0];
+            rotation = parameters[5];
+            break;
+        }
+        // For Boost.Geometry a positive angle is considered
+        // clockwise, for Gerber is the opposite
+        bg::transform(mpoly, mpoly_rotated, rotate_deg(-rotation));
+
+        if (polarity == 0) {
+          input = input - mpoly_rotated;
+        } else {
+          input = input + mpoly_rotated;
+        }
+      }
+      break;
+  }
+  return input;
+}
+
+// Pass gerbv's apertures to the handler.
+void add_gerbv_apertures(const gerbv_aperture_t * const apertures[], gerber_parser::Handler& handler) {
+  using gerber_parser::ApertureType;
+  using gerber_parser::PrimitiveType;
   for (int i = 0; i < APERTURE_MAX; i++) {
     const gerbv_aperture_t * const aperture = apertures[i];
 
     if (aperture) {
-      const double * const parameters = aperture->parameter;
-      multi_polygon_type_fp input;
+      gerber_parser::Aperture converted;
+      converted.parameters.assign(std::begin(aperture->parameter), std::end(aperture->parameter));
 
       switch (aperture->type) {
         case GERBV_APTYPE_NONE:
           continue;
 
         case GERBV_APTYPE_CIRCLE:
-          input = make_regular_polygon(origin,
-                                       parameters[0],
-                                       circle_points,
-                                       parameters[1],
-                                       parameters[2],
-                                       circle_points);
+          converted.type = ApertureType::CIRCLE;
           break;
         case GERBV_APTYPE_RECTANGLE:
-          input = make_rectangle(origin,
-                                 parameters[0],
-                                 parameters[1],
-                                 parameters[2],
-                                 circle_points);
+          converted.type = ApertureType::RECTANGLE;
           break;
         case GERBV_APTYPE_OVAL:
-          input = make_oval(origin,
-                            parameters[0],
-                            parameters[1],
-                            parameters[2],
-                            circle_points);
+          converted.type = ApertureType::OVAL;
           break;
         case GERBV_APTYPE_POLYGON:
-          input = make_regular_polygon(origin,
-                                       parameters[0],
-                                       parameters[1],
-                                       parameters[2],
-                                       parameters[3],
-                                       circle_points);
+          converted.type = ApertureType::POLYGON;
           break;
         case GERBV_APTYPE_MACRO:
           if (aperture->simplified) {
             // I thikn that this means that the marco's variables are substitued.
-            const gerbv_simplified_amacro_t *simplified_amacro = aperture->simplified;
-
-            while (simplified_amacro) {
-              const double * const parameters = simplified_amacro->parameter;
-              double rotation;
-              int polarity;
-              multi_polygon_type_fp mpoly;
-              multi_polygon_type_fp mpoly_rotated;
+            converted.type = ApertureType::MACRO;
+            for (const gerbv_simplified_amacro_t *simplified_amacro = aperture->simplified;
+                 simplified_amacro;
+                 simplified_amacro = simplified_amacro->next) {
+              gerber_parser::MacroPrimitive primitive;
 
               switch (simplified_amacro->type) {
                 case GERBV_APTYPE_NONE:
@@ -548,94 +834,41 @@ map<int, multi_polygon_type_fp> generate_apertures_map(const gerbv_aperture_t *
                 case GERBV_APTYPE_OVAL:
                 case GERBV_APTYPE_POLYGON:
                   cerr << "Non-macro aperture during macro drawing: skipping" << endl;
-                  simplified_amacro = simplified_amacro->next;
                   continue;
                 case GERBV_APTYPE_MACRO:
                   cerr << "Macro start aperture during macro drawing: skipping" << endl;
-                  simplified_amacro = simplified_amacro->next;
                   continue;
                 case GERBV_APTYPE_MACRO_CIRCLE:
-                  mpoly = make_regular_polygon(point_type_fp(parameters[2], parameters[3]),
-                                               parameters[1],
-                                               circle_points,
-                                               0);
-                  polarity = parameters[0];
-                  rotation = parameters[4];
+                  primitive.type = PrimitiveType::CIRCLE;
                   break;
-              case GERBV_APTYPE_MACRO_OUTLINE: // 4.5.2.6 Outline, Code 4
-                  {
-                    ring_type_fp ring;
-                    for (unsigned int i = 0; i < round(parameters[1]) + 1; i++){
-                      ring.push_back(point_type_fp(parameters[i * 2 + 2],
-                                                   parameters [i * 2 + 3]));
-                    }
-                    bg::correct(ring);
-                    mpoly = simplify_cutins(ring);
-                  }
-                  polarity = parameters[0];
-                  rotation = parameters[(2 * int(round(parameters[1])) + 4)];
+                case GERBV_APTYPE_MACRO_OUTLINE:
+                  primitive.type = PrimitiveType::OUTLINE;
                   break;
-                case GERBV_APTYPE_MACRO_POLYGON: // 4.12.4.6 Polygon, Primitve Code 5
-                  mpoly = make_regular_polygon(point_type_fp(parameters[2], parameters[3]),
-                                               parameters[4],
-                                               parameters[1],
-                                               0);
-                  polarity = parameters[0];
-                  rotation = parameters[5];
+                case GERBV_APTYPE_MACRO_POLYGON:
+                  primitive.type = PrimitiveType::POLYGON;
                   break;
-                case GERBV_APTYPE_MACRO_MOIRE: // 4.12.4.7 Moire, Primitive Code 6
-                  mpoly = make_moire(parameters, circle_points);
-                  polarity = 1;
-                  rotation = parameters[8];
+                case GERBV_APTYPE_MACRO_MOIRE:
+                  primitive.type = PrimitiveType::MOIRE;
                   break;
-                case GERBV_APTYPE_MACRO_THERMAL: // 4.12.4.8 Thermal, Primitive Code 7
-                  mpoly = make_thermal(point_type_fp(parameters[0], parameters[1]),
-                                       parameters[2],
-                                       parameters[3],
-                                       parameters[4],
-                                       circle_points);
-                  polarity = 1;
-                  rotation = parameters[5];
+                case GERBV_APTYPE_MACRO_THERMAL:
+                  primitive.type = PrimitiveType::THERMAL;
                   break;
-                case GERBV_APTYPE_MACRO_LINE20: // 4.12.4.3 Vector Line, Primitive Code 20
-                  mpoly = make_rectangle(point_type_fp(parameters[2], parameters[3]),
-                                         point_type_fp(parameters[4], parameters[5]),
-                                         parameters[1]);
-                  polarity = parameters[0];
-                  rotation = parameters[6];
+                case GERBV_APTYPE_MACRO_LINE20:
+                  primitive.type = PrimitiveType::VECTOR_LINE;
                   break;
-                case GERBV_APTYPE_MACRO_LINE21: // 4.12.4.4 Center Line, Primitive Code 21
-                  mpoly = make_rectangle(point_type_fp(parameters[3], parameters[4]),
-                                         parameters[1],
-                                         parameters[2],
-                                         0, 0);
-                  polarity = parameters[0];
-                  rotation = parameters[5];
+                case GERBV_APTYPE_MACRO_LINE21:
+                  primitive.type = PrimitiveType::CENTER_LINE;
                   break;
                 case GERBV_APTYPE_MACRO_LINE22:
-                  mpoly = make_rectangle(point_type_fp((parameters[3] + parameters[1] / 2),
-                                                       (parameters[4] + parameters[2] / 2)),
-                                         parameters[1],
-                                         parameters[2],
-                                         0, 0);
-                  polarity = parameters[0];
-                  rotation = parameters[5];
+                  primitive.type = PrimitiveType::LOWER_LEFT_LINE;
                   break;
                 default:
                   cerr << "Unrecognized aperture: skipping" << endl;
-                  simplified_amacro = simplified_amacro->next;
                   continue;
               }
-              // For Boost.Geometry a positive angle is considered
-              // clockwise, for Gerber is the opposite
-              bg::transform(mpoly, mpoly_rotated, rotate_deg(-rotation));
-
-              if (polarity == 0) {
-                input = input - mpoly_rotated;
-              } else {
-                input = input + mpoly_rotated;
-              }
-              simplified_amacro = simplified_amacro->next;
+              primitive.parameters.assign(std::begin(simplified_amacro->parameter),
+                                          std::end(simplified_amacro->parameter));
+              converted.primitives.push_back(primitive);
             }
           } else {
             cerr << "Macro aperture " << i << " is not simplified: skipping" << endl;
@@ -656,21 +889,93 @@ map<int, multi_polygon_type_fp> generate_apertures_map(const gerbv_aperture_t *
           cerr << "Unrecognized aperture: skipping" << endl;
           continue;
       }
-      apertures_map[i] = input;
+      handler.aperture(i, converted);
+    }
+  }
+}
+
+// Convert a gerbv net into the form that the native parser makes.
+gerber_parser::Net gerbv_net(const gerbv_net_t * const currentNet) {
+  using gerber_parser::Interpolation;
+  using gerber_parser::ApertureState;
+  gerber_parser::Net net;
+  switch (currentNet->layer->polarity) {
+    case GERBV_POLARITY_DARK:
+      net.layer.polarity = gerber_parser::Polarity::DARK;
+      break;
+    case GERBV_POLARITY_CLEAR:
+      net.layer.polarity = gerber_parser::Polarity::CLEAR;
+      break;
+    default:
+      net.layer.polarity = gerber_parser::Polarity::UNSUPPORTED;
+      break;
+  }
+  const gerbv_step_and_repeat_t& stepAndRepeat = currentNet->layer->stepAndRepeat;
+  net.layer.step_and_repeat.x = stepAndRepeat.X;
+  net.layer.step_and_repeat.y = stepAndRepeat.Y;
+  net.layer.step_and_repeat.dist_x = stepAndRepeat.dist_X;
+  net.layer.step_and_repeat.dist_y = stepAndRepeat.dist_Y;
+  net.start = point_type_fp(currentNet->start_x, currentNet->start_y);
+  net.stop = point_type_fp(currentNet->stop_x, currentNet->stop_y);
+  net.aperture = currentNet->aperture;
+  if (currentNet->aperture_state == GERBV_APERTURE_STATE_ON) {
+    net.aperture_state = ApertureState::ON;
+  } else if (currentNet->aperture_state == GERBV_APERTURE_STATE_FLASH) {
+    net.aperture_state = ApertureState::FLASH;
+  } else {
+    net.aperture_state = ApertureState::OFF;
+  }
+  switch (currentNet->interpolation) {
+    case GERBV_INTERPOLATION_LINEARx1:
+      net.interpolation = Interpolation::LINEAR;
+      break;
+    case GERBV_INTERPOLATION_CW_CIRCULAR:
+      net.interpolation = Interpolation::CW_CIRCULAR;
+      break;
+    case GERBV_INTERPOLATION_CCW_CIRCULAR:
+      net.interpolation = Interpolation::CCW_CIRCULAR;
+      break;
+    case GERBV_INTERPOLATION_PAREA_START:
+      net.interpolation = Interpolation::REGION_START;
+      break;
+    case GERBV_INTERPOLATION_PAREA_END:
+      net.interpolation = Interpolation::REGION_END;
+      break;
+    case GERBV_INTERPOLATION_LINEARx10:
+    case GERBV_INTERPOLATION_LINEARx01:
+    case GERBV_INTERPOLATION_LINEARx001:
+      net.interpolation = Interpolation::LINEAR_ZOOMED;
+      break;
+    default:
+      net.interpolation = Interpolation::UNKNOWN;
+      break;
+  }
+  const gerbv_cirseg_t * const cirseg = currentNet->cirseg;
+  if ((net.interpolation == Interpolation::CW_CIRCULAR ||
+       net.interpolation == Interpolation::CCW_CIRCULAR) &&
+      net.aperture_state == ApertureState::ON && cirseg != NULL) {
+    gerber_parser::Arc arc;
+    arc.delta_angle = (cirseg->angle1 - cirseg->angle2) * bg::math::pi<double>() / 180.0;
+    if (net.interpolation == Interpolation::CW_CIRCULAR) {
+      arc.delta_angle = -arc.delta_angle;
     }
+    arc.center = point_type_fp(cirseg->cp_x, cirseg->cp_y);
+    arc.radius = cirseg->width / 2;
+    arc.radius2 = cirseg->height / 2;
+    net.arc = arc;
   }
-  return apertures_map;
+  return net;
 }
 
-bool layers_equivalent(const gerbv_layer_t* const layer1, const gerbv_layer_t* const layer2) {
-  const gerbv_step_and_repeat_t& sr1 = layer1->stepAndRepeat;
-  const gerbv_step_and_repeat_t& sr2 = layer2->stepAndRepeat;
+bool layers_equivalent(const gerber_parser::Layer& layer1, const gerber_parser::Layer& layer2) {
+  const gerber_parser::StepAndRepeat& sr1 = layer1.step_and_repeat;
+  const gerber_parser::StepAndRepeat& sr2 = layer2.step_and_repeat;
 
-  return (layer1->polarity == layer2->polarity &&
-          sr1.X == sr2.X &&
-          sr1.Y == sr2.Y &&
-          sr1.dist_X == sr2.dist_X &&
-          sr1.dist_Y == sr2.dist_Y);
+  return (layer1.polarity == layer2.polarity &&
+          sr1.x == sr2.x &&
+          sr1.y == sr2.y &&
+          sr1.dist_x == sr2.dist_x &&
+          sr1.dist_y == sr2.dist_y);
 }
 
 /* Convert paths that all need to be drawn with the same diameter into shapes.
@@ -681,11 +986,13 @@ bool layers_equivalent(const gerbv_layer_t* const layer1, const gerbv_layer_t* c
  * If there are non-loops when fill_closed_lines is true, we'll report an
  * error.
  */
-mp_pair paths_to_shapes(const coordinate_type_fp& diameter, const multi_linestring_type_fp& paths, bool fill_closed_lines) {
+mp_pair paths_to_shapes(const coordinate_type_fp& diameter, const multi_linestring_type_fp& paths, bool fill_closed_lines,
+                        const Tessellation& circle_points) {
   multi_linestring_type_fp new_paths(paths);
   if (fill_closed_lines) {
     if (merge_near_points(new_paths, diameter) > 0) {
-      cerr << "Some nearly-connected lines in the gerber input have been adjusted to properly connect" << endl;
+      // Diameters are done in parallel so write the whole line at once.
+      cerr << "Some nearly-connected lines in the gerber input have been adjusted to properly connect\n";
     }
   }
   // This converts the many small line segments into the longest paths possible.
@@ -713,84 +1020,80 @@ mp_pair paths_to_shapes(const coordinate_type_fp& diameter, const multi_linestri
   euler_paths.erase(std::remove_if(euler_paths.begin(), euler_paths.end(), [](const linestring_type_fp& l) { return l.size() == 0; }), euler_paths.end());
   if (euler_paths.size() > 0) {
     // This converts the long paths into a shape with thickness equal to the specified diameter.
-    auto new_ovals = bg_helpers::buffer(euler_paths, diameter / 2);
+    // Each path has a round cap on either end.
+    auto new_ovals = bg_helpers::buffer(euler_paths, diameter / 2,
+                                        circle_points.use_points(diameter, euler_paths.size()));
     if (fill_closed_lines) {
       // Assume that this are slots that were drawn as lines.
-      cerr << "Found an unconnected loop while parsing a gerber file while expecting only loops"
-           << endl;
-      ovals.shapes = ovals.shapes + new_ovals;
-    } else {
-      ovals.shapes = ovals.shapes + new_ovals;
+      cerr << "Found an unconnected loop while parsing a gerber file while expecting only loops\n";
     }
+    ovals.shapes = ovals.shapes + new_ovals;
   }
   return ovals;
 }
 
 
-// Convert the gerber file into a pair of multi_polygon_type_fp and a list of
-// linear_paths.  The linear paths are a map from diamter of the tool for the
-// path to all the paths at that diameter.  If fill_closed_lines is true, return
-// all closed shapes without holes in them.  points_per_circle is the number of
-// lines to use to appoximate circles.
-pair<multi_polygon_type_fp, map<coordinate_type_fp, multi_linestring_type_fp>> GerberImporter::render(
-    bool fill_closed_lines,
-    bool render_paths_to_shapes,
-    unsigned int points_per_circle) const {
-  ring_type_fp region;
-  bool contour = false; // Are we in contour mode?
-
-  vector<pair<const gerbv_layer_t *, vector<mp_pair>>> layers(1);
-
-  gerbv_image_t *gerber = project->file[0]->image;
-
-  if (gerber->info->polarity != GERBV_POLARITY_POSITIVE) {
-    unsupported_polarity_throw_exception();
+// Builds the shapes of a gerber file from its apertures and nets, which
+// must be provided in the same order as in the file.
+class GerberRenderer : public gerber_parser::Handler {
+ public:
+  GerberRenderer(bool fill_closed_lines, bool render_paths_to_shapes, const Tessellation& circle_points) :
+      fill_closed_lines(fill_closed_lines),
+      render_paths_to_shapes(render_paths_to_shapes),
+      circle_points(circle_points),
+      contour(false) {}
+
+  void aperture(int number, const gerber_parser::Aperture& aperture) override {
+    apertures[number] = aperture;
+    // The aperture is only made once so count its points for each flash
+    // instead.
+    tessellation::Stats counts;
+    aperture_templates[number] = std::make_shared<const ApertureTemplate>(
+        make_aperture(aperture, circle_points.counting_into(counts)));
+    aperture_points[number] = make_pair(counts.points.load(), counts.fixed_points.load());
   }
 
-  const map<int, multi_polygon_type_fp> apertures_map = generate_apertures_map(gerber->aperture, points_per_circle);
-  layers.front().first = gerber->netlist->layer;
-
-
-  map<coordinate_type_fp, multi_linestring_type_fp> linear_circular_paths;
-  for (gerbv_net_t *currentNet = gerber->netlist; currentNet; currentNet = currentNet->next) {
-    const point_type_fp start (currentNet->start_x, currentNet->start_y);
-    const point_type_fp stop (currentNet->stop_x, currentNet->stop_y);
-    const double * const parameters = gerber->aperture[currentNet->aperture]->parameter;
+  void net(const gerber_parser::Net& currentNet) override {
+    using gerber_parser::Interpolation;
+    using gerber_parser::ApertureState;
+    using gerber_parser::ApertureType;
+    const point_type_fp& start = currentNet.start;
+    const point_type_fp& stop = currentNet.stop;
     multi_polygon_type_fp mpoly;
 
-    if (!layers_equivalent(currentNet->layer, layers.back().first)) {
+    if (layers.empty() || !layers_equivalent(currentNet.layer, layers.back().layer)) {
       if (render_paths_to_shapes) {
         // About to start a new layer, render all the linear_circular_paths so far.
-        for (const auto& diameter_and_path : linear_circular_paths) {
-          layers.back().second.push_back(paths_to_shapes(diameter_and_path.first, diameter_and_path.second, fill_closed_lines));
-        }
-        linear_circular_paths.clear();
+        render_paths();
       }
       layers.resize(layers.size() + 1);
-      layers.back().first = currentNet->layer;
+      layers.back().layer = currentNet.layer;
     }
 
-    vector<mp_pair>& draws = layers.back().second;
+    vector<mp_pair>& draws = layers.back().draws;
+    const auto aperture = apertures.find(currentNet.aperture);
+    const bool circle = aperture != apertures.cend() && aperture->second.type == ApertureType::CIRCLE;
+    const bool rectangle = aperture != apertures.cend() && aperture->second.type == ApertureType::RECTANGLE;
 
-    if (currentNet->interpolation == GERBV_INTERPOLATION_LINEARx1) {
-      if (currentNet->aperture_state == GERBV_APERTURE_STATE_ON) {
+    if (currentNet.interpolation == Interpolation::LINEAR) {
+      if (currentNet.aperture_state == ApertureState::ON) {
         if (contour) {
           if (region.empty()) {
             bg::append(region, start);
           }
           bg::append(region, stop);
         } else {
-          if (gerber->aperture[currentNet->aperture]->type == GERBV_APTYPE_CIRCLE) {
+          if (circle) {
             // These are common and too slow to merge one by one so we put them
             // all together and then do one big union at the end.
-            const double diameter = parameters[0];
+            const double diameter = aperture->second.parameters[0];
             linestring_type_fp segment;
             segment.push_back(start);
             segment.push_back(stop);
             linear_circular_paths[diameter].push_back(segment);
-          } else if (gerber->aperture[currentNet->aperture]->type == GERBV_APTYPE_RECTANGLE) {
-            mpoly = linear_draw_rectangular_aperture(start, stop, parameters[0],
-                                                     parameters[1]);
+          } else if (rectangle) {
+            mpoly = linear_draw_rectangular_aperture(start, stop, aperture->second.parameters[0],
+                                                     aperture->second.parameters[1]);
             draws.push_back(mpoly);
           } else {
             cerr << ("Drawing with an aperture different from a circle "
@@ -798,59 +1101,43 @@ pair<multi_polygon_type_fp, map<coordinate_type_fp, multi_linestring_type_fp>> G
                  << endl;
           }
         }
-      } else if (currentNet->aperture_state == GERBV_APERTURE_STATE_FLASH) {
+      } else if (currentNet.aperture_state == ApertureState::FLASH) {
         if (contour) {
           cerr << ("D03 during contour mode is forbidden by the Gerber "
                    "standard; skipping") << endl;
         } else {
-          const auto aperture_mpoly = apertures_map.find(currentNet->aperture);
+          const auto aperture_template = aperture_templates.find(currentNet.aperture);
 
-          if (aperture_mpoly != apertures_map.end()) {
-            bg::transform(aperture_mpoly->second, mpoly, translate(stop.x(), stop.y()));
+          if (aperture_template != aperture_templates.end()) {
+            layers.back().flashes.push_back({aperture_template->second, stop, draws.size()});
+            tessellation::stats().points += aperture_points[currentNet.aperture].first;
+            tessellation::stats().fixed_points += aperture_points[currentNet.aperture].second;
           } else {
-            cerr << "Macro aperture " << currentNet->aperture <<
+            cerr << "Macro aperture " << currentNet.aperture <<
                 " not found in macros list; skipping" << endl;
           }
-          draws.push_back(mpoly);
         }
-      } else if (currentNet->aperture_state == GERBV_APERTURE_STATE_OFF) {
+      } else {
         if (contour) {
-          if (region.size() > 0 && region.front() != region.back()) {
-            cerr << "Repairing invalid contour (EasyEDA makes these sometimes): " << bg::wkt(region) << std::endl;
-            bg::append(region, region.front());
-          }
-          draws.push_back(simplify_cutins(region));
-          region.clear();
+          close_region(draws);
         }
-      } else {
-        cerr << "Unrecognized aperture state: skipping" << endl;
       }
-    } else if (currentNet->interpolation == GERBV_INTERPOLATION_PAREA_START) {
+    } else if (currentNet.interpolation == Interpolation::REGION_START) {
       contour = true;
-    } else if (currentNet->interpolation == GERBV_INTERPOLATION_PAREA_END) {
+    } else if (currentNet.interpolation == Interpolation::REGION_END) {
       contour = false;
-      if (region.size() > 0 && region.front() != region.back()) {
-        cerr << "Repairing invalid contour (EasyEDA makes these sometimes): " << bg::wkt(region) << std::endl;
-        bg::append(region, region.front());
-      }
-      draws.push_back(simplify_cutins(region));
-      region.clear();
-    } else if (currentNet->interpolation == GERBV_INTERPOLATION_CW_CIRCULAR ||
-               currentNet->interpolation == GERBV_INTERPOLATION_CCW_CIRCULAR) {
-      if (currentNet->aperture_state == GERBV_APERTURE_STATE_ON) {
-        const gerbv_cirseg_t * const cirseg = currentNet->cirseg;
-        if (cirseg != NULL) {
-          double delta_angle = (cirseg->angle1 - cirseg->angle2) * bg::math::pi<double>() / 180.0;
-          if (currentNet->interpolation == GERBV_INTERPOLATION_CW_CIRCULAR) {
-            delta_angle = -delta_angle;
-          }
-          point_type_fp center(cirseg->cp_x, cirseg->cp_y);
-          linestring_type_fp path = circular_arc(start, stop, center,
-                                                 cirseg->width / 2,
-                                                 cirseg->height / 2,
-                                                 delta_angle,
-                                                 currentNet->interpolation == GERBV_INTERPOLATION_CW_CIRCULAR,
-                                                 points_per_circle);
+      close_region(draws);
+    } else if (currentNet.interpolation == Interpolation::CW_CIRCULAR ||
+               currentNet.interpolation == Interpolation::CCW_CIRCULAR) {
+      if (currentNet.aperture_state == ApertureState::ON) {
+        if (currentNet.arc) {
+          const gerber_parser::Arc& arc = *currentNet.arc;
+          linestring_type_fp path = circular_arc(start, stop, arc.center,
+                                                 arc.radius,
+                                                 arc.radius2,
+                                                 arc.delta_angle,
+                                                 currentNet.interpolation == Interpolation::CW_CIRCULAR,
+                                                 circle_points);
           if (contour) {
             if (region.empty()) {
               region.insert(region.end(), path.begin(), path.end());
@@ -858,8 +1145,8 @@ pair<multi_polygon_type_fp, map<coordinate_type_fp, multi_linestring_type_fp>> G
               region.insert(region.end(), path.begin() + 1, path.end());
             }
           } else {
-            if (gerber->aperture[currentNet->aperture]->type == GERBV_APTYPE_CIRCLE) {
-              const double diameter = parameters[0];
+            if (circle) {
+              const double diameter = aperture->second.parameters[0];
               for (size_t i = 1; i < path.size(); i++) {
                 linestring_type_fp segment;
                 segment.push_back(path[i-1]);
@@ -875,49 +1162,140 @@ pair<multi_polygon_type_fp, map<coordinate_type_fp, multi_linestring_type_fp>> G
         } else {
           cerr << "Circular arc requested but cirseg == NULL" << endl;
         }
-      } else if (currentNet->aperture_state == GERBV_APERTURE_STATE_FLASH) {
+      } else if (currentNet.aperture_state == ApertureState::FLASH) {
         cerr << "D03 during circular arc mode is forbidden by the Gerber "
             "standard; skipping" << endl;
       }
-    } else if (currentNet->interpolation == GERBV_INTERPOLATION_LINEARx10 ||
-               currentNet->interpolation == GERBV_INTERPOLATION_LINEARx01 || 
-               currentNet->interpolation == GERBV_INTERPOLATION_LINEARx001 ) {
+    } else if (currentNet.interpolation == Interpolation::LINEAR_ZOOMED) {
       cerr << ("Linear zoomed interpolation modes are not supported "
                "(are they in the RS274X standard?)") << endl;
-    } else { //if (currentNet->interpolation != GERBV_INTERPOLATION_DELETED)
+    } else {
       cerr << "Unrecognized interpolation mode" << endl;
     }
   }
-  if (render_paths_to_shapes) {
-    // If there are any unrendered circular paths, add them to the last layer.
-    for (const auto& diameter_and_path : linear_circular_paths) {
-      layers.back().second.push_back(paths_to_shapes(diameter_and_path.first, diameter_and_path.second, fill_closed_lines));
+
+  // Combine everything drawn so far into the output.
+  pair<multi_polygon_type_fp, map<coordinate_type_fp, multi_linestring_type_fp>> finish() {
+    if (layers.empty()) {
+      layers.resize(1); // Nothing was drawn.
+    }
+    if (render_paths_to_shapes) {
+      // If there are any unrendered circular paths, add them to the last layer.
+      render_paths();
+    }
+    // The layers are independent until they are combined so merge the draws in
+    // each one in parallel.
+    vector<pair<gerber_parser::Layer, mp_pair>> merged_layers(layers.size());
+    thread_pool::parallel_for(layers.size(), [&](size_t i) {
+      merged_layers[i] = make_pair(layers[i].layer,
+                                   merge_multi_draws(std::move(layers[i].draws), layers[i].flashes));
+      layers[i].flashes.clear();
+    });
+    auto result = generate_layers(merged_layers, &mp_pair::filled_closed_lines, fill_closed_lines);
+    if (fill_closed_lines) {
+      result = result - generate_layers(merged_layers, &mp_pair::shapes, false);
+    } else {
+      result = result + generate_layers(merged_layers, &mp_pair::shapes, false);
+    }
+
+    for (auto& path : linear_circular_paths) {
+      path.second = eulerian_paths::make_eulerian_paths(path.second, true, true);
+    }
+    return make_pair(result, linear_circular_paths);
+  }
+
+ private:
+  void render_paths() {
+    if (linear_circular_paths.empty()) {
+      return;
     }
+    // The diameters are independent until the draws are merged so do them
+    // in parallel, keeping the draws in order of diameter.
+    const vector<pair<coordinate_type_fp, multi_linestring_type_fp>> diameters_and_paths(
+        make_move_iterator(linear_circular_paths.begin()),
+        make_move_iterator(linear_circular_paths.end()));
     linear_circular_paths.clear();
+    auto shapes = thread_pool::parallel_map(
+        diameters_and_paths,
+        [&](const pair<coordinate_type_fp, multi_linestring_type_fp>& diameter_and_path) {
+          return paths_to_shapes(diameter_and_path.first, diameter_and_path.second, fill_closed_lines,
+                                 circle_points);
+        });
+    auto& draws = layers.back().draws;
+    draws.insert(draws.end(), make_move_iterator(shapes.begin()), make_move_iterator(shapes.end()));
   }
-  vector<pair<const gerbv_layer_t *, mp_pair>> merged_layers;
-  merged_layers.reserve(layers.size());
-  for (const auto& layer : layers) {
-    merged_layers.emplace_back(layer.first, merge_multi_draws(layer.second));
+
+  void close_region(vector<mp_pair>& draws) {
+    if (region.size() > 0 && region.front() != region.back()) {
+      cerr << "Repairing invalid contour (EasyEDA makes these sometimes): " << bg::wkt(region) << std::endl;
+      bg::append(region, region.front());
+    }
+    draws.push_back(simplify_cutins(region));
+    region.clear();
   }
-  auto result = generate_layers(merged_layers, &mp_pair::filled_closed_lines, fill_closed_lines);
-  if (fill_closed_lines) {
-    result = result - generate_layers(merged_layers, &mp_pair::shapes, false);
-  } else {
-    result = result + generate_layers(merged_layers, &mp_pair::shapes, false);
+
+  const bool fill_closed_lines;
+  const bool render_paths_to_shapes;
+  const Tessellation circle_points;
+
+  ring_type_fp region;
+  bool contour; // Are we in contour mode?
+  // Everything drawn, in order of the changes of polarity and step and
+  // repeat.
+  struct LayerDraws {
+    gerber_parser::Layer layer;
+    vector<mp_pair> draws;
+    vector<Flash> flashes;
+  };
+  vector<LayerDraws> layers;
+  map<coordinate_type_fp, multi_linestring_type_fp> linear_circular_paths;
+  map<int, gerber_parser::Aperture> apertures;
+  map<int, std::shared_ptr<const ApertureTemplate>> aperture_templates;
+  map<int, pair<uint64_t, uint64_t>> aperture_points;
+};
+
+// Convert the gerber file into a pair of multi_polygon_type_fp and a list of
+// linear_paths.  The linear paths are a map from diamter of the tool for the
+// path to all the paths at that diameter.  If fill_closed_lines is true, return
+// all closed shapes without holes in them.  circle_points decides the number of
+// lines to use to appoximate circles.
+pair<multi_polygon_type_fp, map<coordinate_type_fp, multi_linestring_type_fp>> GerberImporter::render(
+    bool fill_closed_lines,
+    bool render_paths_to_shapes,
+    const Tessellation& circle_points) const {
+  GerberRenderer renderer(fill_closed_lines, render_paths_to_shapes, circle_points);
+
+  if (!project) {
+    // The native parser streams the file straight into the renderer.
+    try {
+      gerber_parser::parse_file(path, renderer);
+    } catch (const gerber_parser::parse_error& e) {
+      cerr << "Error reading " << path << ": " << e.what() << endl;
+      throw gerber_exception();
+    }
+    return renderer.finish();
   }
 
+  gerbv_image_t *gerber = project->file[0]->image;
+
+  if (gerber->info->polarity != GERBV_POLARITY_POSITIVE) {
+    unsupported_polarity_throw_exception();
+  }
+
+  add_gerbv_apertures(gerber->aperture, renderer);
+  for (gerbv_net_t *currentNet = gerber->netlist; currentNet; currentNet = currentNet->next) {
+    renderer.net(gerbv_net(currentNet));
+  }
+  auto result = renderer.finish();
+
   if (gerber->netlist->state->unit == GERBV_UNIT_MM) {
     // I don't believe that this ever happens because I think that gerbv
     // internally converts everything to inches.
     multi_polygon_type_fp scaled_result;
-    bg::transform(result, scaled_result,
+    bg::transform(result.first, scaled_result,
                   bg::strategy::transform::scale_transformer<coordinate_type_fp, 2, 2>(
                       1/25.4, 1/25.4));
-    result.swap(scaled_result);
-  }
-  for (auto& path : linear_circular_paths) {
-    path.second = eulerian_paths::make_eulerian_paths(path.second, true, true);
+    result.first.swap(scaled_result);
   }
-  return make_pair(result, linear_circular_paths);
+  return result;
 }
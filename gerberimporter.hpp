@@ -27,6 +27,7 @@
 #include <map>
 
 #include "geometry.hpp"
+#include "tessellation.hpp"
 
 extern "C" {
 #include <gerbv.h>
@@ -45,12 +46,14 @@ class gerber_exception: public std::exception {};
  Importer for RS274-X Gerber files.
 
  GerberImporter is using libgerbv and hence features its suberb support for
- different file formats and gerber dialects.
+ different file formats and gerber dialects.  Alternatively, the native
+ streaming parser in gerber_parser.hpp can be used, which is faster and
+ uses much less memory on large files.
  */
 /******************************************************************************/
 class GerberImporter {
 public:
-  GerberImporter();
+  explicit GerberImporter(bool native_parser = false);
   bool load_file(const std::string& path);
   virtual ~GerberImporter();
 
@@ -59,7 +62,7 @@ public:
   virtual std::pair<multi_polygon_type_fp, std::map<coordinate_type_fp, multi_linestring_type_fp>> render(
       bool fill_closed_lines,
       bool render_paths_to_shapes,
-      unsigned int points_per_circle) const;
+      const tessellation::Tessellation& circle_points) const;
   const gerbv_project_t* get_project() const {
     return project;
   }
@@ -68,7 +71,17 @@ protected:
   enum Side { FRONT = 0, BACK = 1 } side;
 
 private:
+  // Only for gerbv.
   gerbv_project_t* project;
+  // Only for the native parser, which reads the file again when rendering.
+  std::string path;
+  box_type_fp bounding_box;
 };
 
+// Splits ls into rings at each point that it visits more than once.
+// Gerber regions use cut-ins like this to draw holes.
+multi_linestring_type_fp get_all_ls(const linestring_type_fp& ls);
+// Turns a region with cut-ins into the shapes that it fills.
+multi_polygon_type_fp simplify_cutins(const ring_type_fp& ring);
+
 #endif // GERBERIMPORTER_H
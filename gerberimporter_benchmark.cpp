@@ -0,0 +1,124 @@
+// Compares the time to import gerber files with gerbv and with the
+// native streaming parser.  Run it from the top of the source tree:
+//
+//   make gerberimporter_benchmark && ./gerberimporter_benchmark [directory]
+//
+// The default directory is testing/gerbv_example.  The front, back and
+// outline files from the millproject in each subdirectory are loaded
+// and rendered with both importers.  The difference is the area drawn
+// by only one of the two, relative to the area drawn by gerbv.
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/algorithm/string.hpp>
+
+#include "gerberimporter.hpp"
+#include "bg_operators.hpp"
+
+using std::cout;
+using std::endl;
+using std::string;
+using std::vector;
+
+vector<string> list_directories(const string& path) {
+  vector<string> ret;
+  DIR* dir = opendir(path.c_str());
+  if (dir == nullptr) {
+    return ret;
+  }
+  while (const struct dirent* entry = readdir(dir)) {
+    const string name = entry->d_name;
+    struct stat info;
+    if (name != "." && name != ".." &&
+        stat((path + "/" + name).c_str(), &info) == 0 && S_ISDIR(info.st_mode)) {
+      ret.push_back(path + "/" + name);
+    }
+  }
+  closedir(dir);
+  std::sort(ret.begin(), ret.end());
+  return ret;
+}
+
+// The gerber files in the millproject of the directory.
+vector<string> gerber_files(const string& directory) {
+  vector<string> ret;
+  std::ifstream millproject(directory + "/millproject");
+  string line;
+  while (std::getline(millproject, line)) {
+    const size_t equals = line.find('=');
+    if (equals == string::npos) {
+      continue;
+    }
+    const string key = boost::trim_copy(line.substr(0, equals));
+    if (key == "front" || key == "back" || key == "outline") {
+      ret.push_back(directory + "/" + boost::trim_copy(line.substr(equals + 1)));
+    }
+  }
+  return ret;
+}
+
+struct Result {
+  bool ok;
+  double seconds;
+  multi_polygon_type_fp shapes;
+};
+
+Result import(const string& path, bool native_parser) {
+  const auto start = std::chrono::steady_clock::now();
+  GerberImporter importer(native_parser);
+  Result result;
+  result.ok = importer.load_file(path);
+  if (result.ok) {
+    result.shapes = importer.render(false, true, tessellation::Tessellation(30)).first;
+  }
+  result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return result;
+}
+
+int main(int argc, char* argv[]) {
+  const string directory = argc > 1 ? argv[1] : "testing/gerbv_example";
+  double gerbv_total = 0;
+  double native_total = 0;
+  cout << std::left << std::setw(70) << "file"
+       << std::right << std::setw(12) << "gerbv (s)"
+       << std::setw(12) << "native (s)"
+       << std::setw(10) << "speedup"
+       << std::setw(14) << "difference" << endl;
+  for (const auto& project : list_directories(directory)) {
+    for (const auto& path : gerber_files(project)) {
+      const Result gerbv = import(path, false);
+      const Result native = import(path, true);
+      cout << std::left << std::setw(70) << path.substr(directory.size() + 1) << std::right;
+      if (!gerbv.ok || !native.ok) {
+        cout << "  failed to load with" << (gerbv.ok ? "" : " gerbv") << (native.ok ? "" : " native") << endl;
+        continue;
+      }
+      gerbv_total += gerbv.seconds;
+      native_total += native.seconds;
+      const double area = bg::area(gerbv.shapes);
+      const double difference = area > 0 ? bg::area(gerbv.shapes ^ native.shapes) / area : 0;
+      cout << std::fixed << std::setprecision(4)
+           << std::setw(12) << gerbv.seconds
+           << std::setw(12) << native.seconds
+           << std::setprecision(2)
+           << std::setw(9) << gerbv.seconds / native.seconds << "x"
+           << std::setprecision(4)
+           << std::setw(13) << difference * 100 << "%" << endl;
+    }
+  }
+  cout << std::left << std::setw(70) << "total" << std::right
+       << std::fixed << std::setprecision(4)
+       << std::setw(12) << gerbv_total
+       << std::setw(12) << native_total
+       << std::setprecision(2)
+       << std::setw(9) << (native_total > 0 ? gerbv_total / native_total : 0) << "x" << endl;
+}
@@ -3,6 +3,7 @@
 #include <boost/test/data/test_case.hpp>
 
 #include "gerberimporter.hpp"
+#include "bg_operators.hpp"
 #include <sys/types.h>
 #include <dirent.h>
 #include <glibmm/init.h>
@@ -181,7 +182,7 @@ void test_one(const string& gerber_file, double max_error_rate) {
   gerber_path += gerber_file;
   auto g = GerberImporter();
   BOOST_REQUIRE(g.load_file(gerber_path));
-  multi_polygon_type_fp polys = g.render(false, true, 360).first;
+  multi_polygon_type_fp polys = g.render(false, true, tessellation::Tessellation(360)).first;
   box_type_fp bounding_box;
   bg::envelope(polys, bounding_box);
   bg::expand(bounding_box, g.get_bounding_box());
@@ -226,7 +227,7 @@ void test_visual(const string& gerber_file, bool fill_closed_lines, double min_s
   gerber_path += gerber_file;
   auto g = GerberImporter();
   BOOST_REQUIRE(g.load_file(gerber_path));
-  multi_polygon_type_fp polys = g.render(fill_closed_lines, true, 30).first;
+  multi_polygon_type_fp polys = g.render(fill_closed_lines, true, tessellation::Tessellation(30)).first;
   box_type_fp bounding_box;
   bg::envelope(polys, bounding_box);
   Cairo::RefPtr<Cairo::ImageSurface> cairo_surface = create_cairo_surface(width(bounding_box) * dpi, height(bounding_box) * dpi);
@@ -304,6 +305,56 @@ BOOST_DATA_TEST_CASE(gerberimporter_visual,
   test_visual(gerber_file, fill_closed_lines, min_set_ratio, max_set_ratio);
 }
 
+// The native parser should draw the same shapes as gerbv.
+BOOST_DATA_TEST_CASE(native_parser_match_gerbv,
+                     boost::unit_test::data::make(
+                         std::vector<std::string>{
+                           "overlapping_lines.gbr",
+                           "levels.gbr",
+                           "levels_step_and_repeat.gbr",
+                           "code22_lower_left_line.gbr",
+                           "code4_outline.gbr",
+                           "code5_polygon.gbr",
+                           "code21_center_line.gbr",
+                           "polygon.gbr",
+                           "wide_oval.gbr",
+                           "rectangle.gbr",
+                           "code1_circle.gbr",
+                           "code20_vector_line.gbr",
+                           "moire.gbr",
+                           "thermal.gbr",
+                           "circular_arcs.gbr",
+                           "cutins.gbr"}),
+                     gerber_file) {
+  const char *skip_test = std::getenv("SKIP_GERBERIMPORTER_TESTS");
+  if (skip_test != nullptr) {
+    std::cout << "Skipping because SKIP_GERBERIMPORTER_TESTS is set in environment." << std::endl;
+    return;
+  }
+  const string gerber_path = gerber_directory + "/" + gerber_file;
+  auto gerbv = GerberImporter();
+  BOOST_REQUIRE(gerbv.load_file(gerber_path));
+  auto native = GerberImporter(true);
+  BOOST_REQUIRE(native.load_file(gerber_path));
+  const auto gerbv_polys = gerbv.render(false, true, tessellation::Tessellation(30)).first;
+  const auto native_polys = native.render(false, true, tessellation::Tessellation(30)).first;
+  BOOST_CHECK_LE(bg::area(gerbv_polys ^ native_polys), bg::area(gerbv_polys) * 0.001);
+}
+
+BOOST_AUTO_TEST_CASE(cut_ins) {
+  // A square with a hole, drawn with a cut-in like KiCad does.
+  linestring_type_fp ls;
+  bg::read_wkt("LINESTRING(0 0,10 0,10 10,0 10,0 5,3 5,3 7,6 7,6 5,3 5,0 5,0 0)", ls);
+  multi_linestring_type_fp expected;
+  bg::read_wkt("MULTILINESTRING((0 0,10 0,10 10,0 10,0 5,0 0),"
+               "(0 5,3 5,0 5),"
+               "(3 5,3 7,6 7,6 5,3 5))", expected);
+  BOOST_CHECK(get_all_ls(ls) == expected);
+  const auto shapes = simplify_cutins(ring_type_fp(ls.cbegin(), ls.cend()));
+  BOOST_CHECK_EQUAL(shapes.size(), 1);
+  BOOST_CHECK_CLOSE(bg::area(shapes), 94, 1e-9);
+}
+
 BOOST_AUTO_TEST_CASE(gerbv_exceptions) {
   auto g = GerberImporter();
   BOOST_CHECK(!g.load_file("foo.gbr"));
@@ -27,7 +27,8 @@ TestCase = collections.namedtuple("TestCase", ["name", "input_path", "args", "ex
 
 EXAMPLES_PATH = "testing/gerbv_example"
 BROKEN_EXAMPLES_PATH = "testing/broken_examples"
-TEST_CASES = ([TestCase(x, os.path.join(EXAMPLES_PATH, x), [], 0)
+# The expected outputs include all of the debug images.
+TEST_CASES = ([TestCase(x, os.path.join(EXAMPLES_PATH, x), ["--debug-images=full"], 0)
               for x in [
                   "am-test",
                   "am-test-counterclockwise",
@@ -42,9 +42,13 @@ using std::string;
 #include "gerberimporter.hpp"
 #include "ngc_exporter.hpp"
 #include "board.hpp"
+#include "cascaded_union.hpp"
 #include "drill.hpp"
 #include "options.hpp"
+#include "tessellation.hpp"
 #include "units.hpp"
+#include "thread_pool.hpp"
+#include "svg_writer.hpp"
 
 #include <boost/algorithm/string.hpp>
 #include <boost/version.hpp>
@@ -84,6 +88,7 @@ void do_pcb2gcode(int argc, const char* argv[]) {
     //---------------------------------------------------------------------------
     //prepare environment:
 
+    thread_pool::set_jobs(vm["jobs"].as<size_t>());
     const bool ymirror = vm["mirror-yaxis"].as<bool>();
     const double tolerance = vm["tolerance"].as<double>() * unit;
     const bool explicit_tolerance = !vm["nog64"].as<bool>();
@@ -116,8 +121,15 @@ void do_pcb2gcode(int argc, const char* argv[]) {
         isolator->optimise = vm["optimise"].as<Length>().asInch(unit);
         isolator->offset = vm["offset"].as<Length>().asInch(unit);
         isolator->preserve_thermal_reliefs = vm["preserve-thermal-reliefs"].as<bool>();
+        isolator->incremental_offsets = vm["incremental-offsets"].as<bool>();
+        isolator->contentions_report = vm["contentions-report"].as<bool>();
         isolator->eulerian_paths = vm["eulerian-paths"].as<bool>();
         isolator->path_finding_limit = vm["path-finding-limit"].as<size_t>();
+        isolator->path_finding_candidates = vm["path-finding-candidates"].as<size_t>();
+        isolator->shared_path_search = vm["shared-path-search"].as<bool>();
+        isolator->path_finding_visibility_graph = vm["path-finding-visibility-graph"].as<bool>();
+        isolator->path_finding_bidirectional = vm["path-finding-bidirectional"].as<bool>();
+        isolator->path_finding_landmarks = vm["path-finding-landmarks"].as<size_t>();
         isolator->g0_vertical_speed = vm["g0-vertical-speed"].as<Velocity>().asInchPerMinute(unit);
         isolator->g0_horizontal_speed = vm["g0-horizontal-speed"].as<Velocity>().asInchPerMinute(unit);
         isolator->backtrack = vm["backtrack"].as<Velocity>().asInchPerMinute(unit);
@@ -156,6 +168,11 @@ void do_pcb2gcode(int argc, const char* argv[]) {
       cutter->offset = vm["offset"].as<Length>().asInch(unit);
       cutter->eulerian_paths = vm["eulerian-paths"].as<bool>();
       cutter->path_finding_limit = vm["path-finding-limit"].as<size_t>();
+      cutter->path_finding_candidates = vm["path-finding-candidates"].as<size_t>();
+      cutter->shared_path_search = vm["shared-path-search"].as<bool>();
+      cutter->path_finding_visibility_graph = vm["path-finding-visibility-graph"].as<bool>();
+      cutter->path_finding_bidirectional = vm["path-finding-bidirectional"].as<bool>();
+      cutter->path_finding_landmarks = vm["path-finding-landmarks"].as<size_t>();
       cutter->g0_vertical_speed = vm["g0-vertical-speed"].as<Velocity>().asInchPerMinute(unit);
       cutter->g0_horizontal_speed = vm["g0-horizontal-speed"].as<Velocity>().asInchPerMinute(unit);
       cutter->tolerance = tolerance;
@@ -266,7 +283,10 @@ void do_pcb2gcode(int argc, const char* argv[]) {
         vm["tsp-2opt"].as<bool>(),
         vm["mill-feed-direction"].as<MillFeedDirection::MillFeedDirection>(),
         vm["invert-gerbers"].as<bool>(),
-        !vm["draw-gerber-lines"].as<bool>());
+        !vm["draw-gerber-lines"].as<bool>(),
+        vm["adaptive-tessellation"].as<bool>(),
+        vm["check-self-intersections"].as<bool>(),
+        vm["debug-images"].as<DebugImages::DebugImages>());
 
     // this is currently disabled, use --outline instead
     if (vm.count("margins"))
@@ -277,14 +297,31 @@ void do_pcb2gcode(int argc, const char* argv[]) {
     //--------------------------------------------------------------------------
     //load files, import layer files, create surface:
 
+    // The layers are independent so parse them all at once.  Parser warnings
+    // can't be attributed to a per-layer line while they all run, so they are
+    // reported under a single heading.
+    cout << "Importing layers... " << flush;
+    const vector<string> layer_names{"front", "back", "outline"};
+    const auto importers = thread_pool::parallel_map(
+        layer_names,
+        [&](const string& layer_name) -> shared_ptr<GerberImporter> {
+          if (vm.count(layer_name) == 0) {
+            return nullptr;
+          }
+          auto importer = make_shared<GerberImporter>(vm["native-gerber-parser"].as<bool>());
+          if (!importer->load_file(vm[layer_name].as<string>())) {
+            return nullptr;
+          }
+          return importer;
+        });
+    cout << "DONE.\n";
+
     cout << "Importing front side... " << flush;
     if (vm.count("front") > 0) {
-      string frontfile = vm["front"].as<string>();
-      auto importer = make_shared<GerberImporter>();
-      if (!importer->load_file(frontfile)) {
+      if (!importers[0]) {
         options::maybe_throw("ERROR.", ERR_INVALIDPARAMETER);
       }
-      board->prepareLayer("front", importer, isolator, false, ymirror);
+      board->prepareLayer("front", importers[0], isolator, false, ymirror);
       cout << "DONE.\n";
     } else {
       cout << "not specified.\n";
@@ -292,12 +329,10 @@ void do_pcb2gcode(int argc, const char* argv[]) {
 
     cout << "Importing back side... " << flush;
     if (vm.count("back") > 0) {
-      string backfile = vm["back"].as<string>();
-      auto importer = make_shared<GerberImporter>();
-      if (!importer->load_file(backfile)) {
+      if (!importers[1]) {
         options::maybe_throw("ERROR.", ERR_INVALIDPARAMETER);
       }
-      board->prepareLayer("back", importer, isolator, true, ymirror);
+      board->prepareLayer("back", importers[1], isolator, true, ymirror);
       cout << "DONE.\n";
     } else {
       cout << "not specified.\n";
@@ -305,12 +340,10 @@ void do_pcb2gcode(int argc, const char* argv[]) {
 
     cout << "Importing outline... " << flush;
     if (vm.count("outline") > 0) {
-      string outline = vm["outline"].as<string>();
-      auto importer = make_shared<GerberImporter>();
-      if (!importer->load_file(outline)) {
+      if (!importers[2]) {
         options::maybe_throw("ERROR.", ERR_INVALIDPARAMETER);
       }
-      board->prepareLayer("outline", importer, cutter, !workSide(vm, "cut"), ymirror);
+      board->prepareLayer("outline", importers[2], cutter, !workSide(vm, "cut"), ymirror);
       cout << "DONE.\n";
     } else {
       cout << "not specified.\n";
@@ -319,6 +352,15 @@ void do_pcb2gcode(int argc, const char* argv[]) {
     cout << "Processing input files... " << flush;
     board->createLayers();
     cout << "DONE.\n";
+    if (vm["union-stats"].as<bool>()) {
+      cout << "Merged shapes with " << cascaded_union::stats().calls << " unions in "
+           << cascaded_union::stats().seconds() << " seconds.\n";
+    }
+    if (vm["adaptive-tessellation"].as<bool>()) {
+      cout << "Approximated circles and arcs with " << tessellation::stats().points
+           << " vertices (" << tessellation::stats().fixed_points
+           << " with a fixed 30 per circle).\n";
+    }
 
     if (!vm["no-export"].as<bool>()) {
       auto exporter = make_shared<NGC_Exporter>(board);
@@ -411,6 +453,7 @@ void do_pcb2gcode(int argc, const char* argv[]) {
         cout << "not specified.\n";
     }
 
+    finish_svg_writes();
     cout << "END." << endl;
 
 }
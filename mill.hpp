@@ -57,6 +57,17 @@ class RoutingMill: public Mill {
   double optimise;
   bool eulerian_paths;
   size_t path_finding_limit;
+  // How many of the nearest paths to try connecting each path to, 0
+  // for all of them.
+  size_t path_finding_candidates;
+  // Share the search from each toolpath end among all the connections
+  // from it.  path_finding_limit then limits the work for each
+  // connection that wasn't already done for the ones before it.
+  bool shared_path_search;
+  // How each path search is done, see path_finding::SearchOptions.
+  bool path_finding_visibility_graph;
+  bool path_finding_bidirectional;
+  size_t path_finding_landmarks;
   double g0_vertical_speed;
   double g0_horizontal_speed;
   double backtrack;
@@ -77,6 +88,10 @@ class Isolator: public RoutingMill {
   bool voronoi;
   bool preserve_thermal_reliefs;
   double isolation_width;
+  // Grow each pass from the previous one instead of from the trace.
+  bool incremental_offsets;
+  // Write the clearance violations to a file.
+  bool contentions_report;
 };
 
 /******************************************************************************/
@@ -0,0 +1,69 @@
+#include "milled_regions.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+#include "bg_operators.hpp"
+
+namespace milled_regions {
+
+namespace bgi = boost::geometry::index;
+using std::vector;
+
+MilledRegions::MilledRegions(const multi_polygon_type_fp& milled) {
+  for (const auto& polygon : milled) {
+    insert(polygon_type_fp(polygon));
+  }
+}
+
+void MilledRegions::insert(polygon_type_fp&& polygon) {
+  tree.insert(value_type(bg::return_envelope<box_type_fp>(polygon), polygons.size()));
+  polygons.push_back(std::move(polygon));
+}
+
+void MilledRegions::add(const multi_polygon_type_fp& swath) {
+  if (swath.empty()) {
+    return;
+  }
+  const auto box = bg::return_envelope<box_type_fp>(swath);
+  vector<value_type> touching;
+  tree.query(bgi::intersects(box), std::back_inserter(touching));
+  std::sort(touching.begin(), touching.end(),
+            [](const value_type& lhs, const value_type& rhs) { return lhs.second < rhs.second; });
+  multi_polygon_type_fp nearby;
+  nearby.reserve(touching.size());
+  for (const auto& value : touching) {
+    tree.remove(value);
+    nearby.push_back(std::move(polygons[value.second]));
+    polygons[value.second] = polygon_type_fp();
+  }
+  for (auto& polygon : nearby + swath) {
+    insert(std::move(polygon));
+  }
+}
+
+multi_polygon_type_fp MilledRegions::near(const box_type_fp& box) const {
+  vector<value_type> touching;
+  tree.query(bgi::intersects(box), std::back_inserter(touching));
+  std::sort(touching.begin(), touching.end(),
+            [](const value_type& lhs, const value_type& rhs) { return lhs.second < rhs.second; });
+  multi_polygon_type_fp ret;
+  ret.reserve(touching.size());
+  for (const auto& value : touching) {
+    ret.push_back(polygons[value.second]);
+  }
+  return ret;
+}
+
+multi_polygon_type_fp MilledRegions::all() const {
+  multi_polygon_type_fp ret;
+  ret.reserve(tree.size());
+  for (const auto& polygon : polygons) {
+    if (!polygon.outer().empty()) {
+      ret.push_back(polygon);
+    }
+  }
+  return ret;
+}
+
+} // namespace milled_regions
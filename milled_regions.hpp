@@ -0,0 +1,44 @@
+#ifndef MILLED_REGIONS_HPP
+#define MILLED_REGIONS_HPP
+
+#include <utility>
+#include <vector>
+
+#include <boost/geometry/index/rtree.hpp>
+
+#include "geometry.hpp"
+
+// The area that has been milled so far, kept as disjoint polygons in
+// an R-tree of their bounding boxes.  Adding a swath only merges it
+// with the polygons that it might touch and asking what is milled
+// near a path only returns the polygons that might touch the path, so
+// neither one has to handle all of the milled area.
+namespace milled_regions {
+
+class MilledRegions {
+ public:
+  MilledRegions() {}
+  explicit MilledRegions(const multi_polygon_type_fp& milled);
+
+  // Add the swath to the milled area.
+  void add(const multi_polygon_type_fp& swath);
+  // The milled polygons that might touch the box.  None of the
+  // polygons left out touch the box.
+  multi_polygon_type_fp near(const box_type_fp& box) const;
+  // All of the milled polygons.
+  multi_polygon_type_fp all() const;
+  bool empty() const { return tree.empty(); }
+
+ private:
+  typedef std::pair<box_type_fp, size_t> value_type;
+  void insert(polygon_type_fp&& polygon);
+  // Polygons that were merged into others are left empty.  The
+  // results are always in order of insertion so that they don't
+  // depend on the shape of the tree.
+  std::vector<polygon_type_fp> polygons;
+  boost::geometry::index::rtree<value_type, boost::geometry::index::rstar<16>> tree;
+};
+
+} // namespace milled_regions
+
+#endif // MILLED_REGIONS_HPP
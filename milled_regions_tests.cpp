@@ -0,0 +1,70 @@
+#define BOOST_TEST_MODULE milled regions tests
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+
+#include "geometry.hpp"
+#include "milled_regions.hpp"
+
+using namespace milled_regions;
+
+multi_polygon_type_fp read_multi_polygon(const std::string& wkt) {
+  multi_polygon_type_fp mpoly;
+  bg::read_wkt(wkt, mpoly);
+  bg::correct(mpoly);
+  return mpoly;
+}
+
+BOOST_AUTO_TEST_SUITE(milled_regions_tests)
+
+BOOST_AUTO_TEST_CASE(empty) {
+  MilledRegions milled;
+  BOOST_CHECK(milled.empty());
+  BOOST_CHECK(milled.all().empty());
+  BOOST_CHECK(milled.near(box_type_fp({0, 0}, {10, 10})).empty());
+}
+
+BOOST_AUTO_TEST_CASE(add_merges_touching) {
+  MilledRegions milled(read_multi_polygon(
+      "MULTIPOLYGON(((0 0,0 1,1 1,1 0,0 0)),((10 0,10 1,11 1,11 0,10 0)))"));
+  milled.add(read_multi_polygon("MULTIPOLYGON(((0.5 0,0.5 1,2 1,2 0,0.5 0)))"));
+  const auto all = milled.all();
+  BOOST_REQUIRE_EQUAL(all.size(), 2);
+  // The far square is untouched and comes first.
+  BOOST_CHECK_EQUAL(bg::area(all[0]), 1);
+  BOOST_CHECK_EQUAL(bg::area(all[1]), 2);
+}
+
+BOOST_AUTO_TEST_CASE(near) {
+  MilledRegions milled(read_multi_polygon(
+      "MULTIPOLYGON(((0 0,0 1,1 1,1 0,0 0)),((10 0,10 1,11 1,11 0,10 0)),"
+      "((20 0,20 1,21 1,21 0,20 0)))"));
+  auto found = milled.near(box_type_fp({9, -1}, {12, 2}));
+  BOOST_REQUIRE_EQUAL(found.size(), 1);
+  BOOST_CHECK_EQUAL(bg::return_envelope<box_type_fp>(found).min_corner().x(), 10);
+  // In order of insertion.
+  found = milled.near(box_type_fp({0.5, 0.5}, {20.5, 0.5}));
+  BOOST_REQUIRE_EQUAL(found.size(), 3);
+  BOOST_CHECK_EQUAL(found[0].outer()[0].x(), 0);
+  BOOST_CHECK_EQUAL(found[2].outer()[0].x(), 20);
+  BOOST_CHECK(milled.near(box_type_fp({3, 3}, {4, 4})).empty());
+}
+
+BOOST_AUTO_TEST_CASE(same_as_union) {
+  // Merging locally gives the same area as merging everything.
+  MilledRegions milled;
+  multi_polygon_type_fp all;
+  for (int i = 0; i < 20; i++) {
+    const double x = (i * 7) % 20;
+    multi_polygon_type_fp swath;
+    bg::convert(box_type_fp({x, 0}, {x + 1.5, 1}), swath);
+    milled.add(swath);
+    multi_polygon_type_fp unioned;
+    bg::union_(all, swath, unioned);
+    all = unioned;
+  }
+  BOOST_CHECK_CLOSE(bg::area(milled.all()), bg::area(all), 1e-9);
+  BOOST_CHECK_EQUAL(milled.all().size(), all.size());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -230,6 +230,12 @@ options::options()
         "Minimum isolation width between copper surfaces")
        ("extra-passes", po::value<int>()->default_value(0), "[DEPRECATED] use --isolation-width instead. "
         "Specify the the number of extra isolation passes, increasing the isolation width half the tool diameter with each pass")
+       ("incremental-offsets", po::value<bool>()->default_value(false)->implicit_value(true),
+        "make each isolation pass by growing the previous pass instead of the trace.  Much faster when there are many passes"
+        " but the passes may differ from the default by about the tolerance")
+       ("contentions-report", po::value<bool>()->default_value(false)->implicit_value(true),
+        "write the places where isolation doesn't keep clear of the traces to contentions_<layer>.csv, with the"
+        " location and the required and actual clearance in inches")
        ("pre-milling-gcode", po::value<std::vector<string>>()->default_value(std::vector<string>{}, ""),
         "custom gcode inserted before the start of milling each trace (used to activate pump or fan or laser connected to fan)")
        ("post-milling-gcode", po::value<std::vector<string>>()->default_value(std::vector<string>{}, ""),
@@ -274,10 +280,20 @@ options::options()
         "Reduce output file size by up to 40% while accepting a little loss of precision.  Larger values reduce file sizes and processing time even further.  Set to 0 to disable.")
        ("eulerian-paths", po::value<bool>()->default_value(true)->implicit_value(true), "Don't mill the same path twice if milling loops overlap.  This can save up to 50% of milling time.  Enabled by default.")
        ("vectorial", po::value<bool>()->default_value(true)->implicit_value(true), "enable or disable the vectorial rendering engine")
+       ("native-gerber-parser", po::value<bool>()->default_value(false)->implicit_value(true), "read gerber files with the built-in streaming parser instead of gerbv.  Faster and uses less memory on large files")
+       ("adaptive-tessellation", po::value<bool>()->default_value(false)->implicit_value(true), "approximate each circle and arc in the gerber files with as few segments as needed to stay within tolerance, instead of 30 segments per circle.  Small pads get fewer vertices, which makes milling faster, and large arcs get more")
+       ("union-stats", po::value<bool>()->default_value(false)->implicit_value(true), "print how many unions were made while merging the shapes of the input files and how long they took")
+       ("check-self-intersections", po::value<bool>()->default_value(true)->implicit_value(true), "warn about self-intersecting geometry in the gerber files.  Set to false to skip the check on large files that are known to be good")
        ("tsp-2opt", po::value<bool>()->default_value(true)->implicit_value(true), "use TSP 2OPT to find a faster toolpath (but slows down gcode generation)")
        ("path-finding-limit", po::value<size_t>()->default_value(1), "Use path finding for up to this many steps in the search (more is slower but makes a faster gcode path)")
+       ("path-finding-candidates", po::value<size_t>()->default_value(0), "when joining up the toolpaths, only try connecting each end to the ends of this many of the nearest toolpaths.  Saves time and memory on very large boards.  0 means try all of the toolpaths that are close enough to be worth connecting")
+       ("shared-path-search", po::value<bool>()->default_value(false)->implicit_value(true), "when joining up the toolpaths, share the path finding search from each end among all the connections from it.  Faster with a large path-finding-limit but the limit then only counts the steps that each connection adds to the search and if there are many paths of the same length, a different one might be picked")
+       ("path-finding-visibility-graph", po::value<bool>()->default_value(false)->implicit_value(true), "when joining up the toolpaths, remember which vertices each vertex can see.  Uses more memory but makes later searches through the same vertices faster.  The paths found are the same")
+       ("path-finding-bidirectional", po::value<bool>()->default_value(false)->implicit_value(true), "when joining up the toolpaths, search from both ends at once.  The path lengths are the same but if there are many paths of the same length, a different one might be picked")
+       ("path-finding-landmarks", po::value<size_t>()->default_value(0), "when joining up the toolpaths, measure the shortest paths from this many vertices of each region and use them to guide the search.  The path lengths are the same but if there are many paths of the same length, a different one might be picked.  0 to disable")
        ("g0-vertical-speed", po::value<Velocity>()->default_value(parse_unit<Velocity>("50in/min")), "speed of vertical G0 movements, for use in path-finding")
        ("g0-horizontal-speed", po::value<Velocity>()->default_value(parse_unit<Velocity>("100in/min")), "speed of horizontal G0 movements, for use in path-finding")
+       ("jobs", po::value<size_t>()->default_value(0), "number of threads to use for importing, rendering and milling the layers in parallel.  0 means one per core")
        ("backtrack", po::value<Velocity>()->default_value(std::numeric_limits<double>::infinity()), "allow retracing a milled path if it's faster than retract-move-lower.  For example, set to 5in/s if you are willing to remill 5 inches of trace in order to save 1 second of milling time.");
    cfg_options.add(optimization_options);
 
@@ -331,6 +347,9 @@ options::options()
        ("tolerance", po::value<double>(), "maximum toolpath tolerance")
        ("nog64", po::value<bool>()->default_value(false)->implicit_value(true), "do not set an explicit g64")
        ("output-dir", po::value<string>()->default_value(""), "output directory")
+       ("debug-images", po::value<DebugImages::DebugImages>()->default_value(DebugImages::NONE),
+        "SVGs to write to the output directory for debugging; valid choices are none (default), basic for the input"
+        " layers, the final toolpaths and the contentions, or full to also get the masked layers and each tool's passes")
        ("basename", po::value<string>(), "prefix for default output file names")
        ("preamble-text", po::value<string>(), "preamble text file, inserted at the very beginning as a comment.")
        ("preamble", po::value<string>(), "gcode preamble file, inserted at the very beginning.")
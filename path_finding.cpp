@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <limits>
+
 #include <vector>
 using std::vector;
 
@@ -31,12 +34,12 @@ using boost::optional;
 using boost::make_optional;
 
 Neighbors::iterator Neighbors::iterator::operator++() {
-  const auto& all_vertices_size = neighbors->vertices.size();
+  const auto& end_index = neighbors->end().point_index;
   do {
     // Move to a new valid point, even if it isn't a neighbor.
     point_index++;
-  } while (point_index < all_vertices_size + 2 &&
-           !neighbors->is_neighbor(**this));
+  } while (point_index < end_index &&
+           !neighbors->is_neighbor(point_index));
   return *this;
 }
 
@@ -53,6 +56,8 @@ const point_type_fp& Neighbors::iterator::operator*() const {
     return neighbors->start;
   } else if (point_index == 1) {
     return neighbors->goal;
+  } else if (neighbors->visibility) {
+    return neighbors->vertices[neighbors->visibility->visible[point_index-2]];
   } else {
     return neighbors->vertices[point_index-2];
   }
@@ -62,25 +67,38 @@ Neighbors::Neighbors(const point_type_fp& start, const point_type_fp& goal,
                      const point_type_fp& current,
                      const coordinate_type_fp& max_path_length,
                      const std::vector<point_type_fp>& vertices,
-                     const PathFindingSurface* pfs) :
+                     const PathFindingSurface* pfs,
+                     SearchContext* context,
+                     const Visibility* visibility) :
     start(start),
     goal(goal),
     current(current),
     max_path_length_squared(max_path_length),
     vertices(vertices),
-    pfs(pfs) {}
+    pfs(pfs),
+    context(context),
+    visibility(visibility) {
+  if (visibility) {
+    // Use up the tries for all the vertices, as if they were each
+    // checked, so that the limit means the same thing either way.
+    context->decrement_tries(vertices.size() - visibility->same);
+  }
+}
 
-// Returns a valid neighbor index that is either the one provided or
-// the next higher valid one.
-inline bool Neighbors::is_neighbor(const point_type_fp p) const {
-  if (p == current) {
-    return false;
+// Returns true if the point at point_index is a neighbor of current.
+inline bool Neighbors::is_neighbor(size_t point_index) const {
+  const point_type_fp& p = *iterator(this, point_index);
+  const bool known_visible = visibility && point_index >= 2;
+  if (!known_visible) {
+    if (p == current) {
+      return false;
+    }
+    context->decrement_tries();
   }
-  pfs->decrement_tries();
   if (bg::distance(current, p) + bg::distance(p, goal) > max_path_length_squared) {
     return false;
   }
-  if (!pfs->in_surface(current, p)) {
+  if (!known_visible && !pfs->in_surface(current, p)) {
     return false;
   }
   return true;
@@ -92,7 +110,7 @@ Neighbors::iterator Neighbors::begin() const {
     // Can't dereferfence the end.
     return ret;
   }
-  if (is_neighbor(*ret)) {
+  if (is_neighbor(0)) {
     // This is a valid begin.
     return ret;
   } else {
@@ -103,7 +121,7 @@ Neighbors::iterator Neighbors::begin() const {
 }
 
 Neighbors::iterator Neighbors::end() const {
-  return iterator(this, vertices.size()+2);
+  return iterator(this, (visibility ? visibility->visible.size() : vertices.size()) + 2);
 }
 
 vector<pair<point_type_fp, point_type_fp>> get_all_segments(
@@ -144,7 +162,11 @@ vector<vector<std::reference_wrapper<const ring_type_fp>>> get_all_rings(
 
 PathFindingSurface::PathFindingSurface(const optional<multi_polygon_type_fp>& keep_in,
                                        const multi_polygon_type_fp& keep_out,
-                                       const coordinate_type_fp tolerance) {
+                                       const coordinate_type_fp tolerance,
+                                       const SearchOptions& options) :
+    visibility_graph(options.visibility_graph),
+    bidirectional(options.bidirectional),
+    landmark_count(options.landmark_count) {
   if (keep_in) {
     multi_polygon_type_fp total_keep_in = *keep_in - keep_out;
 
@@ -183,6 +205,11 @@ PathFindingSurface::PathFindingSurface(const optional<multi_polygon_type_fp>& ke
   }
   const nested_multipolygon_type_fp& poly_to_search = total_keep_in_grown ? *total_keep_in_grown : keep_out_shrunk;
   const vector<vector<std::reference_wrapper<const ring_type_fp>>>& all_rings = get_all_rings(poly_to_search);
+  for (const auto& rings : all_rings) {
+    for (const auto& ring : rings) {
+      ring_grids.add(ring);
+    }
+  }
   const auto& all_segments = get_all_segments(all_rings);
   segment_tree::SegmentTree x(all_segments);
   tree = std::move(x);
@@ -193,17 +220,134 @@ PathFindingSurface::PathFindingSurface(const optional<multi_polygon_type_fp>& ke
   }
 }
 
+RingGrid::RingGrid(const ring_type_fp& ring) :
+    min_y(0),
+    max_y(0),
+    row_height(0),
+    row_count(1) {
+  if (ring.size() < 2) {
+    row_starts = {0, 0};
+    return;
+  }
+  min_y = max_y = ring[0].y();
+  for (const auto& point : ring) {
+    min_y = std::min(min_y, point.y());
+    max_y = std::max(max_y, point.y());
+  }
+  // Horizontal edges never count in point_in_ring so leave them out.
+  vector<pair<point_type_fp, point_type_fp>> ring_edges;
+  for (size_t i = 0; i + 1 < ring.size(); i++) {
+    if (ring[i].y() != ring[i+1].y()) {
+      ring_edges.emplace_back(ring[i], ring[i+1]);
+    }
+  }
+  // Start with a row per edge.  Tall edges are listed in many rows so
+  // use fewer rows until the lists aren't much bigger than the ring.
+  row_count = std::max(size_t(1), ring_edges.size());
+  while (true) {
+    row_height = (max_y - min_y) / row_count;
+    if (row_count == 1) {
+      break;
+    }
+    size_t total = 0;
+    for (const auto& edge : ring_edges) {
+      const auto ys = std::minmax(edge.first.y(), edge.second.y());
+      total += row(ys.second) - row(ys.first) + 1;
+    }
+    if (total <= 4 * ring_edges.size()) {
+      break;
+    }
+    row_count /= 2;
+  }
+  // Count the edges in each row and then fill them in.
+  row_starts.assign(row_count + 1, 0);
+  for (const auto& edge : ring_edges) {
+    const auto ys = std::minmax(edge.first.y(), edge.second.y());
+    for (size_t r = row(ys.first); r <= row(ys.second); r++) {
+      row_starts[r+1]++;
+    }
+  }
+  for (size_t r = 0; r < row_count; r++) {
+    row_starts[r+1] += row_starts[r];
+  }
+  edges.resize(row_starts.back());
+  vector<size_t> next(row_starts.cbegin(), row_starts.cend() - 1);
+  for (const auto& edge : ring_edges) {
+    const auto ys = std::minmax(edge.first.y(), edge.second.y());
+    for (size_t r = row(ys.first); r <= row(ys.second); r++) {
+      edges[next[r]++] = edge;
+    }
+  }
+}
+
+// Which row y is in.  This never decreases as y increases, so an edge
+// that spans y is always listed in y's row.
+size_t RingGrid::row(coordinate_type_fp y) const {
+  if (row_count == 1 || y <= min_y) {
+    return 0;
+  }
+  return std::min(row_count - 1, size_t((y - min_y) / row_height));
+}
+
+bool RingGrid::contains(const point_type_fp& point) const {
+  // Outside of these, no edge could be crossed.
+  if (point.y() < min_y || point.y() >= max_y) {
+    return false;
+  }
+  const size_t r = row(point.y());
+  int winding_number = 0;
+  // This is the same as in point_in_ring.
+  for (size_t i = row_starts[r]; i < row_starts[r+1]; i++) {
+    const auto& edge = edges[i];
+    if (edge.first.y() <= point.y()) {
+      if (edge.second.y() > point.y()) {
+        if (is_left(edge.first, edge.second, point) > 0) {
+          ++winding_number;
+        }
+      }
+    } else {
+      if (edge.second.y() <= point.y()) {
+        if (is_left(edge.first, edge.second, point) < 0) {
+          --winding_number;
+        }
+      }
+    }
+  }
+  return winding_number != 0;
+}
+
+void RingGrids::add(const ring_type_fp& ring) {
+  grids.emplace(&ring, RingGrid(ring));
+}
+
+bool RingGrids::point_in_ring(const point_type_fp& point, const ring_type_fp& ring) const {
+  const auto found = grids.find(&ring);
+  if (found == grids.cend()) {
+    return path_finding::point_in_ring(point, ring);
+  }
+  return found->second.contains(point);
+}
+
+// Use the grid for the ring if there is one.
+bool point_in_ring(const point_type_fp& point, const ring_type_fp& ring, const RingGrids* grids) {
+  if (grids) {
+    return grids->point_in_ring(point, ring);
+  }
+  return point_in_ring(point, ring);
+}
+
 boost::optional<MPRingIndices> inside_multipolygon(const point_type_fp& p,
-                                                   const multi_polygon_type_fp& mp) {
+                                                   const multi_polygon_type_fp& mp,
+                                                   const RingGrids* grids) {
   for (size_t poly_index = 0; poly_index < mp.size(); poly_index++) {
     const auto& poly = mp[poly_index];
-    if (point_in_ring(p, poly.outer())) {
+    if (point_in_ring(p, poly.outer(), grids)) {
       // Might be part of this shape but only if the point isn't in
       // the inners.
       MPRingIndices ring_indices{{poly_index, {0}}};
       for (size_t inner_index = 0; inner_index < poly.inners().size(); inner_index++) {
         const auto& inner = poly.inners()[inner_index];
-        if (!point_in_ring(p, inner)) {
+        if (!point_in_ring(p, inner, grids)) {
           // We'll have to make sure not to cross this inner.
           ring_indices.back().second.emplace_back(inner_index+1);
         } else {
@@ -224,17 +368,18 @@ boost::optional<MPRingIndices> inside_multipolygon(const point_type_fp& p,
 }
 
 boost::optional<MPRingIndices> outside_multipolygon(const point_type_fp& p,
-                                                    const multi_polygon_type_fp& mp) {
+                                                    const multi_polygon_type_fp& mp,
+                                                    const RingGrids* grids) {
   MPRingIndices ring_indices;
   for (size_t poly_index = 0; poly_index < mp.size(); poly_index++) {
     const auto& poly = mp[poly_index];
-    if (point_in_ring(p, poly.outer())) {
+    if (point_in_ring(p, poly.outer(), grids)) {
       // We're inside the outer, maybe we're in an inner?  If not, we
       // aren't outside at all and we'll just give up.
       bool in_any_inner = false;
       for (size_t i = 0; i < poly.inners().size(); i++) {
         const auto& inner = poly.inners()[i];
-        if (point_in_ring(p, inner)) {
+        if (point_in_ring(p, inner, grids)) {
           in_any_inner = true;
           ring_indices.emplace_back(poly_index, vector<size_t>{i+1});
           break;
@@ -257,17 +402,18 @@ boost::optional<MPRingIndices> outside_multipolygon(const point_type_fp& p,
 
 boost::optional<RingIndices> inside_multipolygons(
     const point_type_fp& p,
-    const nested_multipolygon_type_fp& mp) {
+    const nested_multipolygon_type_fp& mp,
+    const RingGrids* grids) {
   for (size_t poly_index = 0; poly_index < mp.size(); poly_index++) {
     const auto& poly = mp[poly_index];
-    boost::optional<MPRingIndices> inside_mp = inside_multipolygon(p, poly.outer());
+    boost::optional<MPRingIndices> inside_mp = inside_multipolygon(p, poly.outer(), grids);
     if (inside_mp) {
       // Might be part of this shape but only if the point isn't in
       // the inners.
       RingIndices ring_indices{{poly_index, {{0, *inside_mp}}}};
       for (size_t inner_index = 0; inner_index < poly.inners().size(); inner_index++) {
         const auto& inner = poly.inners()[inner_index];
-        auto outside_mp = outside_multipolygon(p, inner);
+        auto outside_mp = outside_multipolygon(p, inner, grids);
         if (outside_mp) {
           // We'll have to make sure not to cross this inner.
           ring_indices.back().second.emplace_back(inner_index+1, *outside_mp);
@@ -290,18 +436,19 @@ boost::optional<RingIndices> inside_multipolygons(
 
 boost::optional<RingIndices> outside_multipolygons(
     const point_type_fp& p,
-    const nested_multipolygon_type_fp& mp) {
+    const nested_multipolygon_type_fp& mp,
+    const RingGrids* grids) {
   RingIndices ring_indices;
   for (size_t poly_index = 0; poly_index < mp.size(); poly_index++) {
     const auto& poly = mp[poly_index];
-    auto outside_mp = outside_multipolygon(p, poly.outer());
+    auto outside_mp = outside_multipolygon(p, poly.outer(), grids);
     if (!outside_mp) {
       // We're inside the outer, maybe we're in an inner?  If not, we
       // aren't outside at all and we'll just give up.
       bool in_any_inner = false;
       for (size_t inner_index = 0; inner_index < poly.inners().size(); inner_index++) {
         const auto& inner = poly.inners()[inner_index];
-        auto inside_mp = inside_multipolygon(p, inner);
+        auto inside_mp = inside_multipolygon(p, inner, grids);
         if (inside_mp) {
           in_any_inner = true;
           ring_indices.emplace_back(poly_index, vector<pair<size_t, MPRingIndices>>{{inner_index + 1, *inside_mp}});
@@ -330,33 +477,40 @@ boost::optional<RingIndices> outside_multipolygons(
    rings in the stored polygon should be used for the generated points
    in the path and also for the collision detection. */
 const boost::optional<SearchKey>& PathFindingSurface::in_surface(point_type_fp p) const {
-  auto memoized_result = point_in_surface_memo.find(p);
-  if (memoized_result != point_in_surface_memo.cend()) {
-    return memoized_result->second;
-  }
-  boost::optional<RingIndices> maybe_ring_indices;
-  if (total_keep_in_grown) {
-    maybe_ring_indices = inside_multipolygons(p, *total_keep_in_grown);
-  } else {
-    maybe_ring_indices = outside_multipolygons(p, keep_out_shrunk);
-  }
-  if (!maybe_ring_indices) {
-    return point_in_surface_memo.emplace(p, boost::none).first->second;
-  }
-  const auto& ring_indices = *maybe_ring_indices;
+  return point_in_surface_memo.get(p, [&]() -> boost::optional<SearchKey> {
+    boost::optional<RingIndices> maybe_ring_indices;
+    if (total_keep_in_grown) {
+      maybe_ring_indices = inside_multipolygons(p, *total_keep_in_grown, &ring_grids);
+    } else {
+      maybe_ring_indices = outside_multipolygons(p, keep_out_shrunk, &ring_grids);
+    }
+    if (!maybe_ring_indices) {
+      return boost::none;
+    }
+    return ring_indices_cache.key(*maybe_ring_indices);
+  });
+}
+
+SearchKey RingIndicesCache::key(const RingIndices& new_ring_indices) {
+  std::lock_guard<std::mutex> lock(mutex);
   // Check if this one is already in the cache.
-  const auto& find_result = ring_indices_lookup.find(std::cref(ring_indices));
-  if (find_result != ring_indices_lookup.cend()) {
+  const auto& find_result = lookup.find(std::cref(new_ring_indices));
+  if (find_result != lookup.cend()) {
     // Found in the cache so we can use that.
-    return point_in_surface_memo.emplace(p, find_result->second).first->second;
+    return find_result->second;
   }
   // Not found so we need to add it to the cache.
-  ring_indices_cache.push_back(ring_indices);
-  ring_indices_lookup.emplace(ring_indices_cache.back(), ring_indices_cache.size()-1);
-  return point_in_surface_memo.emplace(p, ring_indices_cache.size()-1).first->second;
+  ring_indices.push_back(new_ring_indices);
+  lookup.emplace(ring_indices.back(), ring_indices.size()-1);
+  return ring_indices.size()-1;
+}
+
+const RingIndices& RingIndicesCache::at(SearchKey search_key) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return ring_indices.at(search_key);
 }
 
-void PathFindingSurface::decrement_tries() const {
+void SearchContext::decrement_tries() {
   if (tries) {
     if (*tries == 0) {
       throw GiveUp();
@@ -365,20 +519,24 @@ void PathFindingSurface::decrement_tries() const {
   }
 }
 
+void SearchContext::decrement_tries(size_t count) {
+  if (tries) {
+    if (*tries < count) {
+      throw GiveUp();
+    }
+    *tries -= count;
+  }
+}
+
 // Return true if this edge from a to b is part of the path finding surface.
 bool PathFindingSurface::in_surface(
     const point_type_fp& a, const point_type_fp& b) const {
   if (b < a) {
     return in_surface(b, a);
   }
-  const auto key = make_pair(a, b);
-  auto memoized_result = edge_in_surface_memo.find(key);
-  if (memoized_result != edge_in_surface_memo.cend()) {
-    return memoized_result->second;
-  }
-  auto found_intersection = tree.intersects(a, b);
-  edge_in_surface_memo.emplace(key, !found_intersection);
-  return !found_intersection;
+  return edge_in_surface_memo.get(make_pair(a, b), [&]() {
+    return !tree.intersects(a, b);
+  });
 }
 
 // Return all possible neighbors of current.  A neighbor can be
@@ -387,8 +545,14 @@ bool PathFindingSurface::in_surface(
 Neighbors PathFindingSurface::neighbors(const point_type_fp& start, const point_type_fp& goal,
                                         const coordinate_type_fp& max_path_length,
                                         SearchKey search_key,
-                                        const point_type_fp& current) const {
-  return Neighbors(start, goal, current, max_path_length, vertices(search_key), this);
+                                        const point_type_fp& current,
+                                        SearchContext& context) const {
+  // The start is different for each search so it isn't worth saving
+  // what can be seen from it.
+  const Visibility* current_visibility =
+      visibility_graph && current != start ? &visibility(search_key, current) : nullptr;
+  return Neighbors(start, goal, current, max_path_length, vertices(search_key), this, &context,
+                   current_visibility);
 }
 
 // Return a path from the start to the current.  Always return at
@@ -408,12 +572,13 @@ linestring_type_fp build_path(
 optional<linestring_type_fp> PathFindingSurface::find_path(
     const point_type_fp& start, const point_type_fp& goal,
     const coordinate_type_fp& max_path_length,
-    SearchKey search_key) const {
+    SearchKey search_key,
+    SearchContext& context) const {
   // Connect if a direct connection is possible.  This also takes care
   // of the case where start == goal.
   try {
     if (in_surface(start, goal)) {
-      decrement_tries();
+      context.decrement_tries();
       if (bg::comparable_distance(start, goal) < max_path_length * max_path_length) {
         // in_surface builds up some structures that are only efficient if
         // we're doing many tries.
@@ -426,11 +591,15 @@ optional<linestring_type_fp> PathFindingSurface::find_path(
   } catch (GiveUp g) {
     return boost::none;
   }
+  if (bidirectional) {
+    return find_path_bidirectional(start, goal, max_path_length, search_key, context);
+  }
+  const Heuristic distance_to_goal = heuristic(search_key, goal);
   // Do astar.
   priority_queue<pair<coordinate_type_fp, point_type_fp>,
                  vector<pair<coordinate_type_fp, point_type_fp>>,
                  std::greater<pair<coordinate_type_fp, point_type_fp>>> open_set;
-  open_set.emplace(bg::distance(start, goal), start);
+  open_set.emplace(distance_to_goal(start), start);
   unordered_set<point_type_fp> closed_set;
   unordered_map<point_type_fp, point_type_fp> came_from;
   unordered_map<point_type_fp, coordinate_type_fp> g_score; // Empty should be considered infinity.
@@ -446,19 +615,21 @@ optional<linestring_type_fp> PathFindingSurface::find_path(
       // Skip this because we already "removed it", sort of.
       continue;
     }
+    context.count_expansion();
     try {
       const auto current_neighbors = neighbors(
           start, goal,
           max_path_length - g_score.at(current),
           search_key,
-          current);
+          current,
+          context);
       for (const auto& neighbor : current_neighbors) {
         const auto tentative_g_score = g_score.at(current) + bg::distance(current, neighbor);
         if (g_score.count(neighbor) == 0 || tentative_g_score < g_score.at(neighbor)) {
           // This path to neighbor is better than any previous one.
           came_from[neighbor] = current;
           g_score[neighbor] = tentative_g_score;
-          open_set.emplace(tentative_g_score + bg::distance(neighbor, goal), neighbor);
+          open_set.emplace(tentative_g_score + distance_to_goal(neighbor), neighbor);
         }
       }
     } catch (GiveUp g) {
@@ -471,35 +642,143 @@ optional<linestring_type_fp> PathFindingSurface::find_path(
   return boost::none;
 }
 
+// One of the two searches of find_path_bidirectional, from its start
+// to its goal.  The vertices are ordered by their g score plus half of
+// the difference between the heuristics to the goal and to the start.
+// The searches in both directions use the same potential, just with
+// the opposite sign, so that they agree about which vertices are
+// closer to the shortest path.
+struct OneWaySearch {
+  OneWaySearch(const point_type_fp& start, const point_type_fp& goal,
+               const Heuristic& to_goal, const Heuristic& to_start) :
+      start(start),
+      goal(goal),
+      to_goal(to_goal),
+      to_start(to_start) {
+    g_score[start] = 0;
+    open_set.emplace(potential(start), start);
+  }
+  coordinate_type_fp potential(const point_type_fp& p) const {
+    return (to_goal(p) - to_start(p)) / 2;
+  }
+  // Drops the vertices that are already closed from the top of the
+  // open_set.  Returns true if any are left.
+  bool has_open() {
+    while (!open_set.empty() && closed_set.count(open_set.top().second) > 0) {
+      open_set.pop();
+    }
+    return !open_set.empty();
+  }
+
+  const point_type_fp start;
+  const point_type_fp goal;
+  const Heuristic& to_goal;
+  const Heuristic& to_start;
+  priority_queue<pair<coordinate_type_fp, point_type_fp>,
+                 vector<pair<coordinate_type_fp, point_type_fp>>,
+                 std::greater<pair<coordinate_type_fp, point_type_fp>>> open_set;
+  unordered_set<point_type_fp> closed_set;
+  unordered_map<point_type_fp, point_type_fp> came_from;
+  unordered_map<point_type_fp, coordinate_type_fp> g_score; // Empty should be considered infinity.
+};
+
+// Like find_path but with a search from each end.  The one with fewer
+// vertices waiting goes next so that both stay small.  Each time that
+// a search reaches a vertex that the other one has reached, the path
+// through it is a candidate.  Because the potentials of the two
+// searches cancel out, any path that neither has found yet is at
+// least as long as the sum of their least scores so once that gets to
+// the length of the best candidate, there is nothing shorter left.
+optional<linestring_type_fp> PathFindingSurface::find_path_bidirectional(
+    const point_type_fp& start, const point_type_fp& goal,
+    const coordinate_type_fp& max_path_length,
+    SearchKey search_key,
+    SearchContext& context) const {
+  const Heuristic to_goal = heuristic(search_key, goal);
+  const Heuristic to_start = heuristic(search_key, start);
+  OneWaySearch forward(start, goal, to_goal, to_start);
+  OneWaySearch backward(goal, start, to_start, to_goal);
+  // The shortest path found so far goes through meeting.  Until there
+  // is one, any path up to max_path_length will do.
+  coordinate_type_fp best_length = max_path_length;
+  optional<point_type_fp> meeting;
+  auto might_improve = [&](coordinate_type_fp length) {
+    return meeting ? length < best_length : length <= best_length;
+  };
+  try {
+    while (forward.has_open() && backward.has_open() &&
+           might_improve(forward.open_set.top().first + backward.open_set.top().first)) {
+      OneWaySearch& search = forward.open_set.size() <= backward.open_set.size() ? forward : backward;
+      OneWaySearch& other = &search == &forward ? backward : forward;
+      const auto current = search.open_set.top().second;
+      search.open_set.pop();
+      context.count_expansion();
+      const auto current_g_score = search.g_score.at(current);
+      const auto current_neighbors = neighbors(
+          search.start, search.goal,
+          max_path_length - current_g_score,
+          search_key,
+          current,
+          context);
+      for (const auto& neighbor : current_neighbors) {
+        const auto tentative_g_score = current_g_score + bg::distance(current, neighbor);
+        if (search.g_score.count(neighbor) > 0 && tentative_g_score >= search.g_score.at(neighbor)) {
+          continue;
+        }
+        search.came_from[neighbor] = current;
+        search.g_score[neighbor] = tentative_g_score;
+        search.open_set.emplace(tentative_g_score + search.potential(neighbor), neighbor);
+        const auto other_g_score = other.g_score.find(neighbor);
+        if (other_g_score != other.g_score.cend() &&
+            might_improve(tentative_g_score + other_g_score->second)) {
+          best_length = tentative_g_score + other_g_score->second;
+          meeting = neighbor;
+        }
+      }
+      search.closed_set.insert(current);
+    }
+  } catch (GiveUp g) {
+    return boost::none;
+  }
+  if (!meeting) {
+    return boost::none;
+  }
+  // The path from the start to the meeting and then on to the goal.
+  auto path = build_path(*meeting, forward.came_from);
+  for (point_type_fp p = *meeting; backward.came_from.count(p) > 0;) {
+    p = backward.came_from.at(p);
+    path.push_back(p);
+  }
+  return path;
+}
+
 optional<linestring_type_fp> PathFindingSurface::find_path(
     const point_type_fp& start, const point_type_fp& goal,
     const coordinate_type_fp& max_path_length,
     const boost::optional<size_t>& max_tries,
     SearchKey search_key) const {
-  if (max_tries) {
-    if (*max_tries == 0) {
-      return boost::none;
-    }
-    tries.emplace(*max_tries);
-  } else {
-    tries = boost::none;
+  if (max_tries && *max_tries == 0) {
+    return boost::none;
   }
-  return find_path(start, goal, max_path_length, search_key);
+  SearchContext context(max_tries);
+  return find_path(start, goal, max_path_length, search_key, context);
 }
 
 optional<linestring_type_fp> PathFindingSurface::find_path(
     const point_type_fp& start, const point_type_fp& goal,
     const coordinate_type_fp& max_path_length,
     const boost::optional<size_t>& max_tries) const {
-  if (max_tries) {
-    if (*max_tries == 0) {
-      return boost::none;
-    }
-    tries.emplace(*max_tries);
-  } else {
-    tries = boost::none;
+  if (max_tries && *max_tries == 0) {
+    return boost::none;
   }
+  SearchContext context(max_tries);
+  return find_path(start, goal, max_path_length, context);
+}
 
+optional<linestring_type_fp> PathFindingSurface::find_path(
+    const point_type_fp& start, const point_type_fp& goal,
+    const coordinate_type_fp& max_path_length,
+    SearchContext& context) const {
   auto ring_indices = in_surface(start);
   if (!ring_indices) {
     // Start is not in the surface.
@@ -509,30 +788,393 @@ optional<linestring_type_fp> PathFindingSurface::find_path(
     // Either goal is not in the surface or it's in a region unreachable by start.
     return boost::none;
   }
-  return find_path(start, goal, max_path_length, *ring_indices);
+  return find_path(start, goal, max_path_length, *ring_indices, context);
+}
+
+vector<optional<linestring_type_fp>> PathFindingSurface::find_paths(
+    const point_type_fp& start,
+    const vector<pair<point_type_fp, coordinate_type_fp>>& goals,
+    const boost::optional<size_t>& max_tries) const {
+  vector<optional<linestring_type_fp>> ret;
+  const auto ring_indices = in_surface(start);
+  if (!ring_indices) {
+    // Start is not in the surface.
+    return vector<optional<linestring_type_fp>>(goals.size());
+  }
+  PathSearchTree search_tree(*this, start, *ring_indices);
+  for (const auto& goal : goals) {
+    if (ring_indices != in_surface(goal.first)) {
+      // Either goal is not in the surface or it's in a region unreachable by start.
+      ret.push_back(boost::none);
+    } else {
+      ret.push_back(search_tree.find_path(goal.first, goal.second, max_tries));
+    }
+  }
+  return ret;
+}
+
+PathSearchTree::PathSearchTree(const PathFindingSurface& surface, const point_type_fp& start,
+                               SearchKey search_key) :
+    surface(surface),
+    start(start),
+    search_key(search_key) {
+  g_score[start] = 0;
+  open.insert(start);
+}
+
+vector<point_type_fp> PathSearchTree::expand(const point_type_fp& current,
+                                             coordinate_type_fp radius,
+                                             SearchContext& context) {
+  const auto& vertices = surface.vertices(search_key);
+  const auto old_radius = expanded_radius.find(current);
+  const bool first_time = old_radius == expanded_radius.cend();
+  // Only the vertices between the old radius and the new one are new.
+  auto is_new = [&](const point_type_fp& p) {
+    const auto distance = bg::distance(current, p);
+    return p != current && distance <= radius &&
+        (first_time || distance > old_radius->second);
+  };
+  // The start is different for each tree so it isn't worth saving
+  // what can be seen from it.
+  const Visibility* visibility =
+      surface.visibility_graph && current != start ? &surface.visibility(search_key, current) : nullptr;
+  vector<pair<point_type_fp, point_type_fp>> edges;
+  size_t tries = 0;
+  for (const auto& p : vertices) {
+    if (is_new(p)) {
+      tries++;
+      if (!visibility) {
+        edges.push_back(p < current ? make_pair(p, current) : make_pair(current, p));
+      }
+    }
+  }
+  // Use up the tries as in Neighbors, before anything is changed.
+  context.decrement_tries(tries);
+  vector<point_type_fp> neighbors;
+  if (visibility) {
+    for (const auto& index : visibility->visible) {
+      if (is_new(vertices[index])) {
+        neighbors.push_back(vertices[index]);
+      }
+    }
+  } else {
+    // Check them all in one go, like visibility does.
+    const auto blocked = surface.tree.intersects(edges);
+    for (size_t i = 0; i < edges.size(); i++) {
+      if (!blocked[i]) {
+        neighbors.push_back(edges[i].first == current ? edges[i].second : edges[i].first);
+      }
+    }
+  }
+  if (first_time) {
+    open.erase(current);
+    closed.push_back(current);
+  }
+  expanded_radius[current] = radius;
+  vector<point_type_fp> improved;
+  for (const auto& neighbor : neighbors) {
+    if (expanded_radius.count(neighbor) > 0) {
+      continue;
+    }
+    const auto tentative_g_score = g_score.at(current) + bg::distance(current, neighbor);
+    if (g_score.count(neighbor) == 0 || tentative_g_score < g_score.at(neighbor)) {
+      came_from[neighbor] = current;
+      g_score[neighbor] = tentative_g_score;
+      open.insert(neighbor);
+      improved.push_back(neighbor);
+    }
+  }
+  return improved;
+}
+
+optional<linestring_type_fp> PathSearchTree::find_path(
+    const point_type_fp& goal,
+    const coordinate_type_fp& max_path_length,
+    const boost::optional<size_t>& max_tries) {
+  if (max_tries && *max_tries == 0) {
+    return boost::none;
+  }
+  SearchContext context(max_tries);
+  // Connect if a direct connection is possible, just like
+  // PathFindingSurface::find_path.
+  try {
+    if (surface.in_surface(start, goal)) {
+      context.decrement_tries();
+      if (bg::comparable_distance(start, goal) < max_path_length * max_path_length) {
+        return {{start, goal}};
+      } else {
+        return boost::none;
+      }
+    }
+  } catch (GiveUp g) {
+    return boost::none;
+  }
+  // The shortest path found so far goes through best_vertex and then
+  // straight to the goal.  Until there is one, any path up to
+  // max_path_length will do.
+  coordinate_type_fp best_length = max_path_length;
+  optional<point_type_fp> best_vertex;
+  auto might_improve = [&](coordinate_type_fp length) {
+    return best_vertex ? length < best_length : length <= best_length;
+  };
+  // The length of the path through p, if p can see the goal.
+  auto f_score = [&](const point_type_fp& p) {
+    return g_score.at(p) + bg::distance(p, goal);
+  };
+  priority_queue<pair<coordinate_type_fp, point_type_fp>,
+                 vector<pair<coordinate_type_fp, point_type_fp>>,
+                 std::greater<pair<coordinate_type_fp, point_type_fp>>> open_set;
+  // Expand p as far as might be useful for this goal.  A neighbor
+  // further than that couldn't be on a short enough path.
+  auto expand_for_goal = [&](const point_type_fp& p) {
+    for (const auto& neighbor : expand(p, best_length - g_score.at(p), context)) {
+      if (might_improve(f_score(neighbor))) {
+        open_set.emplace(f_score(neighbor), neighbor);
+      }
+    }
+  };
+  try {
+    // The closed vertices already have their shortest paths so the
+    // best of them is the first one that can see the goal.
+    vector<pair<coordinate_type_fp, point_type_fp>> closed_candidates;
+    for (const auto& vertex : closed) {
+      if (might_improve(f_score(vertex))) {
+        closed_candidates.emplace_back(f_score(vertex), vertex);
+      }
+    }
+    std::sort(closed_candidates.begin(), closed_candidates.end());
+    for (const auto& candidate : closed_candidates) {
+      if (candidate.second == start) {
+        continue; // Already tried above.
+      }
+      context.decrement_tries();
+      if (candidate.second == goal || surface.in_surface(candidate.second, goal)) {
+        best_length = candidate.first;
+        best_vertex = candidate.second;
+        break;
+      }
+    }
+    // Closed vertices that weren't expanded far enough for this goal
+    // might have more neighbors on the way.
+    for (const auto& candidate : closed_candidates) {
+      if (might_improve(candidate.first) &&
+          expanded_radius.at(candidate.second) < best_length - g_score.at(candidate.second)) {
+        expand_for_goal(candidate.second);
+      }
+    }
+    // Then A* from the open vertices, with the heuristic for this goal.
+    for (const auto& p : open) {
+      if (might_improve(f_score(p))) {
+        open_set.emplace(f_score(p), p);
+      }
+    }
+    while (!open_set.empty() && might_improve(open_set.top().first)) {
+      const auto current = open_set.top().second;
+      if (expanded_radius.count(current) > 0 || open_set.top().first != f_score(current)) {
+        // Already expanded or there is a newer entry with a shorter path.
+        open_set.pop();
+        continue;
+      }
+      open_set.pop();
+      expand_for_goal(current);
+      if (current != start && might_improve(f_score(current))) {
+        context.decrement_tries();
+        if (current == goal || surface.in_surface(current, goal)) {
+          best_length = f_score(current);
+          best_vertex = current;
+        }
+      }
+    }
+  } catch (GiveUp g) {
+    return boost::none;
+  }
+  if (!best_vertex) {
+    return boost::none;
+  }
+  auto path = build_path(*best_vertex, came_from);
+  if (*best_vertex != goal) {
+    path.push_back(goal);
+  }
+  return path;
 }
 
 const std::vector<point_type_fp>&
 PathFindingSurface::vertices(SearchKey search_key) const {
-  auto memoized_result = vertices_memo.find(search_key);
-  if (memoized_result != vertices_memo.cend()) {
-    return memoized_result->second;
-  }
-  std::vector<point_type_fp> ret;
-  const auto& vertices = all_vertices;
-  const auto& ring_indices = ring_indices_cache.at(search_key);
-  for (size_t poly_index = 0; poly_index < ring_indices.size() ; poly_index++) {
-    // This is the poly to look at.
-    const auto& poly_ring_index = ring_indices[poly_index];
-    // These are the vertices for that poly.
-    const auto& poly_vertices = vertices[poly_ring_index.first];
-    for (size_t ring_index = 0; ring_index < poly_ring_index.second.size(); ring_index++) {
-      const auto& ring_ring_index = poly_ring_index.second[ring_index];
-      const auto& ring_vertices = poly_vertices[ring_ring_index.first];
-      ret.insert(ret.cend(), ring_vertices.cbegin(), ring_vertices.cend());
-    }
-  }
-  return vertices_memo.emplace(search_key, ret).first->second;
+  return vertices_memo.get(search_key, [&]() {
+    std::vector<point_type_fp> ret;
+    const auto& vertices = all_vertices;
+    const auto& ring_indices = ring_indices_cache.at(search_key);
+    for (size_t poly_index = 0; poly_index < ring_indices.size() ; poly_index++) {
+      // This is the poly to look at.
+      const auto& poly_ring_index = ring_indices[poly_index];
+      // These are the vertices for that poly.
+      const auto& poly_vertices = vertices[poly_ring_index.first];
+      for (size_t ring_index = 0; ring_index < poly_ring_index.second.size(); ring_index++) {
+        const auto& ring_ring_index = poly_ring_index.second[ring_index];
+        const auto& ring_vertices = poly_vertices[ring_ring_index.first];
+        ret.insert(ret.cend(), ring_vertices.cbegin(), ring_vertices.cend());
+      }
+    }
+    return ret;
+  });
+}
+
+const Visibility& PathFindingSurface::visibility(SearchKey search_key, const point_type_fp& p) const {
+  return visibility_memo.get({search_key, p}, [&]() {
+    Visibility ret{{}, 0};
+    const auto& search_vertices = vertices(search_key);
+    // Check all the edges in one go instead of through the edge memo.
+    // They are ordered like in_surface orders them.
+    vector<pair<point_type_fp, point_type_fp>> edges;
+    vector<size_t> indices;
+    for (size_t i = 0; i < search_vertices.size(); i++) {
+      if (search_vertices[i] == p) {
+        ret.same++;
+      } else {
+        edges.push_back(search_vertices[i] < p ?
+                         make_pair(search_vertices[i], p) :
+                         make_pair(p, search_vertices[i]));
+        indices.push_back(i);
+      }
+    }
+    const auto blocked = tree.intersects(edges);
+    for (size_t i = 0; i < indices.size(); i++) {
+      if (!blocked[i]) {
+        ret.visible.push_back(indices[i]);
+      }
+    }
+    return ret;
+  });
+}
+
+coordinate_type_fp Heuristic::operator()(const point_type_fp& p) const {
+  coordinate_type_fp ret = bg::distance(p, target);
+  if (landmarks == nullptr || p == target) {
+    return ret;
+  }
+  const auto index = landmarks->index.find(p);
+  if (index == landmarks->index.cend()) {
+    return ret;
+  }
+  // A path from p to the target goes through the vertices and then a
+  // last one that can see the target.  By the triangle inequality, it
+  // is no shorter than the difference between the distances to p and
+  // to that last vertex from any landmark.
+  for (size_t l = 0; l < lower.size(); l++) {
+    const auto distance = landmarks->distances[l][index->second];
+    if (distance == std::numeric_limits<coordinate_type_fp>::infinity()) {
+      continue;
+    }
+    if (lower[l] != std::numeric_limits<coordinate_type_fp>::infinity()) {
+      ret = std::max(ret, lower[l] - distance);
+      ret = std::max(ret, distance - upper[l]);
+    }
+  }
+  return ret;
+}
+
+Heuristic PathFindingSurface::heuristic(SearchKey search_key, const point_type_fp& target) const {
+  if (landmark_count == 0) {
+    return Heuristic(target);
+  }
+  const auto& search_landmarks = landmarks(search_key);
+  const auto& search_vertices = vertices(search_key);
+  const auto& target_visibility = visibility(search_key, target);
+  vector<coordinate_type_fp> lower(search_landmarks.distances.size(),
+                                   std::numeric_limits<coordinate_type_fp>::infinity());
+  vector<coordinate_type_fp> upper(search_landmarks.distances.size(),
+                                   -std::numeric_limits<coordinate_type_fp>::infinity());
+  auto add_last_vertex = [&](const point_type_fp& vertex) {
+    const auto index = search_landmarks.index.at(vertex);
+    const auto last_step = bg::distance(vertex, target);
+    for (size_t l = 0; l < lower.size(); l++) {
+      const auto distance = search_landmarks.distances[l][index];
+      if (distance != std::numeric_limits<coordinate_type_fp>::infinity()) {
+        lower[l] = std::min(lower[l], distance + last_step);
+        upper[l] = std::max(upper[l], distance - last_step);
+      }
+    }
+  };
+  for (const auto& index : target_visibility.visible) {
+    add_last_vertex(search_vertices[index]);
+  }
+  if (target_visibility.same > 0) {
+    // The target is a vertex.
+    add_last_vertex(target);
+  }
+  return Heuristic(target, &search_landmarks, lower, upper);
+}
+
+const Landmarks& PathFindingSurface::landmarks(SearchKey search_key) const {
+  return landmarks_memo.get(search_key, [&]() {
+    Landmarks ret;
+    const auto& search_vertices = vertices(search_key);
+    vector<point_type_fp> points;
+    for (const auto& vertex : search_vertices) {
+      if (ret.index.emplace(vertex, points.size()).second) {
+        points.push_back(vertex);
+      }
+    }
+    if (points.empty()) {
+      return ret;
+    }
+    // The visibility graph of the vertices, by index.
+    vector<vector<size_t>> edges(points.size());
+    for (size_t i = 0; i < points.size(); i++) {
+      for (const auto& visible : visibility(search_key, points[i]).visible) {
+        edges[i].push_back(ret.index.at(search_vertices[visible]));
+      }
+    }
+    // Dijkstra from one vertex to all the others.
+    auto shortest_paths = [&](size_t from) {
+      vector<coordinate_type_fp> distances(points.size(),
+                                           std::numeric_limits<coordinate_type_fp>::infinity());
+      priority_queue<pair<coordinate_type_fp, size_t>,
+                     vector<pair<coordinate_type_fp, size_t>>,
+                     std::greater<pair<coordinate_type_fp, size_t>>> open_set;
+      distances[from] = 0;
+      open_set.emplace(0, from);
+      while (!open_set.empty()) {
+        const auto current = open_set.top();
+        open_set.pop();
+        if (current.first > distances[current.second]) {
+          continue;
+        }
+        for (const auto& neighbor : edges[current.second]) {
+          const auto distance = current.first + bg::distance(points[current.second], points[neighbor]);
+          if (distance < distances[neighbor]) {
+            distances[neighbor] = distance;
+            open_set.emplace(distance, neighbor);
+          }
+        }
+      }
+      return distances;
+    };
+    // Landmarks that are far apart and on the edges are best.  The
+    // first is the vertex furthest from an arbitrary one and each one
+    // after is the vertex furthest from the landmarks before it,
+    // preferring ones that none of them can reach.
+    size_t next = 0;
+    for (size_t i = 0; i < points.size(); i++) {
+      if (bg::comparable_distance(points[0], points[i]) > bg::comparable_distance(points[0], points[next])) {
+        next = i;
+      }
+    }
+    vector<coordinate_type_fp> nearest_landmark(points.size(),
+                                                std::numeric_limits<coordinate_type_fp>::infinity());
+    while (ret.distances.size() < landmark_count) {
+      ret.distances.push_back(shortest_paths(next));
+      for (size_t i = 0; i < points.size(); i++) {
+        nearest_landmark[i] = std::min(nearest_landmark[i], ret.distances.back()[i]);
+      }
+      next = std::max_element(nearest_landmark.cbegin(), nearest_landmark.cend()) - nearest_landmark.cbegin();
+      if (nearest_landmark[next] == 0) {
+        // Every vertex is already a landmark.
+        break;
+      }
+    }
+    return ret;
+  });
 }
 
 } //namespace path_finding
@@ -2,80 +2,24 @@
 #define PATH_FINDING_H
 
 #include <boost/optional.hpp>
+#include <deque>
+#include <mutex>
 #include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include "geometry.hpp"
 #include "bg_operators.hpp"
 #include "segment_tree.hpp"
+#include "sharded_memo.hpp"
 
 namespace path_finding {
 
-// is_left(): tests if a point is Left|On|Right of an infinite line.
-//    Input:  three points p0, p1, and p2
-//    Return: >0 for p2 left of the line through p0 and p1
-//            =0 for p2 on the line
-//            <0 for p2 right of the line
-//    See: Algorithm 1 "Area of Triangles and Polygons"
-//    This is p0p1 cross p0p2.
-extern inline coordinate_type_fp is_left(point_type_fp p0, point_type_fp p1, point_type_fp p2) {
-  return ((p1.x() - p0.x()) * (p2.y() - p0.y()) -
-          (p2.x() - p0.x()) * (p1.y() - p0.y()));
-}
-
-// Is x between a and b, where a can be lesser or greater than b.  If
-// x == a or x == b, also returns true. */
-extern inline coordinate_type_fp is_between(coordinate_type_fp a,
-                                            coordinate_type_fp x,
-                                            coordinate_type_fp b) {
-  return x == a || x == b || (a-x>0) == (x-b>0);
-}
-
-// https://stackoverflow.com/questions/563198/how-do-you-detect-where-two-line-segments-intersect
-extern inline bool is_intersecting(const point_type_fp& p0, const point_type_fp& p1,
-                                   const point_type_fp& p2, const point_type_fp& p3) {
-  const coordinate_type_fp left012 = is_left(p0, p1, p2);
-  const coordinate_type_fp left013 = is_left(p0, p1, p3);
-  const coordinate_type_fp left230 = is_left(p2, p3, p0);
-  const coordinate_type_fp left231 = is_left(p2, p3, p1);
-
-  if (p0 != p1) {
-    if (left012 == 0) {
-      if (is_between(p0.x(), p2.x(), p1.x()) &&
-          is_between(p0.y(), p2.y(), p1.y())) {
-        return true; // p2 is on the line p0 to p1
-      }
-    }
-    if (left013 == 0) {
-      if (is_between(p0.x(), p3.x(), p1.x()) &&
-          is_between(p0.y(), p3.y(), p1.y())) {
-        return true; // p3 is on the line p0 to p1
-      }
-    }
-  }
-  if (p2 != p3) {
-    if (left230 == 0) {
-      if (is_between(p2.x(), p0.x(), p3.x()) &&
-          is_between(p2.y(), p0.y(), p3.y())) {
-        return true; // p0 is on the line p2 to p3
-      }
-    }
-    if (left231 == 0) {
-      if (is_between(p2.x(), p1.x(), p3.x()) &&
-          is_between(p2.y(), p1.y(), p3.y())) {
-        return true; // p1 is on the line p2 to p3
-      }
-    }
-  }
-  if ((left012 > 0) == (left013 > 0) ||
-      (left230 > 0) == (left231 > 0)) {
-    if (p1 == p2) {
-      return true;
-    }
-    return false;
-  } else {
-    return true;
-  }
-}
+// These are shared with the segment tree.
+using segment_tree::is_left;
+using segment_tree::is_between;
+using segment_tree::is_intersecting;
 
 class PathFindingSurface;
 
@@ -102,6 +46,40 @@ extern inline bool point_in_ring(const point_type_fp& point, const ring_type_fp&
   return winding_number != 0;
 }
 
+// Answers point_in_ring() for one ring without looking at all of its
+// edges.  The height of the ring is cut into rows and each row lists
+// the edges that span any of it.  A point only needs to be checked
+// against the edges in its row.
+class RingGrid {
+ public:
+  explicit RingGrid(const ring_type_fp& ring);
+  // The same as point_in_ring(point, ring).
+  bool contains(const point_type_fp& point) const;
+
+ private:
+  size_t row(coordinate_type_fp y) const;
+  coordinate_type_fp min_y;
+  coordinate_type_fp max_y;
+  coordinate_type_fp row_height;
+  size_t row_count;
+  // The edges of row r are from row_starts[r] to row_starts[r+1].
+  // They keep the direction that they have in the ring.
+  std::vector<size_t> row_starts;
+  std::vector<std::pair<point_type_fp, point_type_fp>> edges;
+};
+
+// A RingGrid for each ring that was added, found by the address of the
+// ring.  The rings must not move after they are added.
+class RingGrids {
+ public:
+  void add(const ring_type_fp& ring);
+  // The same as point_in_ring(point, ring) but faster if the ring was
+  // added.
+  bool point_in_ring(const point_type_fp& point, const ring_type_fp& ring) const;
+ private:
+  std::unordered_map<const ring_type_fp*, RingGrid> grids;
+};
+
 class nested_polygon_type_fp {
  public:
   nested_polygon_type_fp(
@@ -126,16 +104,110 @@ using nested_multipolygon_type_fp = std::vector<nested_polygon_type_fp>;
 using MPRingIndices = std::vector<std::pair<size_t, std::vector<size_t>>>;
 using RingIndices = std::vector<std::pair<size_t, std::vector<std::pair<size_t, MPRingIndices>>>>;
 using SearchKey = size_t;
+// If grids are provided, they are used for the rings in them.
 boost::optional<MPRingIndices> inside_multipolygon(const point_type_fp& p,
-                                  const multi_polygon_type_fp& mp);
+                                  const multi_polygon_type_fp& mp,
+                                  const RingGrids* grids = nullptr);
 boost::optional<MPRingIndices> outside_multipolygon(const point_type_fp& p,
-                                   const multi_polygon_type_fp& mp);
+                                   const multi_polygon_type_fp& mp,
+                                   const RingGrids* grids = nullptr);
 boost::optional<RingIndices> inside_multipolygons(
     const point_type_fp& p,
-    const nested_multipolygon_type_fp& mp);
+    const nested_multipolygon_type_fp& mp,
+    const RingGrids* grids = nullptr);
 boost::optional<RingIndices> outside_multipolygons(
     const point_type_fp& p,
-    const nested_multipolygon_type_fp& mp);
+    const nested_multipolygon_type_fp& mp,
+    const RingGrids* grids = nullptr);
+
+// The state of a single search.  Keeping it out of the surface lets
+// many searches share a surface at once.
+class SearchContext {
+ public:
+  explicit SearchContext(const boost::optional<size_t>& max_tries) :
+    tries(max_tries) {}
+  // Throws GiveUp if there are no tries left.
+  void decrement_tries();
+  // Use up count tries at once.  Throws GiveUp if there aren't that
+  // many left.
+  void decrement_tries(size_t count);
+  // Count a vertex whose neighbors were searched.
+  void count_expansion() { expansion_count++; }
+  size_t expansions() const { return expansion_count; }
+ private:
+  boost::optional<size_t> tries;
+  size_t expansion_count = 0;
+};
+
+// Gives each distinct RingIndices a SearchKey, counting up from 0 in
+// the order that they are first seen.  This may be used from many
+// threads at once.
+class RingIndicesCache {
+ public:
+  RingIndicesCache() = default;
+  // Only for moving a cache that no other thread is using.
+  RingIndicesCache(RingIndicesCache&& other) :
+    ring_indices(std::move(other.ring_indices)),
+    lookup(std::move(other.lookup)) {}
+  SearchKey key(const RingIndices& ring_indices);
+  const RingIndices& at(SearchKey search_key) const;
+ private:
+  mutable std::mutex mutex;
+  // A deque so that references to the elements stay valid as it grows.
+  std::deque<RingIndices> ring_indices;
+  std::unordered_map<RingIndices, SearchKey> lookup;
+};
+
+// The vertices of a SearchKey that can be reached in a straight line
+// from a point.
+struct Visibility {
+  // Indices into the vertices of the SearchKey, in order.
+  std::vector<size_t> visible;
+  // How many of the vertices are at the point itself.
+  size_t same;
+};
+
+// The lengths of the shortest paths through the vertices of a
+// SearchKey, from each of a few of the vertices, the landmarks, to all
+// of them.
+struct Landmarks {
+  // The index of each vertex in the distances.  Copies of a vertex
+  // share an index.
+  std::unordered_map<point_type_fp, size_t> index;
+  // distances[l][i] is from landmark l to the vertex with index i.
+  // Infinity if it can't be reached.
+  std::vector<std::vector<coordinate_type_fp>> distances;
+};
+
+// A lower bound on the length of a path from a point to the target,
+// for A*.  It is the straight line or, with landmarks, what the
+// triangle inequality says about the path through the vertices, if
+// that is longer.  Either way, a step along an edge never lowers it by
+// more than the length of the edge so A* can close each vertex the
+// first time that it is reached.
+class Heuristic {
+ public:
+  explicit Heuristic(const point_type_fp& target) :
+    target(target),
+    landmarks(nullptr) {}
+  // lower[l] and upper[l] are the least and greatest values of the
+  // distance from landmark l to a vertex plus or minus the distance
+  // from that vertex to the target, over the vertices that can see the
+  // target.
+  Heuristic(const point_type_fp& target, const Landmarks* landmarks,
+            std::vector<coordinate_type_fp> lower,
+            std::vector<coordinate_type_fp> upper) :
+    target(target),
+    landmarks(landmarks),
+    lower(std::move(lower)),
+    upper(std::move(upper)) {}
+  coordinate_type_fp operator()(const point_type_fp& p) const;
+ private:
+  const point_type_fp target;
+  const Landmarks* landmarks;
+  std::vector<coordinate_type_fp> lower;
+  std::vector<coordinate_type_fp> upper;
+};
 
 class Neighbors {
  public:
@@ -157,8 +229,10 @@ class Neighbors {
             const point_type_fp& current,
             const coordinate_type_fp& max_path_length,
             const std::vector<point_type_fp>& vertices,
-            const PathFindingSurface* pfs);
-  inline bool is_neighbor(const point_type_fp p) const;
+            const PathFindingSurface* pfs,
+            SearchContext* context,
+            const Visibility* visibility = nullptr);
+  inline bool is_neighbor(size_t point_index) const;
   iterator begin() const;
   iterator end() const;
   const point_type_fp& start;
@@ -169,6 +243,74 @@ class Neighbors {
   const coordinate_type_fp max_path_length_squared;
   const std::vector<point_type_fp>& vertices;
   const PathFindingSurface* pfs;
+  SearchContext* context;
+  // If set, only these vertices are considered and they are already
+  // known to be in the surface.
+  const Visibility* visibility;
+};
+
+// Searches out from one start for paths to many goals, one goal at a
+// time.  Each goal gets an A* search that carries on from the tree
+// that the searches before it left: the vertices that they already
+// reached keep their distances from the start and the ones that they
+// were about to visit are visited next if they are on the way to the
+// new goal.  Like in find_path, a vertex is only connected to the
+// neighbors that are near enough to be worth it.  Like find_path, the
+// paths are the shortest ones but if there are many of the same
+// length, a different one might be picked.  Because max_tries only
+// counts the work that each goal adds, a goal might be found that
+// find_path would give up on.  Each instance must be used from only
+// one thread at a time but many can share a surface.
+class PathSearchTree {
+ public:
+  PathSearchTree(const PathFindingSurface& surface, const point_type_fp& start,
+                 SearchKey search_key);
+  // The same as the surface's find_path from the start.  max_tries
+  // limits the work done just for this goal.
+  boost::optional<linestring_type_fp> find_path(
+      const point_type_fp& goal,
+      const coordinate_type_fp& max_path_length,
+      const boost::optional<size_t>& max_tries);
+
+ private:
+  // Updates the neighbors of current that are no further than radius
+  // from it, moving it from open to closed if it wasn't already.
+  // Returns the neighbors that got a shorter path.  Throws GiveUp,
+  // without changing anything, if there aren't enough tries for it.
+  std::vector<point_type_fp> expand(const point_type_fp& current,
+                                    coordinate_type_fp radius,
+                                    SearchContext& context);
+
+  const PathFindingSurface& surface;
+  const point_type_fp start;
+  const SearchKey search_key;
+  // Reached but not yet expanded.
+  std::unordered_set<point_type_fp> open;
+  // Expanded, so their g_score is the length of the shortest path.
+  // Only the neighbors out to the radius have been updated.  A goal
+  // that needs more widens it.
+  std::vector<point_type_fp> closed;
+  std::unordered_map<point_type_fp, coordinate_type_fp> expanded_radius;
+  std::unordered_map<point_type_fp, point_type_fp> came_from;
+  std::unordered_map<point_type_fp, coordinate_type_fp> g_score;
+};
+
+// How a PathFindingSurface does its searches.  The path lengths found
+// are the same with any of them but if there are many of the same
+// length, a different one might be picked.
+struct SearchOptions {
+  // Save the vertices that can be seen from each vertex the first time
+  // that the vertex is reached, which uses more memory but makes later
+  // searches through that vertex much faster.  The paths found are the
+  // same either way.
+  bool visibility_graph = false;
+  // Search from both ends at once until the two searches meet.
+  bool bidirectional = false;
+  // If above 0, that many vertices of each region get the lengths of
+  // the shortest paths from them to all the other vertices, which makes
+  // a better heuristic for A*.  The first search in each region is slow
+  // because it needs what every vertex can see.
+  size_t landmark_count = 0;
 };
 
 class PathFindingSurface {
@@ -176,22 +318,30 @@ class PathFindingSurface {
   // Create a surface for doing path finding.  It can be used multiple times.  The
   // surface available for paths is within the keep_in and also outside the
   // keep_out.  If those are missing, they are ignored.  The tolerance should be a
-  // small epsilon value.
+  // small epsilon value.  All the const methods may be called from many threads
+  // at once.
   PathFindingSurface(const boost::optional<multi_polygon_type_fp>& keep_in,
                      const multi_polygon_type_fp& keep_out,
-                     const coordinate_type_fp tolerance);
+                     const coordinate_type_fp tolerance,
+                     const SearchOptions& options = SearchOptions());
   const boost::optional<SearchKey>& in_surface(point_type_fp p) const;
-  void decrement_tries() const;
   Neighbors neighbors(const point_type_fp& start, const point_type_fp& goal,
                       const coordinate_type_fp& max_path_length,
                       SearchKey search_key,
-                      const point_type_fp& current) const;
+                      const point_type_fp& current,
+                      SearchContext& context) const;
   // Find a path from start to goal in the available surface, limited
   // in operations.
   boost::optional<linestring_type_fp> find_path(
       const point_type_fp& start, const point_type_fp& goal,
       const coordinate_type_fp& max_path_length,
       const boost::optional<size_t>& max_tries) const;
+  // The same but the tries are taken from the context, which also
+  // counts the vertices whose neighbors were searched.
+  boost::optional<linestring_type_fp> find_path(
+      const point_type_fp& start, const point_type_fp& goal,
+      const coordinate_type_fp& max_path_length,
+      SearchContext& context) const;
   // Find a path from start to goal in the available surface, limited
   // in operations.
   boost::optional<linestring_type_fp> find_path(
@@ -199,17 +349,35 @@ class PathFindingSurface {
       const coordinate_type_fp& max_path_length,
       const boost::optional<size_t>& max_tries,
       SearchKey search_key) const;
+  // Find paths from start to each of the goals, each with its own
+  // maximum path length.  Like calling find_path for each one but the
+  // work is shared, as in PathSearchTree, which is also how max_tries
+  // is counted.
+  std::vector<boost::optional<linestring_type_fp>> find_paths(
+      const point_type_fp& start,
+      const std::vector<std::pair<point_type_fp, coordinate_type_fp>>& goals,
+      const boost::optional<size_t>& max_tries) const;
   const std::vector<point_type_fp>& vertices(SearchKey search_key) const;
+  const Visibility& visibility(SearchKey search_key, const point_type_fp& p) const;
+  const Landmarks& landmarks(SearchKey search_key) const;
   multi_polygon_type_fp get_surface() const;
 
  private:
   friend class Neighbors;
+  friend class PathSearchTree;
   bool in_surface(
       const point_type_fp& a, const point_type_fp& b) const;
   boost::optional<linestring_type_fp> find_path(
       const point_type_fp& start, const point_type_fp& goal,
       const coordinate_type_fp& max_path_length,
-      SearchKey search_key) const;
+      SearchKey search_key,
+      SearchContext& context) const;
+  boost::optional<linestring_type_fp> find_path_bidirectional(
+      const point_type_fp& start, const point_type_fp& goal,
+      const coordinate_type_fp& max_path_length,
+      SearchKey search_key,
+      SearchContext& context) const;
+  Heuristic heuristic(SearchKey search_key, const point_type_fp& target) const;
 
   // Each shape corresponses to an element in all_vertices and they
   // are in the same order.  The boolean indicates if this is the
@@ -217,21 +385,26 @@ class PathFindingSurface {
   // each shape.
   boost::optional<nested_multipolygon_type_fp> total_keep_in_grown;
   nested_multipolygon_type_fp keep_out_shrunk;
+  // For the rings of whichever of those two is used.
+  RingGrids ring_grids;
 
   // all_vertices is one list for each ring in the original.  The
   // lists are arranged in the same way as the RingIndices.
   std::vector<std::vector<std::vector<point_type_fp>>> all_vertices;
-  mutable std::unordered_map<std::pair<point_type_fp, point_type_fp>, bool> edge_in_surface_memo;
+  // The memos are filled in by the searches so they are mutable.  They
+  // are all safe to use from many threads.
+  sharded_memo::ShardedMemo<std::pair<point_type_fp, point_type_fp>, bool> edge_in_surface_memo;
   // RingIndices can be very large and slow to hash so we'll store
   // them here and elsewhere just store the index into this list.
-  mutable std::vector<RingIndices> ring_indices_cache;
-  mutable std::unordered_map<RingIndices, size_t,
-                             std::hash<RingIndices>,
-                             std::equal_to<RingIndices>> ring_indices_lookup;
-  mutable std::unordered_map<point_type_fp, boost::optional<SearchKey>> point_in_surface_memo;
+  mutable RingIndicesCache ring_indices_cache;
+  sharded_memo::ShardedMemo<point_type_fp, boost::optional<SearchKey>> point_in_surface_memo;
   segment_tree::SegmentTree tree;
-  mutable std::unordered_map<SearchKey, std::vector<point_type_fp>> vertices_memo;
-  mutable boost::optional<size_t> tries; // This is not great to be mutable.
+  sharded_memo::ShardedMemo<SearchKey, std::vector<point_type_fp>> vertices_memo;
+  bool visibility_graph;
+  sharded_memo::ShardedMemo<std::pair<SearchKey, point_type_fp>, Visibility> visibility_memo;
+  bool bidirectional;
+  size_t landmark_count;
+  sharded_memo::ShardedMemo<SearchKey, Landmarks> landmarks_memo;
 };
 
 struct GiveUp {};
@@ -0,0 +1,321 @@
+// Times path finding with and without the visibility graph.  Run it
+// from the top of the source tree:
+//
+//   make path_finding_benchmark && ./path_finding_benchmark [project directories...]
+//
+// The default projects are the multivibrator and D1MiniGSR examples.
+// The first copper layer of each one is loaded and grown by half of a
+// 0.01in tool to make the keep out.  Every tenth point of the
+// isolation rings is searched to the three nearest such points on
+// other rings, like when the toolpaths are joined up.  The searches
+// are done with each limit on tries that --path-finding-limit might
+// have and with no limit.  The same searches are run twice on one
+// surface.  The second round shows what a surface that is queried
+// many times gains from the saved work.
+//
+// Then the same searches, with no limit on tries, are run with each search
+// mode: plain A*, bidirectional, with landmarks and with both.  They
+// are also run on the shapes from path_finding_tests and on a maze
+// that makes the paths go back and forth, without a limit on the
+// length.  It shows how many vertices each mode expands.  The time
+// includes working out the landmarks.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/optional.hpp>
+
+#include "gerberimporter.hpp"
+#include "bg_operators.hpp"
+#include "bg_helpers.hpp"
+#include "path_finding.hpp"
+
+using std::cout;
+using std::endl;
+using std::string;
+using std::vector;
+
+// The first copper layer in the millproject of the directory.
+boost::optional<string> copper_file(const string& directory) {
+  std::ifstream millproject(directory + "/millproject");
+  string line;
+  while (std::getline(millproject, line)) {
+    const size_t equals = line.find('=');
+    if (equals == string::npos) {
+      continue;
+    }
+    const string key = boost::trim_copy(line.substr(0, equals));
+    if (key == "front" || key == "back") {
+      return directory + "/" + boost::trim_copy(line.substr(equals + 1));
+    }
+  }
+  return boost::none;
+}
+
+struct Query {
+  point_type_fp start;
+  point_type_fp goal;
+};
+
+// Every step'th vertex of the rings, with the index of its ring.
+vector<std::pair<point_type_fp, size_t>> sample_rings(const multi_polygon_type_fp& rings, size_t step) {
+  vector<std::pair<point_type_fp, size_t>> samples;
+  size_t ring_index = 0;
+  auto add_ring = [&](const ring_type_fp& ring) {
+    for (size_t i = 0; i + 1 < ring.size(); i += step) {
+      samples.push_back({ring[i], ring_index});
+    }
+    ring_index++;
+  };
+  for (const auto& poly : rings) {
+    add_ring(poly.outer());
+    for (const auto& inner : poly.inners()) {
+      add_ring(inner);
+    }
+  }
+  return samples;
+}
+
+// From each sample to the nearest few samples on other rings.
+vector<Query> make_queries(const multi_polygon_type_fp& rings, size_t step, size_t nearest) {
+  const auto samples = sample_rings(rings, step);
+  vector<Query> queries;
+  for (const auto& sample : samples) {
+    vector<point_type_fp> others;
+    for (const auto& other : samples) {
+      if (other.second != sample.second) {
+        others.push_back(other.first);
+      }
+    }
+    const size_t count = std::min(nearest, others.size());
+    std::partial_sort(others.begin(), others.begin() + count, others.end(),
+                      [&](const point_type_fp& a, const point_type_fp& b) {
+                        return bg::comparable_distance(sample.first, a) <
+                            bg::comparable_distance(sample.first, b);
+                      });
+    for (size_t j = 0; j < count; j++) {
+      queries.push_back({sample.first, others[j]});
+    }
+  }
+  return queries;
+}
+
+// A box with walls across it that leave a gap at alternate ends.
+multi_polygon_type_fp maze(size_t walls) {
+  multi_polygon_type_fp ret{{{{0,0}, {0,10.0*walls+10}, {100,10.0*walls+10}, {100,0}, {0,0}}}};
+  for (size_t i = 0; i < walls; i++) {
+    const coordinate_type_fp y = 10.0*i + 9;
+    const coordinate_type_fp left = i % 2 ? 10 : 0;
+    multi_polygon_type_fp wall{{{{left,y}, {left,y+2}, {left+90,y+2}, {left+90,y}, {left,y}}}};
+    ret = ret - wall;
+  }
+  return ret;
+}
+
+// From each end of each corridor of the maze to both ends of the
+// corridors a few rows up.
+vector<Query> maze_queries(size_t walls) {
+  vector<Query> queries;
+  for (size_t i = 0; i <= walls; i++) {
+    for (size_t j = i + 1; j <= std::min(walls, i + 5); j++) {
+      for (coordinate_type_fp x0 : {5, 95}) {
+        for (coordinate_type_fp x1 : {5, 95}) {
+          queries.push_back({point_type_fp(x0, 10.0*i + 4), point_type_fp(x1, 10.0*j + 4)});
+        }
+      }
+    }
+  }
+  return queries;
+}
+
+struct Board {
+  string name;
+  boost::optional<multi_polygon_type_fp> keep_in;
+  multi_polygon_type_fp keep_out;
+  coordinate_type_fp tolerance;
+  vector<Query> queries;
+  // Paths longer than the straight line times this aren't wanted.
+  coordinate_type_fp max_length_factor;
+};
+
+struct ModeResult {
+  double seconds;
+  size_t expansions;
+  vector<boost::optional<linestring_type_fp>> paths;
+};
+
+ModeResult run_mode(const Board& board, bool bidirectional, size_t landmark_count) {
+  const auto start = std::chrono::steady_clock::now();
+  path_finding::SearchOptions options;
+  options.bidirectional = bidirectional;
+  options.landmark_count = landmark_count;
+  const path_finding::PathFindingSurface surface(board.keep_in, board.keep_out, board.tolerance, options);
+  ModeResult result{0, 0, {}};
+  for (const auto& query : board.queries) {
+    path_finding::SearchContext context(boost::none);
+    result.paths.push_back(surface.find_path(query.start, query.goal,
+                                             bg::distance(query.start, query.goal) * board.max_length_factor,
+                                             context));
+    result.expansions += context.expansions();
+  }
+  result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return result;
+}
+
+// Paths of the same lengths, though maybe not the same paths.
+bool same_lengths(const vector<boost::optional<linestring_type_fp>>& a,
+                  const vector<boost::optional<linestring_type_fp>>& b) {
+  if (a.size() != b.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < a.size(); i++) {
+    if (bool(a[i]) != bool(b[i])) {
+      return false;
+    }
+    if (a[i] && std::abs(bg::length(*a[i]) - bg::length(*b[i])) > 1e-9 * bg::length(*a[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+struct Result {
+  double first_seconds;
+  double second_seconds;
+  vector<boost::optional<linestring_type_fp>> paths;
+};
+
+Result run(const multi_polygon_type_fp& keep_out, const vector<Query>& queries,
+           const boost::optional<size_t>& limit, bool visibility_graph) {
+  path_finding::SearchOptions options;
+  options.visibility_graph = visibility_graph;
+  const path_finding::PathFindingSurface surface(boost::none, keep_out, 0.0001, options);
+  Result result;
+  for (double* seconds : {&result.first_seconds, &result.second_seconds}) {
+    result.paths.clear();
+    const auto start = std::chrono::steady_clock::now();
+    for (const auto& query : queries) {
+      // Like pcb2gcode, don't bother with paths much longer than
+      // the straight line.
+      result.paths.push_back(surface.find_path(query.start, query.goal,
+                                               bg::distance(query.start, query.goal) * 3,
+                                               limit));
+    }
+    *seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  }
+  return result;
+}
+
+int main(int argc, char* argv[]) {
+  vector<string> projects;
+  for (int i = 1; i < argc; i++) {
+    projects.push_back(argv[i]);
+  }
+  if (projects.empty()) {
+    projects = {"testing/gerbv_example/multivibrator", "testing/gerbv_example/D1MiniGSR"};
+  }
+  const coordinate_type_fp tool_diameter = 0.01;
+  cout << std::left << std::setw(40) << "project"
+       << std::right << std::setw(8) << "limit"
+       << std::setw(9) << "queries"
+       << std::setw(7) << "found"
+       << std::setw(12) << "plain (s)"
+       << std::setw(12) << "graph (s)"
+       << std::setw(12) << "plain 2 (s)"
+       << std::setw(12) << "graph 2 (s)"
+       << std::setw(10) << "speedup"
+       << std::setw(6) << "same" << endl;
+  vector<Board> boards;
+  for (const auto& project : projects) {
+    const auto path = copper_file(project);
+    GerberImporter importer(true);
+    if (!path || !importer.load_file(*path)) {
+      cout << std::left << std::setw(40) << project << "  failed to load" << endl;
+      continue;
+    }
+    const multi_polygon_type_fp copper = importer.render(false, true, tessellation::Tessellation(30)).first;
+    const multi_polygon_type_fp keep_out = bg_helpers::buffer(copper, tool_diameter / 2);
+    const vector<Query> queries = make_queries(bg_helpers::buffer(copper, tool_diameter / 2 + 0.001), 10, 3);
+    boards.push_back({project, boost::none, keep_out, 0.0001, queries, 3});
+    for (const auto& limit : vector<boost::optional<size_t>>{10, 100, 1000, boost::none}) {
+      const Result plain = run(keep_out, queries, limit, false);
+      const Result graph = run(keep_out, queries, limit, true);
+      size_t found = 0;
+      for (const auto& found_path : plain.paths) {
+        found += found_path ? 1 : 0;
+      }
+      const double plain_total = plain.first_seconds + plain.second_seconds;
+      const double graph_total = graph.first_seconds + graph.second_seconds;
+      cout << std::left << std::setw(40) << project << std::right
+           << std::setw(8) << (limit ? std::to_string(*limit) : "none")
+           << std::setw(9) << queries.size()
+           << std::setw(7) << found
+           << std::fixed << std::setprecision(4)
+           << std::setw(12) << plain.first_seconds
+           << std::setw(12) << graph.first_seconds
+           << std::setw(12) << plain.second_seconds
+           << std::setw(12) << graph.second_seconds
+           << std::setprecision(2)
+           << std::setw(9) << (graph_total > 0 ? plain_total / graph_total : 0) << "x"
+           << std::setw(6) << (plain.paths == graph.paths ? "yes" : "NO") << endl;
+    }
+  }
+
+  const multi_polygon_type_fp almost_doughnut{
+    {{{0,0}, {0,100}, {49,100}, {49,80},
+      {30,70}, {20,20}, {80,20}, {80,80},
+      {51,80}, {51,100}, {100,100},
+      {100,0}, {0,0}}}};
+  const multi_polygon_type_fp barbell{{{{0,0}, {0,50}, {40,50}, {40,2}, {60,2},
+                                        {60,50}, {100,50}, {100,0}, {0,0}}}};
+  const auto infinity = std::numeric_limits<coordinate_type_fp>::infinity();
+  boards.push_back({"doughnut", almost_doughnut, {}, 3,
+                    {{{10,10}, {90,90}}, {{50,90}, {50,50}}, {{10,90}, {90,10}}}, infinity});
+  boards.push_back({"barbell", boost::none, barbell, 5,
+                    {{{-10,-10}, {110,60}}, {{50,10}, {-10,60}}, {{20,60}, {80,60}}}, infinity});
+  boards.push_back({"maze", maze(40), {}, 0.1, maze_queries(40), infinity});
+  struct Mode {
+    string name;
+    bool bidirectional;
+    size_t landmark_count;
+  };
+  const vector<Mode> modes{{"plain", false, 0}, {"bidirectional", true, 0},
+                           {"landmarks", false, 8}, {"both", true, 8}};
+  cout << endl
+       << std::left << std::setw(40) << "board"
+       << std::setw(15) << "mode"
+       << std::right << std::setw(9) << "queries"
+       << std::setw(7) << "found"
+       << std::setw(11) << "expanded"
+       << std::setw(12) << "time (s)"
+       << std::setw(6) << "same" << endl;
+  for (const auto& board : boards) {
+    vector<boost::optional<linestring_type_fp>> plain_paths;
+    for (const auto& mode : modes) {
+      const ModeResult result = run_mode(board, mode.bidirectional, mode.landmark_count);
+      if (plain_paths.empty()) {
+        plain_paths = result.paths;
+      }
+      size_t found = 0;
+      for (const auto& found_path : result.paths) {
+        found += found_path ? 1 : 0;
+      }
+      cout << std::left << std::setw(40) << board.name
+           << std::setw(15) << mode.name << std::right
+           << std::setw(9) << board.queries.size()
+           << std::setw(7) << found
+           << std::setw(11) << result.expansions
+           << std::fixed << std::setprecision(4)
+           << std::setw(12) << result.seconds
+           << std::setw(6) << (same_lengths(plain_paths, result.paths) ? "yes" : "NO") << endl;
+    }
+  }
+}
@@ -1,6 +1,8 @@
 #define BOOST_TEST_MODULE path finding tests
 #include <boost/test/unit_test.hpp>
 
+#include <cmath>
+#include <map>
 #include <ostream>
 #include "geometry.hpp"
 #include "bg_operators.hpp"
@@ -12,6 +14,7 @@ using boost::make_optional;
 #include <boost/optional/optional_io.hpp>
 
 #include "path_finding.hpp"
+#include "thread_pool.hpp"
 
 using namespace std;
 using namespace path_finding;
@@ -116,6 +119,44 @@ BOOST_AUTO_TEST_CASE(point_in_ring_tests) {
   BOOST_CHECK_EQUAL(point_in_ring(point_type_fp{11,5}, ring), false);
 }
 
+// The grid must give the same answers as point_in_ring, including for
+// points on the vertices and edges and at the heights of vertices.
+BOOST_AUTO_TEST_CASE(ring_grid_tests) {
+  // A star with many spikes, so some rows are crossed many times.
+  ring_type_fp ring;
+  for (int i = 0; i < 200; i++) {
+    const double radius = i % 2 == 0 ? 10 : 3 + i % 7;
+    const double angle = -i * 2 * M_PI / 200;
+    ring.push_back(point_type_fp(std::round(radius * cos(angle) * 4) / 4,
+                                 std::round(radius * sin(angle) * 4) / 4));
+  }
+  ring.push_back(ring.front());
+  const RingGrid grid(ring);
+  size_t inside = 0;
+  for (double x = -11; x <= 11; x += 0.25) {
+    for (double y = -11; y <= 11; y += 0.25) {
+      const point_type_fp p(x, y);
+      BOOST_CHECK_EQUAL(grid.contains(p), point_in_ring(p, ring));
+      inside += point_in_ring(p, ring);
+    }
+  }
+  for (const auto& p : ring) {
+    BOOST_CHECK_EQUAL(grid.contains(p), point_in_ring(p, ring));
+  }
+  BOOST_CHECK_GT(inside, 0);
+
+  RingGrids grids;
+  grids.add(ring);
+  ring_type_fp not_added{{0,0}, {0,1}, {1,1}, {1,0}, {0,0}};
+  BOOST_CHECK_EQUAL(grids.point_in_ring({0,0}, ring), point_in_ring({0,0}, ring));
+  BOOST_CHECK_EQUAL(grids.point_in_ring({0.5,0.5}, not_added), true);
+  BOOST_CHECK_EQUAL(grids.point_in_ring({1.5,0.5}, not_added), false);
+
+  // Flat and empty rings.
+  BOOST_CHECK_EQUAL(RingGrid(ring_type_fp{{0,0}, {1,0}, {0,0}}).contains({0.5,0}), false);
+  BOOST_CHECK_EQUAL(RingGrid(ring_type_fp()).contains({0,0}), false);
+}
+
 BOOST_AUTO_TEST_SUITE(inside_multipolygon_tests)
 
 BOOST_AUTO_TEST_CASE(open_space) {
@@ -566,4 +607,221 @@ BOOST_AUTO_TEST_CASE(u_shape_keep_out) {
   BOOST_CHECK_EQUAL(ret, make_optional(expected));
 }
 
+// Many searches on one surface at once, each with its own limit on
+// tries, must find the same paths as searching one at a time, with or
+// without the visibility graph.
+BOOST_AUTO_TEST_CASE(parallel_searches) {
+  multi_polygon_type_fp barbell{{{{0,0}, {0,50}, {40,50}, {40,2}, {60,2},
+                                  {60,50}, {100,50}, {100,0}, {0,0}}}};
+  multi_polygon_type_fp almost_doughnut{
+    {{{0,0}, {0,100}, {49,100}, {49,80},
+      {30,70}, {20,20}, {80,20}, {80,80},
+      {51,80}, {51,100}, {100,100},
+      {100,0}, {0,0}}}};
+  struct Query {
+    point_type_fp start;
+    point_type_fp goal;
+    boost::optional<size_t> max_tries;
+  };
+  const vector<Query> queries{
+    {{-10,-10}, {110,60}, boost::none},
+    {{-10,-10}, {110,60}, make_optional(size_t(2))},
+    {{110,60}, {-10,-10}, boost::none},
+    {{50,-10}, {50,60}, boost::none},
+    {{-10,60}, {110,-10}, make_optional(size_t(30))},
+    {{10,10}, {90,90}, boost::none},
+    {{90,90}, {10,10}, make_optional(size_t(5))},
+    {{10,10}, {50,50}, boost::none},
+  };
+  for (const auto& keep_in_and_keep_out : vector<pair<boost::optional<multi_polygon_type_fp>, multi_polygon_type_fp>>{
+           {boost::none, barbell}, {almost_doughnut, multi_polygon_type_fp()}}) {
+    vector<boost::optional<linestring_type_fp>> expected;
+    {
+      auto surface = PathFindingSurface(keep_in_and_keep_out.first, keep_in_and_keep_out.second, 3);
+      for (const auto& query : queries) {
+        expected.push_back(surface.find_path(query.start, query.goal, infinity, query.max_tries));
+      }
+    }
+    for (bool visibility_graph : {false, true}) {
+      SearchOptions options;
+      options.visibility_graph = visibility_graph;
+      auto surface = PathFindingSurface(keep_in_and_keep_out.first, keep_in_and_keep_out.second, 3, options);
+      const size_t rounds = 50;
+      vector<boost::optional<linestring_type_fp>> results(queries.size() * rounds);
+      thread_pool::set_jobs(8);
+      thread_pool::parallel_for(results.size(), [&](size_t i) {
+        results[i] = surface.find_path(queries[i % queries.size()].start, queries[i % queries.size()].goal,
+                                       infinity, queries[i % queries.size()].max_tries);
+      });
+      for (size_t i = 0; i < results.size(); i++) {
+        BOOST_CHECK_EQUAL(results[i], expected[i % queries.size()]);
+      }
+    }
+  }
+}
+
+// Searching from one start to many goals must find paths that are as
+// short as the ones found one at a time, and only when those are
+// found.
+BOOST_AUTO_TEST_CASE(many_goals) {
+  multi_polygon_type_fp almost_doughnut{
+    {{{0,0}, {0,100}, {49,100}, {49,80},
+      {30,70}, {20,20}, {80,20}, {80,80},
+      {51,80}, {51,100}, {100,100},
+      {100,0}, {0,0}}}};
+  const point_type_fp start(50, 50);
+  // Some reachable, some too far for the length and one outside.
+  const vector<pair<point_type_fp, coordinate_type_fp>> goals{
+    {{50, 150}, infinity},
+    {{10, 10}, infinity},
+    {{50, 110}, 100},
+    {{50, 110}, 200},
+    {{50, 50}, infinity},
+    {{150, 50}, infinity},
+    {{90, 90}, infinity},
+    {{50, 10}, 50},
+    {{50, 10}, 100},
+    {{-10, -10}, 1000},
+  };
+  for (bool visibility_graph : {false, true}) {
+    SearchOptions options;
+    options.visibility_graph = visibility_graph;
+    auto surface = PathFindingSurface(boost::none, almost_doughnut, 3, options);
+    for (const auto& max_tries : {boost::optional<size_t>(), make_optional(size_t(1))}) {
+      const auto results = surface.find_paths(start, goals, max_tries);
+      BOOST_REQUIRE_EQUAL(results.size(), goals.size());
+      size_t found = 0;
+      for (size_t i = 0; i < goals.size(); i++) {
+        const auto expected = surface.find_path(start, goals[i].first, goals[i].second, max_tries);
+        BOOST_CHECK_EQUAL(bool(results[i]), bool(expected));
+        if (results[i] && expected) {
+          found++;
+          BOOST_CHECK_EQUAL(results[i]->front(), start);
+          BOOST_CHECK_EQUAL(results[i]->back(), goals[i].first);
+          BOOST_CHECK_CLOSE(bg::length(*results[i]), bg::length(*expected), 1e-9);
+        }
+      }
+      BOOST_CHECK_GT(found, 0);
+      BOOST_CHECK_LT(found, goals.size());
+    }
+  }
+}
+
+// A box with walls across it that leave a gap at alternate ends, so
+// the way through goes back and forth.
+multi_polygon_type_fp maze(size_t walls) {
+  multi_polygon_type_fp ret{{{{0,0}, {0,10.0*walls+10}, {100,10.0*walls+10}, {100,0}, {0,0}}}};
+  for (size_t i = 0; i < walls; i++) {
+    const coordinate_type_fp y = 10.0*i + 9;
+    const coordinate_type_fp left = i % 2 ? 10 : 0;
+    multi_polygon_type_fp wall{{{{left,y}, {left,y+2}, {left+90,y+2}, {left+90,y}, {left,y}}}};
+    ret = ret - wall;
+  }
+  return ret;
+}
+
+// The bidirectional search and the landmarks must find paths of the
+// same lengths as the plain search, with and without a limit on the
+// length.
+BOOST_AUTO_TEST_CASE(search_modes) {
+  const multi_polygon_type_fp almost_doughnut{
+    {{{0,0}, {0,100}, {49,100}, {49,80},
+      {30,70}, {20,20}, {80,20}, {80,80},
+      {51,80}, {51,100}, {100,100},
+      {100,0}, {0,0}}}};
+  const multi_polygon_type_fp barbell{{{{0,0}, {0,50}, {40,50}, {40,2}, {60,2},
+                                        {60,50}, {100,50}, {100,0}, {0,0}}}};
+  struct Fixture {
+    boost::optional<multi_polygon_type_fp> keep_in;
+    multi_polygon_type_fp keep_out;
+    coordinate_type_fp tolerance;
+    vector<pair<point_type_fp, point_type_fp>> queries;
+  };
+  const vector<Fixture> fixtures{
+    {almost_doughnut, {}, 3, {{{10,10}, {90,90}}, {{50,90}, {50,50}}, {{10,90}, {90,10}}}},
+    {boost::none, barbell, 5, {{{-10,-10}, {110,60}}, {{50,10}, {-10,60}}, {{20,60}, {80,60}}}},
+    {maze(8), {}, 0.1, {{{5,5}, {5,85}}, {{95,5}, {50,55}}, {{50,25}, {50,75}}, {{5,5}, {500,5}}}},
+  };
+  // By whether it is bidirectional and the number of landmarks.
+  std::map<pair<bool, size_t>, size_t> expansions;
+  for (const auto& fixture : fixtures) {
+    const auto plain = PathFindingSurface(fixture.keep_in, fixture.keep_out, fixture.tolerance);
+    for (bool bidirectional : {false, true}) {
+      for (size_t landmark_count : {0, 1, 4}) {
+        SearchOptions options;
+        options.bidirectional = bidirectional;
+        options.landmark_count = landmark_count;
+        const auto surface = PathFindingSurface(fixture.keep_in, fixture.keep_out, fixture.tolerance, options);
+        for (const auto& query : fixture.queries) {
+          const auto expected = plain.find_path(query.first, query.second, infinity, boost::none);
+          SearchContext context(boost::none);
+          const auto ret = surface.find_path(query.first, query.second, infinity, context);
+          expansions[{bidirectional, landmark_count}] += context.expansions();
+          BOOST_REQUIRE_EQUAL(bool(ret), bool(expected));
+          if (!expected) {
+            continue;
+          }
+          BOOST_CHECK_EQUAL(ret->front(), query.first);
+          BOOST_CHECK_EQUAL(ret->back(), query.second);
+          const auto length = bg::length(*expected);
+          BOOST_CHECK_CLOSE(bg::length(*ret), length, 1e-9);
+          BOOST_CHECK(surface.find_path(query.first, query.second, length * 1.001, boost::none));
+          BOOST_CHECK(!surface.find_path(query.first, query.second, length * 0.999, boost::none));
+        }
+      }
+    }
+  }
+  // The landmarks lead more directly through the maze.
+  BOOST_CHECK_LT((expansions[{false, 4}]), (expansions[{false, 0}]));
+  BOOST_CHECK_LT((expansions[{true, 4}]), (expansions[{true, 0}]));
+}
+
+// With a limit on the tries, find_paths counts only the tries that
+// each goal adds to the search so it finds every path that find_path
+// finds, and some that find_path runs out of tries for.
+BOOST_AUTO_TEST_CASE(many_goals_limited) {
+  multi_polygon_type_fp almost_doughnut{
+    {{{0,0}, {0,100}, {49,100}, {49,80},
+      {30,70}, {20,20}, {80,20}, {80,80},
+      {51,80}, {51,100}, {100,100},
+      {100,0}, {0,0}}}};
+  const point_type_fp start(-10, 50);
+  // Around the outside, some of them too far for the length.
+  const vector<pair<point_type_fp, coordinate_type_fp>> goals{
+    {{110, 50}, infinity},
+    {{50, -10}, infinity},
+    {{50, 110}, 200},
+    {{110, 110}, infinity},
+    {{50, 105}, 100},
+    {{110, -10}, infinity},
+    {{-5, 105}, infinity},
+    {{50, 90}, infinity},
+  };
+  for (bool visibility_graph : {false, true}) {
+    SearchOptions options;
+    options.visibility_graph = visibility_graph;
+    auto surface = PathFindingSurface(boost::none, almost_doughnut, 3, options);
+    size_t found = 0;
+    size_t expected_found = 0;
+    for (size_t max_tries = 1; max_tries < 200; max_tries++) {
+      const auto results = surface.find_paths(start, goals, max_tries);
+      BOOST_REQUIRE_EQUAL(results.size(), goals.size());
+      for (size_t i = 0; i < goals.size(); i++) {
+        const auto expected = surface.find_path(start, goals[i].first, goals[i].second, max_tries);
+        if (expected) {
+          expected_found++;
+          BOOST_REQUIRE(results[i]);
+          BOOST_CHECK_CLOSE(bg::length(*results[i]), bg::length(*expected), 1e-9);
+        }
+        if (results[i]) {
+          found++;
+          BOOST_CHECK_EQUAL(results[i]->front(), start);
+          BOOST_CHECK_EQUAL(results[i]->back(), goals[i].first);
+        }
+      }
+    }
+    BOOST_CHECK_GT(found, expected_found);
+  }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -1,202 +1,270 @@
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <iostream>
+#include <string>
+
 #include <vector>
 using std::vector;
 
 #include <utility>
 using std::pair;
 
-#include <boost/optional.hpp>
-
 #include "bg_operators.hpp"
 
 #include "segment_tree.hpp"
-#include "value_ptr.hpp"
-using smart_ptr::value_ptr;
-using smart_ptr::make_value;
+
+// The SIMD kernel is compiled for AVX with a function attribute and
+// only used if the processor has it, so no special flags are needed.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SEGMENT_TREE_AVX
+#include <immintrin.h>
+#endif
 
 namespace segment_tree {
 
-template <bool on_x, bool less_than>
-value_ptr<Node> make_node(vector<segment_t>::iterator segments_begin,
-                          vector<segment_t>::iterator segments_end) {
-  if (segments_end - segments_begin == 1) {
-    // We're done.
-    return make_value<Node>(*segments_begin);
-  }
-  // Sort the segments as specified by on_x and less_than.
-  coordinate_type_fp (segment_t::*corner_axis_selector)() const;
-  coordinate_type_fp factor;
-  if (less_than && on_x) {
-    corner_axis_selector = &segment_t::max_x;
-    factor = 1;
-  } else if (less_than && !on_x) {
-    corner_axis_selector = &segment_t::max_y;
-    factor = 1;
-  } else if (!less_than && on_x) {
-    corner_axis_selector = &segment_t::min_x;
-    factor = -1;
-  } else if (!less_than && !on_x) {
-    corner_axis_selector = &segment_t::min_y;
-    factor = -1;
-  }
-  std::sort(segments_begin, segments_end,
-            [&](const segment_t& s0,
-                const segment_t& s1) {
-              return factor * (s0.*corner_axis_selector)() < factor * (s1.*corner_axis_selector)();
-            });
-  // Find the middle.  It will round down.  You can't add begin and
-  // end, it might overflow.  Behavior is undefined.
-  auto mid = segments_begin + (segments_end - segments_begin)/2;
-
-  const auto new_intercept = ((*mid).*corner_axis_selector)();
-  constexpr auto new_on_x = less_than ^ on_x;
-  constexpr auto new_less_than = !less_than;
-  // mid will get changed below so we neeed to store the intercept.
-  return make_value<Node>(new_intercept,
-                          make_node<new_on_x, new_less_than>(segments_begin, mid),
-                          make_node<new_on_x, new_less_than>(mid, segments_end));
-}
+namespace {
 
-constexpr bool START_ON_X = true;
-constexpr bool START_LESS_THAN = true;
+// Leaves hold up to this many segments.  Checking a few segments that
+// are next to each other in memory is cheaper than going down more
+// levels of the tree.
+constexpr size_t leaf_size = SegmentBlock::size;
 
-SegmentTree::SegmentTree(const vector<std::pair<point_type_fp, point_type_fp>>& segments_in) {
-  // For each segment, find the bounding box.
-  vector<segment_t> segments;
-  segments.reserve(segments_in.size());
-  for (const auto& segment : segments_in) {
-    segments.emplace_back(segment.first, segment.second);
-  }
-  if (segments.size() > 0) {
-    root = make_node<START_ON_X, START_LESS_THAN>(segments.begin(), segments.end());
+struct Segment {
+  point_type_fp first;
+  point_type_fp second;
+};
+
+// Segments are not directed so we always store them with the first
+// point having the lower x.  If the x values are the same then they
+// are in the order given.
+Segment make_segment(const point_type_fp& a, const point_type_fp& b) {
+  if (a.x() < b.x()) {
+    return {a, b};
+  } else {
+    return {b, a};
   }
 }
 
-// is_left(): tests if a point is Left|On|Right of an infinite line.
-//    Input:  three points p0, p1, and p2
-//    Return: >0 for p2 left of the line through p0 and p1
-//            =0 for p2 on the line
-//            <0 for p2 right of the line
-//    See: Algorithm 1 "Area of Triangles and Polygons"
-//    This is p0p1 cross p0p2.
-static inline coordinate_type_fp is_left(point_type_fp p0, point_type_fp p1, point_type_fp p2) {
-  return ((p1.x() - p0.x()) * (p2.y() - p0.y()) -
-          (p2.x() - p0.x()) * (p1.y() - p0.y()));
+SegmentTree::Box bounding_box(const Segment& segment) {
+  return {segment.first.x(),
+          std::min(segment.first.y(), segment.second.y()),
+          segment.second.x(),
+          std::max(segment.first.y(), segment.second.y())};
+}
+
+void expand(SegmentTree::Box& box, const SegmentTree::Box& other) {
+  box.min_x = std::min(box.min_x, other.min_x);
+  box.min_y = std::min(box.min_y, other.min_y);
+  box.max_x = std::max(box.max_x, other.max_x);
+  box.max_y = std::max(box.max_y, other.max_y);
 }
 
-// Is x between a and b, where a can be lesser or greater than b.  If
-// x == a or x == b, also returns true. */
-extern inline coordinate_type_fp is_between(coordinate_type_fp a,
-                                            coordinate_type_fp x,
-                                            coordinate_type_fp b) {
-  return x == a || x == b || (a-x>0) == (x-b>0);
+// Boxes that only touch overlap.
+inline bool overlaps(const SegmentTree::Box& a, const SegmentTree::Box& b) {
+  return a.min_x <= b.max_x && b.min_x <= a.max_x &&
+      a.min_y <= b.max_y && b.min_y <= a.max_y;
 }
 
+SegmentBlock make_block(vector<Segment>::const_iterator begin, vector<Segment>::const_iterator end) {
+  SegmentBlock block;
+  for (size_t i = 0; i < SegmentBlock::size; i++) {
+    const auto& segment = begin + i < end ? begin[i] : *begin;
+    block.x0[i] = segment.first.x();
+    block.y0[i] = segment.first.y();
+    block.x1[i] = segment.second.x();
+    block.y1[i] = segment.second.y();
+  }
+  return block;
+}
 
-// https://stackoverflow.com/questions/563198/how-do-you-detect-where-two-line-segments-intersect
-static inline bool is_intersecting(const point_type_fp& p0, const point_type_fp& p1,
-                                   const point_type_fp& p2, const point_type_fp& p3) {
-  const coordinate_type_fp left012 = is_left(p0, p1, p2);
-  const coordinate_type_fp left013 = is_left(p0, p1, p3);
-  const coordinate_type_fp left230 = is_left(p2, p3, p0);
-  const coordinate_type_fp left231 = is_left(p2, p3, p1);
+#ifdef SEGMENT_TREE_AVX
+// Computes is_left(a, b, c) for four triples at once and clears the
+// slots in certain where rounding might have given the wrong sign.
+// This is only compiled for AVX, not FMA, so the products are rounded
+// just like in is_left and the results are the same.
+__attribute__((target("avx")))
+inline __m256d is_left_avx(const __m256d& ax, const __m256d& ay,
+                           const __m256d& bx, const __m256d& by,
+                           const __m256d& cx, const __m256d& cy,
+                           __m256d& certain) {
+  const __m256d sign_bit = _mm256_set1_pd(-0.0);
+  // A generous bound on the rounding error, relative to the size of
+  // the products.
+  const __m256d error = _mm256_set1_pd(8 * DBL_EPSILON);
+  const __m256d first = _mm256_mul_pd(_mm256_sub_pd(bx, ax), _mm256_sub_pd(cy, ay));
+  const __m256d second = _mm256_mul_pd(_mm256_sub_pd(cx, ax), _mm256_sub_pd(by, ay));
+  const __m256d left = _mm256_sub_pd(first, second);
+  const __m256d bound = _mm256_mul_pd(error, _mm256_add_pd(_mm256_andnot_pd(sign_bit, first),
+                                                           _mm256_andnot_pd(sign_bit, second)));
+  certain = _mm256_and_pd(certain, _mm256_cmp_pd(_mm256_andnot_pd(sign_bit, left), bound, _CMP_GT_OQ));
+  return _mm256_cmp_pd(left, _mm256_setzero_pd(), _CMP_GT_OQ);
+}
 
-  if (p0 != p1) {
-    if (left012 == 0) {
-      if (is_between(p0.x(), p2.x(), p1.x()) &&
-          is_between(p0.y(), p2.y(), p1.y())) {
-        return true; // p2 is on the line p0 to p1
-      }
-    }
-    if (left013 == 0) {
-      if (is_between(p0.x(), p3.x(), p1.x()) &&
-          is_between(p0.y(), p3.y(), p1.y())) {
-        return true; // p3 is on the line p0 to p1
-      }
-    }
+// is_intersecting on all four segments of the block at once.  The
+// signs of the is_left values decide most cases.  Where an is_left is
+// so close to zero that its sign is in doubt, that slot is checked
+// again with is_intersecting, which handles the collinear and
+// touching cases.
+__attribute__((target("avx")))
+bool intersects_block_avx(const point_type_fp& p0, const point_type_fp& p1,
+                          const SegmentBlock& block) {
+  const __m256d x2 = _mm256_loadu_pd(block.x0);
+  const __m256d y2 = _mm256_loadu_pd(block.y0);
+  const __m256d x3 = _mm256_loadu_pd(block.x1);
+  const __m256d y3 = _mm256_loadu_pd(block.y1);
+  const __m256d x0 = _mm256_set1_pd(p0.x());
+  const __m256d y0 = _mm256_set1_pd(p0.y());
+  const __m256d x1 = _mm256_set1_pd(p1.x());
+  const __m256d y1 = _mm256_set1_pd(p1.y());
+  __m256d certain = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+  const __m256d left012 = is_left_avx(x0, y0, x1, y1, x2, y2, certain);
+  const __m256d left013 = is_left_avx(x0, y0, x1, y1, x3, y3, certain);
+  const __m256d left230 = is_left_avx(x2, y2, x3, y3, x0, y0, certain);
+  const __m256d left231 = is_left_avx(x2, y2, x3, y3, x1, y1, certain);
+  // Each segment has its ends on opposite sides of the other.
+  const __m256d crossing = _mm256_and_pd(_mm256_xor_pd(left012, left013),
+                                         _mm256_xor_pd(left230, left231));
+  if (_mm256_movemask_pd(_mm256_and_pd(certain, crossing)) != 0) {
+    return true;
   }
-  if (p2 != p3) {
-    if (left230 == 0) {
-      if (is_between(p2.x(), p0.x(), p3.x()) &&
-          is_between(p2.y(), p0.y(), p3.y())) {
-        return true; // p0 is on the line p2 to p3
-      }
-    }
-    if (left231 == 0) {
-      if (is_between(p2.x(), p1.x(), p3.x()) &&
-          is_between(p2.y(), p1.y(), p3.y())) {
-        return true; // p1 is on the line p2 to p3
-      }
+  const int uncertain = ~_mm256_movemask_pd(certain) & 0xf;
+  for (size_t i = 0; i < SegmentBlock::size; i++) {
+    if ((uncertain & (1 << i)) &&
+        is_intersecting(p0, p1,
+                        point_type_fp(block.x0[i], block.y0[i]),
+                        point_type_fp(block.x1[i], block.y1[i]))) {
+      return true;
     }
   }
-  if ((left012 > 0) == (left013 > 0) ||
-      (left230 > 0) == (left231 > 0)) {
-    if (p1 == p2) {
+  return false;
+}
+
+bool has_avx() {
+  static const bool result = __builtin_cpu_supports("avx");
+  return result;
+}
+#endif
+
+} // namespace
+
+bool intersects_block_portable(const point_type_fp& p0, const point_type_fp& p1,
+                               const SegmentBlock& block) {
+  for (size_t i = 0; i < SegmentBlock::size; i++) {
+    if (is_intersecting(p0, p1,
+                        point_type_fp(block.x0[i], block.y0[i]),
+                        point_type_fp(block.x1[i], block.y1[i]))) {
       return true;
     }
-    return false;
-  } else {
-    return true;
   }
+  return false;
 }
 
-template <bool on_x, bool less_than>
-bool intersects(const segment_t& segment, const value_ptr<Node>& node) {
-  if (node->segment) {
-    return is_intersecting(segment.first(), segment.second(),
-                           node->segment->first(), node->segment->second());
+bool intersects_block(const point_type_fp& p0, const point_type_fp& p1,
+                      const SegmentBlock& block) {
+#ifdef SEGMENT_TREE_AVX
+  if (has_avx()) {
+    return intersects_block_avx(p0, p1, block);
   }
-  constexpr auto new_on_x = less_than ^ on_x;
-  constexpr auto new_less_than = !less_than;
-  if (intersects<new_on_x, new_less_than>(segment, node->out)) {
-    return true;
+#endif
+  return intersects_block_portable(p0, p1, block);
+}
+
+SegmentTree::SegmentTree(const vector<std::pair<point_type_fp, point_type_fp>>& segments_in) {
+  vector<Segment> segments;
+  segments.reserve(segments_in.size());
+  for (const auto& segment : segments_in) {
+    segments.push_back(make_segment(segment.first, segment.second));
   }
-  coordinate_type_fp (segment_t::*corner_axis_selector)() const;
-  coordinate_type_fp factor;
-  if (less_than && on_x) {
-    corner_axis_selector = &segment_t::min_x;
-    factor = -1;
-  } else if (less_than && !on_x) {
-    corner_axis_selector = &segment_t::min_y;
-    factor = -1;
-  } else if (!less_than && on_x) {
-    corner_axis_selector = &segment_t::max_x;
-    factor = 1;
-  } else if (!less_than && !on_x) {
-    corner_axis_selector = &segment_t::max_y;
-    factor = 1;
+  if (segments.empty()) {
+    return;
   }
-  if (!(factor * (segment.*corner_axis_selector)() < factor * node->intercept)) {
-    return intersects<new_on_x, new_less_than>(segment, node->in);
+  // The range of segments under each node.  The nodes are added in
+  // the order that they are visited so they end up breadth-first.
+  vector<pair<uint32_t, uint32_t>> ranges{{0, uint32_t(segments.size())}};
+  for (size_t node = 0; node < ranges.size(); node++) {
+    const uint32_t begin = ranges[node].first;
+    const uint32_t end = ranges[node].second;
+    Box box = bounding_box(segments[begin]);
+    for (uint32_t i = begin + 1; i < end; i++) {
+      expand(box, bounding_box(segments[i]));
+    }
+    boxes.push_back(box);
+    if (end - begin <= leaf_size) {
+      links.push_back({uint32_t(blocks.size()), end - begin});
+      blocks.push_back(make_block(segments.cbegin() + begin, segments.cbegin() + end));
+      continue;
+    }
+    // Split at the median of the centers along the longer side.
+    const bool on_x = box.max_x - box.min_x >= box.max_y - box.min_y;
+    const uint32_t mid = begin + (end - begin) / 2;
+    std::nth_element(segments.begin() + begin, segments.begin() + mid, segments.begin() + end,
+                     [on_x](const Segment& s0, const Segment& s1) {
+                       return on_x ?
+                           s0.first.x() + s0.second.x() < s1.first.x() + s1.second.x() :
+                           s0.first.y() + s0.second.y() < s1.first.y() + s1.second.y();
+                     });
+    links.push_back({uint32_t(ranges.size()), 0});
+    ranges.emplace_back(begin, mid);
+    ranges.emplace_back(mid, end);
   }
-  return false;
 }
 
 bool SegmentTree::intersects(const point_type_fp& p0, const point_type_fp& p1) const {
-  if (root == nullptr) {
+  if (boxes.empty()) {
     return false;
   }
-  return segment_tree::intersects<START_ON_X, START_LESS_THAN>(segment_t(p0, p1), root);
+  const Segment segment = make_segment(p0, p1);
+  const Box box = bounding_box(segment);
+  // The tree is balanced so its depth is at most 32.
+  uint32_t stack[64];
+  size_t stack_size = 0;
+  stack[stack_size++] = 0;
+  while (stack_size > 0) {
+    const uint32_t node = stack[--stack_size];
+    if (!overlaps(boxes[node], box)) {
+      continue;
+    }
+    const Link& link = links[node];
+    if (link.count == 0) {
+      stack[stack_size++] = link.first;
+      stack[stack_size++] = link.first + 1;
+      continue;
+    }
+    if (intersects_block(segment.first, segment.second, blocks[link.first])) {
+      return true;
+    }
+  }
+  return false;
 }
 
-template <bool on_x, bool less_than>
-void print_node(const value_ptr<Node>& node, std::string indent = "") {
-  if (node->segment) {
-    std::cout << indent << bg::wkt(node->segment->first()) << " "
-              << bg::wkt(node->segment->second()) << std::endl;
-    return;
+vector<bool> SegmentTree::intersects(const vector<std::pair<point_type_fp, point_type_fp>>& segments) const {
+  vector<bool> ret;
+  ret.reserve(segments.size());
+  for (const auto& segment : segments) {
+    ret.push_back(intersects(segment.first, segment.second));
   }
-  std::cout << indent << "if all "
-            << (on_x ? "x" : "y") << " is " << (!less_than ? "less than" : "greater than")
-            << " " << node->intercept << " then:" << std::endl;
-  constexpr auto new_on_x = less_than ^ on_x;
-  constexpr auto new_less_than = !less_than;
-  print_node<new_on_x, new_less_than>(node->out, indent + "  ");
-  std::cout << indent << "else the above and:" << std::endl;
-  print_node<new_on_x, new_less_than>(node->in, indent + "  ");
+  return ret;
 }
 
 void SegmentTree::print() {
-  print_node<START_ON_X, START_LESS_THAN>(root);
+  for (size_t node = 0; node < boxes.size(); node++) {
+    const auto& box = boxes[node];
+    std::cout << node << ": " << box.min_x << " " << box.min_y << " "
+              << box.max_x << " " << box.max_y;
+    const auto& link = links[node];
+    if (link.count == 0) {
+      std::cout << " children " << link.first << " " << link.first + 1 << std::endl;
+    } else {
+      std::cout << " segments";
+      const auto& block = blocks[link.first];
+      for (uint32_t i = 0; i < link.count; i++) {
+        std::cout << " " << bg::wkt(point_type_fp(block.x0[i], block.y0[i]))
+                  << " " << bg::wkt(point_type_fp(block.x1[i], block.y1[i]));
+      }
+      std::cout << std::endl;
+    }
+  }
 }
 
-} //namespace path_finding
+} //namespace segment_tree
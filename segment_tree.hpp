@@ -2,61 +2,106 @@
 #define SEGMENT_TREE_HPP
 
 #include "geometry.hpp"
-#include "value_ptr.hpp"
+#include "bg_operators.hpp"
+#include <cstdint>
 #include <vector>
 #include <utility>
-#include <boost/optional.hpp>
 
 // A segment tree is initialized with a list of segments.  The
 // segments can have any orientation and may have duplicates.  It can
 // be queried: Find if any segments intersect with a given segment.
+//
+// It is a bounding volume hierarchy that is stored flat, in arrays,
+// breadth-first.  The boxes of the nodes are packed together and so
+// are the segments of each leaf so a query touches few cache lines.
 namespace segment_tree {
 
-// segments are not directed so we'll always store them with first
-// coordinate having the lower x and the second coordinate having the
-// greater x.  If the x values are the same then they can be in either
-// order.  The bool stores true if the first y is less than the second
-// y.  Otherwise false.  If the y values are equal then it doesn't
-// matter.
-class segment_t {
- public:
-  segment_t(point_type_fp a, point_type_fp b) {
-    if (a.x() < b.x()) {
-      first_ = a;
-      second_ = b;
-    } else {
-      first_ = b;
-      second_ = a;
+// is_left(): tests if a point is Left|On|Right of an infinite line.
+//    Input:  three points p0, p1, and p2
+//    Return: >0 for p2 left of the line through p0 and p1
+//            =0 for p2 on the line
+//            <0 for p2 right of the line
+//    See: Algorithm 1 "Area of Triangles and Polygons"
+//    This is p0p1 cross p0p2.
+extern inline coordinate_type_fp is_left(point_type_fp p0, point_type_fp p1, point_type_fp p2) {
+  return ((p1.x() - p0.x()) * (p2.y() - p0.y()) -
+          (p2.x() - p0.x()) * (p1.y() - p0.y()));
+}
+
+// Is x between a and b, where a can be lesser or greater than b.  If
+// x == a or x == b, also returns true. */
+extern inline coordinate_type_fp is_between(coordinate_type_fp a,
+                                            coordinate_type_fp x,
+                                            coordinate_type_fp b) {
+  return x == a || x == b || (a-x>0) == (x-b>0);
+}
+
+// https://stackoverflow.com/questions/563198/how-do-you-detect-where-two-line-segments-intersect
+extern inline bool is_intersecting(const point_type_fp& p0, const point_type_fp& p1,
+                                   const point_type_fp& p2, const point_type_fp& p3) {
+  const coordinate_type_fp left012 = is_left(p0, p1, p2);
+  const coordinate_type_fp left013 = is_left(p0, p1, p3);
+  const coordinate_type_fp left230 = is_left(p2, p3, p0);
+  const coordinate_type_fp left231 = is_left(p2, p3, p1);
+
+  if (p0 != p1) {
+    if (left012 == 0) {
+      if (is_between(p0.x(), p2.x(), p1.x()) &&
+          is_between(p0.y(), p2.y(), p1.y())) {
+        return true; // p2 is on the line p0 to p1
+      }
+    }
+    if (left013 == 0) {
+      if (is_between(p0.x(), p3.x(), p1.x()) &&
+          is_between(p0.y(), p3.y(), p1.y())) {
+        return true; // p3 is on the line p0 to p1
+      }
     }
-    positive_slope_ = first_.y() < second_.y();
   }
-  inline const point_type_fp& first() const { return first_; }
-  inline const point_type_fp& second() const { return second_; }
-  inline coordinate_type_fp min_x() const { return first_.x(); }
-  inline coordinate_type_fp max_x() const { return second_.x(); }
-  inline coordinate_type_fp min_y() const { return positive_slope_ ? first_.y() : second_.y(); }
-  inline coordinate_type_fp max_y() const { return positive_slope_ ? second_.y() : first_.y(); }
- private:
-  point_type_fp first_;
-  point_type_fp second_;
-  bool positive_slope_;
-};
+  if (p2 != p3) {
+    if (left230 == 0) {
+      if (is_between(p2.x(), p0.x(), p3.x()) &&
+          is_between(p2.y(), p0.y(), p3.y())) {
+        return true; // p0 is on the line p2 to p3
+      }
+    }
+    if (left231 == 0) {
+      if (is_between(p2.x(), p1.x(), p3.x()) &&
+          is_between(p2.y(), p1.y(), p3.y())) {
+        return true; // p1 is on the line p2 to p3
+      }
+    }
+  }
+  if ((left012 > 0) == (left013 > 0) ||
+      (left230 > 0) == (left231 > 0)) {
+    if (p1 == p2) {
+      return true;
+    }
+    return false;
+  } else {
+    return true;
+  }
+}
 
-struct Node {
-  Node(coordinate_type_fp intercept,
-       smart_ptr::value_ptr<Node> in,
-       smart_ptr::value_ptr<Node> out) :
-    intercept(intercept),
-    in(std::move(in)),
-    out(std::move(out)) {}
-  Node(segment_t segment) :
-    segment(segment) {}
-  const coordinate_type_fp intercept = 0; // Where it crosses the axis.
-  const smart_ptr::value_ptr<Node> in; // Edges that match the criteria above.
-  const smart_ptr::value_ptr<Node> out; // Edges that don't match the criteria above.
-  const boost::optional<segment_t> segment; // The segment at this node (leaves only).
+// Up to four segments, stored by coordinate so that they can all be
+// tested against a segment at once.  Unused slots repeat a segment.
+struct SegmentBlock {
+  static constexpr size_t size = 4;
+  coordinate_type_fp x0[size];
+  coordinate_type_fp y0[size];
+  coordinate_type_fp x1[size];
+  coordinate_type_fp y1[size];
 };
 
+// Returns true if is_intersecting would be true for the segment from
+// p0 to p1 and any of the segments in the block.  Uses SIMD if the
+// processor has it.
+bool intersects_block(const point_type_fp& p0, const point_type_fp& p1,
+                      const SegmentBlock& block);
+// The same but never uses SIMD.
+bool intersects_block_portable(const point_type_fp& p0, const point_type_fp& p1,
+                               const SegmentBlock& block);
+
 class SegmentTree {
  public:
   SegmentTree(const SegmentTree&) = delete;
@@ -67,8 +112,29 @@ class SegmentTree {
   SegmentTree(const std::vector<std::pair<point_type_fp, point_type_fp>>& segments = {});
   void print();
   bool intersects(const point_type_fp& p0, const point_type_fp& p1) const;
+  // The same as calling intersects on each of the segments.
+  std::vector<bool> intersects(const std::vector<std::pair<point_type_fp, point_type_fp>>& segments) const;
+
+  struct Box {
+    coordinate_type_fp min_x;
+    coordinate_type_fp min_y;
+    coordinate_type_fp max_x;
+    coordinate_type_fp max_y;
+  };
+  // For an inner node, the children are at first and first+1 in the
+  // nodes and count is 0.  For a leaf, first is the index of its block
+  // and count is the number of segments in it.
+  struct Link {
+    uint32_t first;
+    uint32_t count;
+  };
+
  private:
-  smart_ptr::value_ptr<Node> root;
+  // Indexed by node, breadth-first, so the root is 0.
+  std::vector<Box> boxes;
+  std::vector<Link> links;
+  // One for each leaf.
+  std::vector<SegmentBlock> blocks;
 };
 
 } //namespace segment_tree
@@ -1,6 +1,9 @@
 #define BOOST_TEST_MODULE segment tree tests
 #include <boost/test/unit_test.hpp>
 
+#include <cmath>
+#include <random>
+
 #include "segment_tree.hpp"
 
 using namespace std;
@@ -18,4 +21,109 @@ BOOST_AUTO_TEST_CASE(make_node) {
   auto tree = SegmentTree(segments);
   tree.print();
 }
+
+BOOST_AUTO_TEST_CASE(empty) {
+  auto tree = SegmentTree();
+  BOOST_CHECK(!tree.intersects({0,0}, {1,1}));
+}
+
+BOOST_AUTO_TEST_CASE(touching) {
+  auto tree = SegmentTree({{{0,0}, {10,0}}, {{20,0}, {20,10}}});
+  BOOST_CHECK(tree.intersects({5,0}, {5,5}));
+  BOOST_CHECK(tree.intersects({10,0}, {15,5}));
+  BOOST_CHECK(tree.intersects({15,5}, {20,5}));
+  BOOST_CHECK(!tree.intersects({11,0}, {19,0}));
+  BOOST_CHECK(!tree.intersects({5,1}, {15,1}));
+}
+
+// Many segments, so that there are many levels, must give the same
+// answers as checking every segment.
+BOOST_AUTO_TEST_CASE(same_as_checking_all) {
+  std::mt19937 generator(0);
+  std::uniform_real_distribution<double> position(0, 100);
+  std::uniform_real_distribution<double> offset(-3, 3);
+  vector<std::pair<point_type_fp, point_type_fp>> segments;
+  for (size_t i = 0; i < 1000; i++) {
+    const point_type_fp p(position(generator), position(generator));
+    segments.emplace_back(p, point_type_fp(p.x() + offset(generator), p.y() + offset(generator)));
+  }
+  // Some that share ends and some that are just points.
+  segments.emplace_back(segments[0].second, point_type_fp(50, 50));
+  segments.emplace_back(point_type_fp(25, 75), point_type_fp(25, 75));
+  auto tree = SegmentTree(segments);
+  size_t hits = 0;
+  vector<std::pair<point_type_fp, point_type_fp>> queries;
+  vector<bool> expected_all;
+  for (size_t i = 0; i < 1000; i++) {
+    const point_type_fp p(position(generator), position(generator));
+    const point_type_fp q(p.x() + offset(generator) * 3, p.y() + offset(generator) * 3);
+    bool expected = false;
+    for (const auto& segment : segments) {
+      expected = expected || SegmentTree({segment}).intersects(p, q);
+    }
+    BOOST_CHECK_EQUAL(tree.intersects(p, q), expected);
+    BOOST_CHECK_EQUAL(tree.intersects(q, p), expected);
+    queries.emplace_back(p, q);
+    expected_all.push_back(expected);
+    hits += expected;
+  }
+  BOOST_CHECK(tree.intersects(queries) == expected_all);
+  // Make sure that both answers were tested.
+  BOOST_CHECK_GT(hits, 0);
+  BOOST_CHECK_LT(hits, 1000);
+}
+
+// The SIMD check of a block must agree with is_intersecting, even
+// when the segments are collinear, touch or are just points.  Small
+// integer coordinates make those cases common.
+BOOST_AUTO_TEST_CASE(block_same_as_is_intersecting) {
+  std::mt19937 generator(0);
+  std::uniform_int_distribution<int> small(0, 4);
+  std::uniform_real_distribution<double> position(0, 10);
+  for (bool integers : {true, false}) {
+    auto random_point = [&]() {
+      return integers ?
+          point_type_fp(small(generator), small(generator)) :
+          point_type_fp(position(generator), position(generator));
+    };
+    for (size_t i = 0; i < 20000; i++) {
+      SegmentBlock block;
+      for (size_t j = 0; j < SegmentBlock::size; j++) {
+        const auto p = random_point();
+        const auto q = random_point();
+        block.x0[j] = p.x();
+        block.y0[j] = p.y();
+        block.x1[j] = q.x();
+        block.y1[j] = q.y();
+      }
+      const auto p = random_point();
+      const auto q = random_point();
+      bool expected = false;
+      for (size_t j = 0; j < SegmentBlock::size; j++) {
+        expected = expected || is_intersecting(p, q,
+                                               point_type_fp(block.x0[j], block.y0[j]),
+                                               point_type_fp(block.x1[j], block.y1[j]));
+      }
+      BOOST_CHECK_EQUAL(intersects_block(p, q, block), expected);
+      BOOST_CHECK_EQUAL(intersects_block_portable(p, q, block), expected);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(block_nearly_collinear) {
+  // The ends of the query are so close to the line of the segment
+  // that only the exact check can tell which side they are on.
+  SegmentBlock block;
+  for (size_t j = 0; j < SegmentBlock::size; j++) {
+    block.x0[j] = 0.1;
+    block.y0[j] = 0.1;
+    block.x1[j] = 0.7;
+    block.y1[j] = 0.7;
+  }
+  const point_type_fp p(0.3, 0.3);
+  const point_type_fp q(0.5, std::nextafter(0.5, 1.0));
+  const bool expected = is_intersecting(p, q, {0.1, 0.1}, {0.7, 0.7});
+  BOOST_CHECK_EQUAL(intersects_block(p, q, block), expected);
+  BOOST_CHECK_EQUAL(intersects_block(q, p, block), is_intersecting(q, p, {0.1, 0.1}, {0.7, 0.7}));
+}
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,70 @@
+#ifndef SHARDED_MEMO_HPP
+#define SHARDED_MEMO_HPP
+
+#include <array>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+// A memo that many threads can fill and read at once.  The entries
+// are spread over shards, each with its own lock, so threads rarely
+// wait for each other.  Entries are never changed or removed once
+// they are added so references to them stay valid.
+namespace sharded_memo {
+
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class ShardedMemo {
+ public:
+  ShardedMemo() = default;
+  // Only for moving a memo that no other thread is using.
+  ShardedMemo(ShardedMemo&& other) {
+    for (size_t i = 0; i < shard_count; i++) {
+      shards[i].values = std::move(other.shards[i].values);
+    }
+  }
+  ShardedMemo& operator=(ShardedMemo&& other) {
+    for (size_t i = 0; i < shard_count; i++) {
+      shards[i].values = std::move(other.shards[i].values);
+    }
+    return *this;
+  }
+
+  // Returns the value stored for key.  If there is none, compute()
+  // is called to make it.  compute() is called without holding a lock
+  // so it may use the memo, too.  If two threads compute the same key
+  // at once, the first to finish wins and both get its value.
+  template <typename Compute>
+  const Value& get(const Key& key, const Compute& compute) const {
+    Shard& shard = shard_for(key);
+    {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      auto found = shard.values.find(key);
+      if (found != shard.values.cend()) {
+        return found->second;
+      }
+    }
+    Value value = compute();
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.values.emplace(key, std::move(value)).first->second;
+  }
+
+ private:
+  static constexpr size_t shard_count = 64;
+  struct Shard {
+    std::mutex mutex;
+    std::unordered_map<Key, Value, Hash> values;
+  };
+
+  Shard& shard_for(const Key& key) const {
+    // Use the high bits of the hash because the map uses the low ones.
+    const size_t hash = Hash()(key) * size_t(0x9E3779B97F4A7C15ULL);
+    return shards[(hash >> (sizeof(size_t) * 8 - 6)) % shard_count];
+  }
+
+  mutable std::array<Shard, shard_count> shards;
+};
+
+} // namespace sharded_memo
+
+#endif // SHARDED_MEMO_HPP
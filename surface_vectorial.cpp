@@ -39,6 +39,8 @@ using std::unique_ptr;
 using std::vector;
 
 #include <algorithm>
+#include <iterator>
+#include <numeric>
 #include <iostream>
 #include <cmath>
 using std::cerr;
@@ -56,6 +58,8 @@ using std::get;
 using std::map;
 
 #include <boost/format.hpp>
+#include <boost/geometry/index/rtree.hpp>
+namespace bgi = boost::geometry::index;
 #include <boost/optional.hpp>
 using boost::optional;
 using boost::make_optional;
@@ -73,6 +77,11 @@ using boost::make_optional;
 #include "trim_paths.hpp"
 #include "svg_writer.hpp"
 #include "disjoint_set.hpp"
+#include "validity.hpp"
+#include "milled_regions.hpp"
+#include "thread_pool.hpp"
+#include "clearance.hpp"
+#include "endpoint_index.hpp"
 
 using std::max;
 using std::max_element;
@@ -81,12 +90,13 @@ using std::dynamic_pointer_cast;
 
 unsigned int Surface_vectorial::debug_image_index = 0;
 
-Surface_vectorial::Surface_vectorial(unsigned int points_per_circle,
+Surface_vectorial::Surface_vectorial(const tessellation::Tessellation& circle_points,
                                      const box_type_fp& bounding_box,
                                      string name, string outputdir,
                                      bool tsp_2opt, MillFeedDirection::MillFeedDirection mill_feed_direction,
-                                     bool invert_gerbers, bool render_paths_to_shapes) :
-    points_per_circle(points_per_circle),
+                                     bool invert_gerbers, bool render_paths_to_shapes,
+                                     DebugImages::DebugImages debug_images) :
+    circle_points(circle_points),
     bounding_box(bounding_box),
     name(name),
     outputdir(outputdir),
@@ -94,16 +104,51 @@ Surface_vectorial::Surface_vectorial(unsigned int points_per_circle,
     fill(false),
     mill_feed_direction(mill_feed_direction),
     invert_gerbers(invert_gerbers),
-    render_paths_to_shapes(render_paths_to_shapes) {}
+    render_paths_to_shapes(render_paths_to_shapes),
+    debug_images(debug_images) {}
+
+// Discards the shapes and paths that are entirely outside of the box.
+// Those that cross the box are left for the mask to trim exactly so
+// that the toolpaths on the board don't change.
+void crop_to_box(const box_type_fp& box,
+                 pair<multi_polygon_type_fp, map<coordinate_type_fp, multi_linestring_type_fp>>& surface) {
+  auto& shapes = surface.first;
+  shapes.erase(std::remove_if(shapes.begin(), shapes.end(),
+                              [&](const polygon_type_fp& poly) {
+                                return bg::disjoint(bg::return_envelope<box_type_fp>(poly), box);
+                              }),
+               shapes.end());
+  for (auto& diameter_and_path : surface.second) {
+    auto& paths = diameter_and_path.second;
+    paths.erase(std::remove_if(paths.begin(), paths.end(),
+                               [&](const linestring_type_fp& ls) {
+                                 return bg::disjoint(bg::return_envelope<box_type_fp>(ls), box);
+                               }),
+                paths.end());
+  }
+}
+
+void Surface_vectorial::render(shared_ptr<GerberImporter> importer, double tolerance,
+                               bool check_self_intersections, const optional<box_type_fp>& crop) {
+  auto vectorial_surface_not_simplified = importer->render(fill, render_paths_to_shapes, circle_points);
 
-void Surface_vectorial::render(shared_ptr<GerberImporter> importer, double tolerance) {
-  auto vectorial_surface_not_simplified = importer->render(fill, render_paths_to_shapes, points_per_circle);
+  if (crop) {
+    crop_to_box(*crop, vectorial_surface_not_simplified);
+  }
 
-  if (bg::intersects(vectorial_surface_not_simplified.first)) {
-    cerr << "\nWarning: Geometry of layer '" << name << "' is"
-        " self-intersecting. This can cause pcb2gcode to produce"
-        " wildly incorrect toolpaths. You may want to check the"
-        " g-code output and/or fix your gerber files!\n";
+  if (check_self_intersections) {
+    const auto self_intersections = validity::self_intersections(vectorial_surface_not_simplified.first);
+    if (!self_intersections.empty()) {
+      const auto& first = self_intersections.front();
+      // Layers are rendered in parallel so write the whole warning at once.
+      cerr << str(boost::format(
+          "\nWarning: Geometry of layer '%s' is self-intersecting in %d"
+          " polygon(s), the first is polygon %d at (%.4f, %.4f). This can"
+          " cause pcb2gcode to produce wildly incorrect toolpaths. You may"
+          " want to check the g-code output and/or fix your gerber files!\n")
+          % name % self_intersections.size() % first.polygon
+          % first.location.x() % first.location.y());
+    }
   }
 
   vectorial_surface = make_shared<
@@ -180,64 +225,125 @@ vector<polygon_type_fp> find_thermal_reliefs(const multi_polygon_type_fp& millin
 
 void Surface_vectorial::write_svgs(const std::string& tool_suffix, coordinate_type_fp tool_diameter,
                 const multi_linestring_type_fp& toolpaths,
-                coordinate_type_fp tolerance, bool find_contentions) const {
+                const shared_ptr<Isolator>& contentions_isolator, bool basic) const {
   vector<vector<pair<linestring_type_fp, bool>>> new_trace_toolpaths;
   new_trace_toolpaths.emplace({});
   for (const auto& ls : toolpaths) {
     new_trace_toolpaths.front().push_back(make_pair(ls, true));
   }
-  write_svgs(tool_suffix, tool_diameter, new_trace_toolpaths, tolerance, find_contentions);
+  write_svgs(tool_suffix, tool_diameter, new_trace_toolpaths, contentions_isolator, basic);
 }
 
-void Surface_vectorial::write_svgs(const string& tool_suffix, coordinate_type_fp tool_diameter,
-                                   const vector<vector<pair<linestring_type_fp, bool>>>& new_trace_toolpaths,
-                                   coordinate_type_fp tolerance, bool find_contentions) const {
-  // Now set up the debug images, one per tool.
-  svg_writer debug_image(build_filename(outputdir, "processed_" + name + tool_suffix + ".svg"), bounding_box);
-  svg_writer traced_debug_image(build_filename(outputdir, "traced_" + name + tool_suffix + ".svg"), bounding_box);
-  optional<svg_writer> contentions_image;
-  srand(1);
-  debug_image.add(voronoi, 0.2, false);
-  srand(1);
+vector<multi_linestring_type_fp> Surface_vectorial::find_contentions(
+    const string& tool_suffix, coordinate_type_fp tool_diameter,
+    const vector<vector<pair<linestring_type_fp, bool>>>& new_trace_toolpaths,
+    const Isolator& isolator, bool write_images) const {
   const auto trace_count = new_trace_toolpaths.size();
-  for (size_t trace_index = 0; trace_index < trace_count; trace_index++) {
-    const auto& new_trace_toolpath = new_trace_toolpaths[trace_index];
-    const unsigned int r = rand() % 256;
-    const unsigned int g = rand() % 256;
-    const unsigned int b = rand() % 256;
-    for (const auto& ls_and_allow_reversal : new_trace_toolpath) {
-      debug_image.add(ls_and_allow_reversal.first, tool_diameter, r, g, b);
-      traced_debug_image.add(ls_and_allow_reversal.first, tool_diameter, r, g, b);
+  const coordinate_type_fp required = tool_diameter/2 - isolator.tolerance;
+  const clearance::ClearanceChecker checker(vectorial_surface->first);
+  vector<vector<clearance::Violation>> violations(trace_count);
+  vector<multi_linestring_type_fp> contentions(trace_count);
+  thread_pool::parallel_for(trace_count, [&](size_t trace_index) {
+    multi_linestring_type_fp paths;
+    paths.reserve(new_trace_toolpaths[trace_index].size());
+    for (const auto& ls_and_allow_reversal : new_trace_toolpaths[trace_index]) {
+      paths.push_back(ls_and_allow_reversal.first);
     }
-
-    if (find_contentions) {
-      if (trace_index < vectorial_surface->first.size()) {
-        multi_polygon_type_fp temp =
-            bg_helpers::buffer(vectorial_surface->first.at(trace_index), tool_diameter/2 - tolerance);
-        multi_linestring_type_fp temp2;
-        for (const auto& ls_and_allow_reversal : new_trace_toolpath) {
-          temp2.push_back(ls_and_allow_reversal.first);
-        }
-        temp2 = temp2 & temp;
-        if (bg::length(temp2) > 0) {
-          if (!contentions_image) {
-            contentions_image.emplace(build_filename(outputdir, "contentions_" + name + tool_suffix + ".svg"), bounding_box);
-          }
-          contentions_image->add(temp2, tool_diameter, 255, 0, 0);
-        }
+    // The toolpaths are made with buffers that approximate arcs with
+    // chords so they may cut into the clearance by the sagitta.
+    violations[trace_index] = checker.check(
+        trace_index, paths, required,
+        required * (1 - std::cos(M_PI / bg_helpers::points_per_circle)));
+    if (violations[trace_index].empty() || !write_images) {
+      return;
+    }
+    // Only the traces with violations are buffered, for drawing.
+    multi_polygon_type_fp temp =
+        bg_helpers::buffer(vectorial_surface->first.at(trace_index), required);
+    paths = paths & temp;
+    if (bg::length(paths) > 0) {
+      contentions[trace_index] = paths;
+    }
+  });
+  size_t violation_count = 0;
+  for (const auto& trace_violations : violations) {
+    violation_count += trace_violations.size();
+  }
+  if (isolator.contentions_report) {
+    std::ofstream report(build_filename(outputdir, "contentions_" + name + tool_suffix + ".csv"));
+    report << "trace,x,y,required,actual\n";
+    for (size_t trace_index = 0; trace_index < trace_count; trace_index++) {
+      for (const auto& violation : violations[trace_index]) {
+        report << str(boost::format("%d,%.6f,%.6f,%.6f,%.6f\n") % trace_index %
+                      violation.location.x() % violation.location.y() %
+                      violation.required % violation.actual);
       }
     }
   }
-  if (contentions_image) {
-    cerr << "\nWarning: pcb2gcode hasn't been able to fulfill all"
-        " clearance requirements.  Check the contentions output"
-        " and consider using a smaller milling bit.\n";
+  if (violation_count > 0) {
+    cerr << str(boost::format(
+        "\nWarning: pcb2gcode hasn't been able to fulfill all"
+        " clearance requirements in %d place(s).  %s"
+        " and consider using a smaller milling bit.\n") %
+        violation_count %
+        (write_images ? "Check the contentions output" : "Use --debug-images to see the contentions"));
   }
-  srand(1);
-  debug_image.add(vectorial_surface->first, 1, true);
-  for (const auto& diameter_and_path : vectorial_surface->second) {
-    debug_image.add(diameter_and_path.second, diameter_and_path.first, true);
+  return contentions;
+}
+
+void Surface_vectorial::write_svgs(const string& tool_suffix, coordinate_type_fp tool_diameter,
+                                   const vector<vector<pair<linestring_type_fp, bool>>>& new_trace_toolpaths,
+                                   const shared_ptr<Isolator>& contentions_isolator, bool basic) const {
+  const bool write_images = debug_images == DebugImages::FULL || (debug_images == DebugImages::BASIC && basic);
+  // Without images, the contentions are still worth a warning.  The
+  // toolpaths before they are joined are checked because they are
+  // still sorted by trace.
+  const bool check_contentions = contentions_isolator && (write_images || !basic);
+  vector<multi_linestring_type_fp> contentions(new_trace_toolpaths.size());
+  if (check_contentions) {
+    contentions = find_contentions(tool_suffix, tool_diameter, new_trace_toolpaths,
+                                   *contentions_isolator, write_images);
+  }
+  if (!write_images) {
+    return;
   }
+
+  // Now set up the debug images, one per tool.  Everything that they
+  // need is copied because they are drawn later.
+  const string processed_filename = build_filename(outputdir, "processed_" + name + tool_suffix + ".svg");
+  const string traced_filename = build_filename(outputdir, "traced_" + name + tool_suffix + ".svg");
+  const string contentions_filename = build_filename(outputdir, "contentions_" + name + tool_suffix + ".svg");
+  write_svg_in_background(
+      [processed_filename, traced_filename, contentions_filename, tool_diameter,
+       bounding_box = bounding_box, voronoi = voronoi, new_trace_toolpaths, contentions,
+       surface = *vectorial_surface]() {
+        svg_writer debug_image(processed_filename, bounding_box);
+        svg_writer traced_debug_image(traced_filename, bounding_box);
+        optional<svg_writer> contentions_image;
+        srand(1);
+        debug_image.add(voronoi, 0.2, false);
+        srand(1);
+        for (size_t trace_index = 0; trace_index < new_trace_toolpaths.size(); trace_index++) {
+          const unsigned int r = rand() % 256;
+          const unsigned int g = rand() % 256;
+          const unsigned int b = rand() % 256;
+          for (const auto& ls_and_allow_reversal : new_trace_toolpaths[trace_index]) {
+            debug_image.add(ls_and_allow_reversal.first, tool_diameter, r, g, b);
+            traced_debug_image.add(ls_and_allow_reversal.first, tool_diameter, r, g, b);
+          }
+          if (!contentions[trace_index].empty()) {
+            if (!contentions_image) {
+              contentions_image.emplace(contentions_filename, bounding_box);
+            }
+            contentions_image->add(contentions[trace_index], tool_diameter, 255, 0, 0);
+          }
+        }
+        srand(1);
+        debug_image.add(surface.first, 1, true);
+        for (const auto& diameter_and_path : surface.second) {
+          debug_image.add(diameter_and_path.second, diameter_and_path.first, true);
+        }
+      });
 }
 
 vector<pair<linestring_type_fp, bool>> full_eulerian_paths(
@@ -483,23 +589,42 @@ bool attach_ls(const linestring_type_fp& ls,
   return true;
 }
 
+// Attach the ls to the first of the toolpaths that it can connect to.
+// toolpath_ends must have the ends of the toolpaths and is kept up to
+// date.  max_reach is the furthest that path_finder might connect two
+// points, infinite if unknown and negative if it never connects.
+// Toolpaths without an end in reach are skipped without trying them.
 void attach_ls(const linestring_type_fp& ls,
                vector<pair<linestring_type_fp, bool>>& toolpaths,
+               endpoint_index::EndpointIndex& toolpath_ends,
                const MillFeedDirection::MillFeedDirection& dir,
-               const Surface_vectorial::PathFinder& path_finder) {
-  if (bg::equals(ls.front(), ls.back())) {
-    // This path is actually a ring so we can use attach_ring which can connect
-    // at any point.
-    for (auto& toolpath : toolpaths) {
-      if (attach_ring(ls, toolpath, dir, path_finder)) {
-        return;
-      }
+               const Surface_vectorial::PathFinder& path_finder,
+               coordinate_type_fp max_reach) {
+  const bool is_ring = bg::equals(ls.front(), ls.back());
+  vector<size_t> candidates;
+  if (std::isinf(max_reach)) {
+    candidates.resize(toolpaths.size());
+    std::iota(candidates.begin(), candidates.end(), 0);
+  } else if (max_reach >= 0) {
+    if (is_ring) {
+      // A ring can connect at any of its points.
+      candidates = toolpath_ends.near(bg::return_envelope<box_type_fp>(ls), max_reach);
+    } else {
+      const auto near_front = toolpath_ends.near(box_type_fp(ls.front(), ls.front()), max_reach);
+      const auto near_back = toolpath_ends.near(box_type_fp(ls.back(), ls.back()), max_reach);
+      std::set_union(near_front.cbegin(), near_front.cend(),
+                     near_back.cbegin(), near_back.cend(),
+                     std::back_inserter(candidates));
     }
-  } else {
-    for (auto& toolpath : toolpaths) {
-      if (attach_ls(ls, toolpath, dir, path_finder)) {
-        return; // Done, we were able to attach to an existing toolpath.
-      }
+  }
+  for (const auto& index : candidates) {
+    auto& toolpath = toolpaths[index];
+    // A ring can use attach_ring which can connect at any point.
+    if (is_ring ?
+        attach_ring(ls, toolpath, dir, path_finder) :
+        attach_ls(ls, toolpath, dir, path_finder)) {
+      toolpath_ends.update(index, toolpath.first);
+      return; // Done, we were able to attach to an existing toolpath.
     }
   }
   // If we've reached here, there was no way to attach at all so make a new path.
@@ -510,17 +635,22 @@ void attach_ls(const linestring_type_fp& ls,
   } else {
     toolpaths.push_back(make_pair(linestring_type_fp(ls.cbegin(), ls.cend()), true)); // true for reversible
   }
+  toolpath_ends.add(toolpaths.back().first);
 }
 
 void attach_mls(const multi_linestring_type_fp& mls,
                 vector<pair<linestring_type_fp, bool>>& toolpaths,
+                endpoint_index::EndpointIndex& toolpath_ends,
                 const MillFeedDirection::MillFeedDirection& dir,
-                const multi_polygon_type_fp& already_milled_shrunk,
-                const Surface_vectorial::PathFinder& path_finder) {
-  auto mls_masked = mls - already_milled_shrunk;  // This might chop the single path into many paths.
+                const milled_regions::MilledRegions& already_milled_shrunk,
+                const Surface_vectorial::PathFinder& path_finder,
+                coordinate_type_fp max_reach) {
+  // This might chop the single path into many paths.  Only the milled area
+  // near the path can cut it.
+  auto mls_masked = mls - already_milled_shrunk.near(bg::return_envelope<box_type_fp>(mls));
   mls_masked = eulerian_paths::make_eulerian_paths(mls_masked, dir == MillFeedDirection::ANY, false); // Rejoin those paths as possible.
   for (const auto& ls : mls_masked) { // Maybe more than one if the masking cut one into parts.
-    attach_ls(ls, toolpaths, dir, path_finder);
+    attach_ls(ls, toolpaths, toolpath_ends, dir, path_finder, max_reach);
   }
 }
 
@@ -654,9 +784,11 @@ static void add_spikes(ring_type_fp& ring, coordinate_type_fp offset,
 // to the list of toolpaths.  offset is the tool diameter minus the overlap requested.
 void attach_ring(const ring_type_fp& ring,
                  vector<pair<linestring_type_fp, bool>>& toolpaths,
+                 endpoint_index::EndpointIndex& toolpath_ends,
                  const MillFeedDirection::MillFeedDirection& dir,
-                 const multi_polygon_type_fp& already_milled_shrunk,
+                 const milled_regions::MilledRegions& already_milled_shrunk,
                  const Surface_vectorial::PathFinder& path_finder,
+                 coordinate_type_fp max_reach,
                  const coordinate_type_fp spike_offset,
                  const bool reverse_spikes,
                  const coordinate_type_fp tolerance,
@@ -666,7 +798,7 @@ void attach_ring(const ring_type_fp& ring,
   add_spikes(ring_copy, spike_offset, reverse_spikes, tolerance, spikes_keep_in, spikes_keep_out);
   multi_linestring_type_fp ring_paths;
   ring_paths.push_back(linestring_type_fp(ring_copy.cbegin(), ring_copy.cend())); // Make a copy into an mls.
-  attach_mls(ring_paths, toolpaths, dir, already_milled_shrunk, path_finder);
+  attach_mls(ring_paths, toolpaths, toolpath_ends, dir, already_milled_shrunk, path_finder, max_reach);
 }
 
 // Given polygons, attach all the rings inside to the toolpaths.  path_finder is
@@ -674,9 +806,11 @@ void attach_ring(const ring_type_fp& ring,
 // possible, as in, not too long and doesn't cross any traces, etc.
 void attach_polygons(const multi_polygon_type_fp& polygons,
                      vector<pair<linestring_type_fp, bool>>& toolpaths,
+                     endpoint_index::EndpointIndex& toolpath_ends,
                      const MillFeedDirection::MillFeedDirection& dir,
-                     const multi_polygon_type_fp& already_milled_shrunk,
+                     const milled_regions::MilledRegions& already_milled_shrunk,
                      const Surface_vectorial::PathFinder& path_finder,
+                     coordinate_type_fp max_reach,
                      const coordinate_type_fp spike_offset,
                      const bool reverse_spikes,
                      const coordinate_type_fp tolerance,
@@ -685,8 +819,8 @@ void attach_polygons(const multi_polygon_type_fp& polygons,
   // Loop through the polygons by ring index because that will lead to better
   // connections between loops.
   for (const auto& poly : polygons) {
-    attach_ring(poly.outer(), toolpaths, dir, already_milled_shrunk,
-                path_finder, spike_offset, reverse_spikes, tolerance,
+    attach_ring(poly.outer(), toolpaths, toolpath_ends, dir, already_milled_shrunk,
+                path_finder, max_reach, spike_offset, reverse_spikes, tolerance,
                 spikes_keep_in, spikes_keep_out);
   }
   bool found_one = true;
@@ -695,62 +829,69 @@ void attach_polygons(const multi_polygon_type_fp& polygons,
     for (const auto& poly : polygons) {
       if (poly.inners().size() > i) {
         found_one = true;
-        attach_ring(poly.inners()[i], toolpaths, dir, already_milled_shrunk,
-                    path_finder, spike_offset, reverse_spikes, tolerance,
+        attach_ring(poly.inners()[i], toolpaths, toolpath_ends, dir, already_milled_shrunk,
+                    path_finder, max_reach, spike_offset, reverse_spikes, tolerance,
                     spikes_keep_in, spikes_keep_out);
       }
     }
   }
 }
 
+// The longest path that is worth milling to get from a to b instead of
+// retracting, moving fast and plunging.
+coordinate_type_fp Surface_vectorial::max_path_length(shared_ptr<RoutingMill> mill,
+                                                      const point_type_fp& a,
+                                                      const point_type_fp& b) const {
+  // Solve for distance:
+  // risetime at G0 + horizontal distance G0 + plunge G1 ==
+  // travel time at G1
+  // The horizontal G0 move is for the maximum of the X and Y coordinates.
+  // We'll assume that G0 Z is 50inches/minute and G0 X or Y is 100 in/min, taken from Nomad Carbide 883.
+  const auto vertical_distance = mill->zsafe - mill->zwork;
+  const auto max_manhattan = std::max(std::abs(a.x() - b.x()), std::abs(a.y() - b.y()));
+  const double horizontalG1speed = mill->feed;
+  const double vertG1speed = mill->vertfeed;
+  const double g0_time = vertical_distance/mill->g0_vertical_speed + max_manhattan/mill->g0_horizontal_speed + vertical_distance/vertG1speed;
+  // The time saved by milling would be g0_time - g1_distance/g1_horizontal_speed.
+  // The extra wear on the mill is g1_distance.
+  // Wear is limited by the backtrack value (in distance/time).
+  // g1_distance/time_saved < backtrack => g1_distance < backtrack/time_saved
+  return std::isinf(mill->backtrack) ?
+      g0_time * horizontalG1speed :
+      mill->backtrack*g0_time / (1 + mill->backtrack/horizontalG1speed);
+}
+
 Surface_vectorial::PathFinder Surface_vectorial::make_path_finder(
     shared_ptr<RoutingMill> mill,
     const path_finding::PathFindingSurface& path_finding_surface) const {
-  return [mill, &path_finding_surface](const point_type_fp& a, const point_type_fp& b) {
-           // Solve for distance:
-           // risetime at G0 + horizontal distance G0 + plunge G1 ==
-           // travel time at G1
-           // The horizontal G0 move is for the maximum of the X and Y coordinates.
-           const auto vertical_distance = mill->zsafe - mill->zwork;
-           const auto max_manhattan = std::max(std::abs(a.x() - b.x()), std::abs(a.y() - b.y()));
-           const double horizontalG1speed = mill->feed;
-           const double vertG1speed = mill->vertfeed;
-           const double g0_time = vertical_distance/mill->g0_vertical_speed + max_manhattan/mill->g0_horizontal_speed + vertical_distance/vertG1speed;
-           // The time saved by milling would be g0_time - g1_distance/g1_horizontal_speed.
-           // The extra wear on the mill is g1_distance.
-           // Wear is limited by the backtrack value (in distance/time).
-           // g1_distance/time_saved < backtrack => g1_distance < backtrack/time_saved
-           const double max_g1_distance = std::isinf(mill->backtrack) ?
-               g0_time * horizontalG1speed :
-               mill->backtrack*g0_time / (1 + mill->backtrack/horizontalG1speed);
-           return path_finding_surface.find_path(a, b, max_g1_distance, make_optional(mill->path_finding_limit));
+  return [this, mill, &path_finding_surface](const point_type_fp& a, const point_type_fp& b) {
+           return path_finding_surface.find_path(a, b, max_path_length(mill, a, b),
+                                                 make_optional(mill->path_finding_limit));
          };
 }
 
-Surface_vectorial::PathFinderRingIndices Surface_vectorial::make_path_finder_ring_indices(
-    shared_ptr<RoutingMill> mill,
-    const path_finding::PathFindingSurface& path_finding_surface) const {
-  return [mill, &path_finding_surface](const point_type_fp& a, const point_type_fp& b,
-                                       path_finding::SearchKey search_key) {
-           // Solve for distance:
-           // risetime at G0 + horizontal distance G0 + plunge G1 ==
-           // travel time at G1
-           // The horizontal G0 move is for the maximum of the X and Y coordinates.
-           // We'll assume that G0 Z is 50inches/minute and G0 X or Y is 100 in/min, taken from Nomad Carbide 883.
-           const auto vertical_distance = mill->zsafe - mill->zwork;
-           const auto max_manhattan = std::max(std::abs(a.x() - b.x()), std::abs(a.y() - b.y()));
-           const double horizontalG1speed = mill->feed;
-           const double vertG1speed = mill->vertfeed;
-           const double g0_time = vertical_distance/mill->g0_vertical_speed + max_manhattan/mill->g0_horizontal_speed + vertical_distance/vertG1speed;
-           // The time saved by milling would be g0_time - g1_distance/g1_horizontal_speed.
-           // The extra wear on the mill is g1_distance.
-           // Wear is limited by the backtrack value (in distance/time).
-           // g1_distance/time_saved < backtrack => g1_distance < backtrack/time_saved
-           const double max_g1_distance = std::isinf(mill->backtrack) ?
-               g0_time * horizontalG1speed :
-               mill->backtrack*g0_time / (1 + mill->backtrack/horizontalG1speed);
-           return path_finding_surface.find_path(a, b, max_g1_distance, mill->path_finding_limit, search_key);
-         };
+// The path finders from above only connect points if the path is
+// shorter than the G1 distance that takes as long as a G0 move.  That
+// distance grows with the distance between the points but if it grows
+// more slowly, there is a distance past which nothing connects.
+coordinate_type_fp Surface_vectorial::path_finder_reach(shared_ptr<RoutingMill> mill) const {
+  const auto vertical_distance = mill->zsafe - mill->zwork;
+  const double horizontalG1speed = mill->feed;
+  const double vertG1speed = mill->vertfeed;
+  // max_path_length is g1_per_g0_time * g0_time and g0_time is
+  // fixed_g0_time plus max_manhattan/g0_horizontal_speed.
+  const double fixed_g0_time = vertical_distance/mill->g0_vertical_speed + vertical_distance/vertG1speed;
+  const double g1_per_g0_time = std::isinf(mill->backtrack) ?
+      horizontalG1speed :
+      mill->backtrack / (1 + mill->backtrack/horizontalG1speed);
+  // The path can be no shorter than the distance, which is no shorter
+  // than max_manhattan.
+  const double growth = g1_per_g0_time / mill->g0_horizontal_speed;
+  if (!(growth < 1)) {
+    return std::numeric_limits<coordinate_type_fp>::infinity();
+  }
+  // A little extra in case of rounding.
+  return g1_per_g0_time * fixed_g0_time / (1 - growth) * (1 + 1e-9) + 1e-12;
 }
 
 // Get all the toolpaths for a single milling bit for just one of the traces or
@@ -766,7 +907,7 @@ Surface_vectorial::PathFinderRingIndices Surface_vectorial::make_path_finder_rin
 vector<pair<linestring_type_fp, bool>> Surface_vectorial::get_single_toolpath(
     shared_ptr<RoutingMill> mill, const size_t trace_index, bool mirror, const double tool_diameter,
     const double overlap_width,
-    const multi_polygon_type_fp& already_milled_shrunk,
+    const milled_regions::MilledRegions& already_milled_shrunk,
     const path_finding::PathFindingSurface& path_finding_surface) const {
     // This is by how much we will grow each trace if extra passes are needed.
     coordinate_type_fp diameter = tool_diameter;
@@ -801,13 +942,15 @@ vector<pair<linestring_type_fp, bool>> Surface_vectorial::get_single_toolpath(
     const auto& current_voronoi = trace_index < voronoi.size() ? voronoi[trace_index] : thermal_holes[trace_index - voronoi.size()];
     const vector<multi_polygon_type_fp> polygons =
         offset_polygon(current_trace, current_voronoi,
-                       diameter, overlap, extra_passes + 1, do_voronoi, mill->offset);
+                       diameter, overlap, extra_passes + 1, do_voronoi, mill->offset,
+                       isolator ? isolator->incremental_offsets : false, mill->tolerance);
 
     // Find if a distance between two points should be milled or retract, move
     // fast, and plunge.  Milling is chosen if it's faster and also the path is
     // entirely within the path_finding_surface.  If it's not faster or the path
     // isn't possible, boost::none is returned.
     PathFinder path_finder = make_path_finder(mill, path_finding_surface);
+    const coordinate_type_fp max_reach = path_finder_reach(mill);
 
     // The rings of polygons are the paths to mill.  The paths may include both
     // inner and outer rings.  They vector has them sorted from the smallest
@@ -815,6 +958,7 @@ vector<pair<linestring_type_fp, bool>> Surface_vectorial::get_single_toolpath(
     // Each linestring has a bool attached to it indicating if it is reversible.
     // true means reversal is still allowed.
     vector<pair<linestring_type_fp, bool>> toolpath;
+    endpoint_index::EndpointIndex toolpath_ends;
     for (size_t polygon_index = 0; polygon_index < polygons.size(); polygon_index++) {
       const auto& polygon = polygons[polygon_index];
       MillFeedDirection::MillFeedDirection dir = mill_feed_direction;
@@ -864,8 +1008,8 @@ vector<pair<linestring_type_fp, bool>> Surface_vectorial::get_single_toolpath(
           }
         }
       }
-      attach_polygons(polygon, toolpath, dir, already_milled_shrunk, path_finder,
-                      spike_offset, reverse_spikes, mill->tolerance,
+      attach_polygons(polygon, toolpath, toolpath_ends, dir, already_milled_shrunk, path_finder,
+                      max_reach, spike_offset, reverse_spikes, mill->tolerance,
                       spikes_keep_in, spikes_keep_out);
     }
 
@@ -880,6 +1024,53 @@ vector<pair<linestring_type_fp, bool>> Surface_vectorial::final_path_finder(
     const std::shared_ptr<RoutingMill>& mill,
     const path_finding::PathFindingSurface& path_finding_surface,
     const vector<pair<linestring_type_fp, bool>>& paths) const {
+  // Connections between points that are further apart than this are
+  // never made.
+  const coordinate_type_fp max_reach = path_finder_reach(mill);
+  // Find the pairs of paths that might be connected.  Without a limit,
+  // that's all of them.  Otherwise, only look at the paths with an end
+  // in reach of an end of the path, and of those only the nearest few
+  // if there is a limit on candidates.
+  vector<pair<size_t, size_t>> path_pairs;
+  if (std::isinf(max_reach) && mill->path_finding_candidates == 0) {
+    for (size_t i = 0; i < paths.size(); i++) {
+      for (size_t j = i+1; j < paths.size(); j++) {
+        path_pairs.push_back({i, j});
+      }
+    }
+  } else {
+    typedef pair<point_type_fp, size_t> endpoint_t;
+    vector<endpoint_t> endpoints;
+    endpoints.reserve(paths.size() * 2);
+    for (size_t i = 0; i < paths.size(); i++) {
+      endpoints.push_back({paths[i].first.front(), i});
+      endpoints.push_back({paths[i].first.back(), i});
+    }
+    const bgi::rtree<endpoint_t, bgi::rstar<16>> endpoint_tree(endpoints);
+    for (const auto& endpoint : endpoints) {
+      const auto& p = endpoint.first;
+      vector<endpoint_t> found;
+      const box_type_fp in_reach(point_type_fp(p.x() - max_reach, p.y() - max_reach),
+                                 point_type_fp(p.x() + max_reach, p.y() + max_reach));
+      // The path's own ends are found, too.
+      const size_t k = mill->path_finding_candidates + 2;
+      if (mill->path_finding_candidates == 0) {
+        endpoint_tree.query(bgi::intersects(in_reach), std::back_inserter(found));
+      } else if (std::isinf(max_reach)) {
+        endpoint_tree.query(bgi::nearest(p, k), std::back_inserter(found));
+      } else {
+        endpoint_tree.query(bgi::intersects(in_reach) && bgi::nearest(p, k), std::back_inserter(found));
+      }
+      for (const auto& other : found) {
+        if (other.second != endpoint.second) {
+          path_pairs.push_back(std::minmax(endpoint.second, other.second));
+        }
+      }
+    }
+    std::sort(path_pairs.begin(), path_pairs.end());
+    path_pairs.erase(std::unique(path_pairs.begin(), path_pairs.end()), path_pairs.end());
+  }
+
   // Find all the connectable endpoints.  A connection can only be
   // made if the direction suits it.  connections is the list of
   // possible connections to make.  It is a tuple of (distance between
@@ -888,25 +1079,33 @@ vector<pair<linestring_type_fp, bool>> Surface_vectorial::final_path_finder(
   // adding the point.  We want to know it so that we don't make
   // connections between paths that are already connected.
   vector<tuple<coordinate_type_fp, point_type_fp, point_type_fp, size_t, size_t>> connections;
-  for (size_t i = 0; i < paths.size(); i++) {
+  auto add_connection = [&](coordinate_type_fp distance, const point_type_fp& start, const point_type_fp& end,
+                            size_t i, size_t j) {
+    // The path finder would fail so don't bother.
+    if (!std::isinf(max_reach) && bg::distance(start, end) >= max_reach) {
+      return;
+    }
+    connections.push_back({distance, start, end, i, j});
+  };
+  for (const auto& path_pair : path_pairs) {
+    const size_t i = path_pair.first;
+    const size_t j = path_pair.second;
     const auto& path1 = paths[i];
-    for (size_t j = i+1; j < paths.size(); j++) {
-      const auto& path2 = paths[j];
-      // We can always do these:
-      connections.push_back({bg::distance(path1.first.back(), path2.first.front()),
-                             path1.first.back(), path2.first.front(), i, j});
-      connections.push_back({bg::distance(path1.first.front(), path2.first.back()),
-                             path1.first.back(), path2.first.front(), i, j});
-      if (path1.second) {
-        // path1 is reversible so we can connect from the front of it.
-        connections.push_back({bg::distance(path1.first.front(), path2.first.front()),
-                               path1.first.front(), path2.first.front(), i, j});
-      }
-      if (path2.second) {
-        // path2 is reversible so we can connect from the front of it.
-        connections.push_back({bg::distance(path1.first.back(), path2.first.back()),
-                               path1.first.back(), path2.first.back(), i, j});
-      }
+    const auto& path2 = paths[j];
+    // We can always do these:
+    add_connection(bg::distance(path1.first.back(), path2.first.front()),
+                   path1.first.back(), path2.first.front(), i, j);
+    add_connection(bg::distance(path1.first.front(), path2.first.back()),
+                   path1.first.back(), path2.first.front(), i, j);
+    if (path1.second) {
+      // path1 is reversible so we can connect from the front of it.
+      add_connection(bg::distance(path1.first.front(), path2.first.front()),
+                     path1.first.front(), path2.first.front(), i, j);
+    }
+    if (path2.second) {
+      // path2 is reversible so we can connect from the front of it.
+      add_connection(bg::distance(path1.first.back(), path2.first.back()),
+                     path1.first.back(), path2.first.back(), i, j);
     }
   }
   // Sort so that the closest pairs are first.
@@ -925,32 +1124,105 @@ vector<pair<linestring_type_fp, bool>> Surface_vectorial::final_path_finder(
   }
 
   vector<pair<linestring_type_fp, bool>> new_paths;
-  PathFinderRingIndices path_finder = make_path_finder_ring_indices(mill, path_finding_surface);
   DisjointSet<size_t> joined_paths;
-  for (const auto& start_end : connections) {
-    const point_type_fp& start = get<1>(start_end);
-    const point_type_fp& end = get<2>(start_end);
-    size_t start_path = get<3>(start_end);
-    size_t end_path = get<4>(start_end);
-    const auto& start_ring_indices = points_to_poly_id.at(start);
-    const auto& end_ring_indices = points_to_poly_id.at(end);
-    if (!start_ring_indices ||
-        !end_ring_indices ||
-        *start_ring_indices != *end_ring_indices) {
-      continue;
+  // With shared_path_search, many connections start at the same point
+  // so each start point gets a search tree that grows as the
+  // connections from it are tried.  The tree is dropped after the last
+  // connection from its point.
+  unordered_map<point_type_fp, size_t> last_use;
+  for (size_t i = 0; i < connections.size(); i++) {
+    last_use[get<1>(connections[i])] = i;
+  }
+  unordered_map<point_type_fp, unique_ptr<path_finding::PathSearchTree>> search_trees;
+  // Whether or not a connection is needed depends on the connections
+  // made before it, so they are made in order.  The searches are the
+  // slow part so the next few needed connections are searched in
+  // parallel, or one thread for each start point if they share search
+  // trees.  Some of those might turn out not to be needed after all
+  // and their results are thrown away.
+  const size_t batch_size = thread_pool::get_jobs();
+  size_t next_connection = 0;
+  while (next_connection < connections.size()) {
+    vector<size_t> batch;
+    vector<vector<size_t>> batch_by_start;
+    unordered_map<point_type_fp, size_t> start_to_group;
+    for (; next_connection < connections.size() && batch.size() < batch_size; next_connection++) {
+      const auto& start_end = connections[next_connection];
+      const auto& start_ring_indices = points_to_poly_id.at(get<1>(start_end));
+      const auto& end_ring_indices = points_to_poly_id.at(get<2>(start_end));
+      if (!start_ring_indices ||
+          !end_ring_indices ||
+          *start_ring_indices != *end_ring_indices) {
+        continue;
+      }
+      if (joined_paths.find(get<3>(start_end)) == joined_paths.find(get<4>(start_end))) {
+        continue; // The two paths were already connected.
+      }
+      if (mill->shared_path_search) {
+        const auto& start = get<1>(start_end);
+        if (search_trees.count(start) == 0) {
+          search_trees.emplace(start, std::make_unique<path_finding::PathSearchTree>(
+              path_finding_surface, start, *start_ring_indices));
+        }
+        if (start_to_group.count(start) == 0) {
+          start_to_group.emplace(start, batch_by_start.size());
+          batch_by_start.emplace_back();
+        }
+        batch_by_start[start_to_group.at(start)].push_back(batch.size());
+      }
+      batch.push_back(next_connection);
     }
-    if (joined_paths.find(start_path) == joined_paths.find(end_path)) {
-      continue; // The two paths were already connected.
+    vector<optional<linestring_type_fp>> found_paths(batch.size());
+    if (mill->shared_path_search) {
+      thread_pool::parallel_for(batch_by_start.size(), [&](size_t group) {
+        for (const size_t i : batch_by_start[group]) {
+          const auto& start_end = connections[batch[i]];
+          const auto& start = get<1>(start_end);
+          const auto& end = get<2>(start_end);
+          found_paths[i] = search_trees.at(start)->find_path(
+              end, max_path_length(mill, start, end), mill->path_finding_limit);
+        }
+      });
+    } else {
+      found_paths = thread_pool::parallel_map(batch, [&](size_t connection_index) {
+        const auto& start_end = connections[connection_index];
+        const auto& start = get<1>(start_end);
+        const auto& end = get<2>(start_end);
+        return path_finding_surface.find_path(start, end, max_path_length(mill, start, end),
+                                              mill->path_finding_limit, *points_to_poly_id.at(start));
+      });
     }
-    boost::optional<linestring_type_fp> new_path = path_finder(start, end, *start_ring_indices);
-    if (new_path) {
-      new_paths.push_back({*new_path, true});
-      joined_paths.join(start_path, end_path);
+    for (size_t i = 0; i < batch.size(); i++) {
+      const auto& start_end = connections[batch[i]];
+      size_t start_path = get<3>(start_end);
+      size_t end_path = get<4>(start_end);
+      if (joined_paths.find(start_path) == joined_paths.find(end_path)) {
+        continue; // Connected by an earlier one in this batch.
+      }
+      if (found_paths[i]) {
+        new_paths.push_back({*found_paths[i], true});
+        joined_paths.join(start_path, end_path);
+      }
+    }
+    for (auto search_tree = search_trees.begin(); search_tree != search_trees.end();) {
+      if (last_use.at(search_tree->first) < next_connection) {
+        search_tree = search_trees.erase(search_tree);
+      } else {
+        search_tree++;
+      }
     }
   }
   return new_paths;
 }
 
+static path_finding::SearchOptions search_options(const shared_ptr<RoutingMill>& mill) {
+  path_finding::SearchOptions options;
+  options.visibility_graph = mill->path_finding_visibility_graph;
+  options.bidirectional = mill->path_finding_bidirectional;
+  options.landmark_count = mill->path_finding_landmarks;
+  return options;
+}
+
 // A bunch of pairs.  Each pair is the tool diameter followed by a vector of paths to mill.
 vector<pair<coordinate_type_fp, multi_linestring_type_fp>> Surface_vectorial::get_toolpath(
     shared_ptr<RoutingMill> mill, bool mirror, bool ymirror) {
@@ -974,21 +1246,23 @@ vector<pair<coordinate_type_fp, multi_linestring_type_fp>> Surface_vectorial::ge
     vector<pair<coordinate_type_fp, multi_linestring_type_fp>> results(tool_count);
     const auto trace_count = vectorial_surface->first.size() + thermal_holes.size(); // Includes thermal holes.
     // One for each trace or thermal hole, including all prior tools.
-    vector<multi_polygon_type_fp> already_milled(trace_count);
+    vector<milled_regions::MilledRegions> already_milled(trace_count);
     for (size_t tool_index = 0; tool_index < tool_count; tool_index++) {
       const auto& tool = isolator->tool_diameters_and_overlap_widths[tool_index];
       const auto tool_diameter = tool.first;
       vector<vector<pair<linestring_type_fp, bool>>> new_trace_toolpaths(trace_count);
 
-      vector<multi_polygon_type_fp> keep_outs;
-      keep_outs.reserve(vectorial_surface->first.size());
-      for (const auto& poly : vectorial_surface->first) {
-        keep_outs.push_back(bg_helpers::buffer(poly, tool_diameter/2 + isolator->offset));
-      }
-      const auto path_finding_surface = path_finding::PathFindingSurface(mask ? make_optional(mask->vectorial_surface->first) : boost::none, sum(keep_outs), isolator->tolerance);
-      for (size_t trace_index = 0; trace_index < trace_count; trace_index++) {
-        multi_polygon_type_fp already_milled_shrunk =
-            bg_helpers::buffer(already_milled[trace_index], -tool_diameter/2 + tolerance);
+      const auto keep_outs = thread_pool::parallel_map(
+          vectorial_surface->first, [&](const polygon_type_fp& poly) {
+            return bg_helpers::buffer(poly, tool_diameter/2 + isolator->offset);
+          });
+      const auto path_finding_surface = path_finding::PathFindingSurface(mask ? make_optional(mask->vectorial_surface->first) : boost::none, sum(keep_outs), isolator->tolerance, search_options(isolator));
+      // Each trace only reads the shared state and writes its own results so
+      // they are done in parallel.  The threads steal traces from each
+      // other, so a large pour doesn't hold up the small pads after it.
+      thread_pool::parallel_for(trace_count, [&](size_t trace_index) {
+        milled_regions::MilledRegions already_milled_shrunk(
+            bg_helpers::buffer(already_milled[trace_index].all(), -tool_diameter/2 + tolerance));
         if (tool_index < tool_count - 1) {
           // Don't force isolation.  By pretending that an area around
           // the trace is already milled, it will be removed from
@@ -998,7 +1272,7 @@ vector<pair<coordinate_type_fp, multi_linestring_type_fp>> Surface_vectorial::ge
             multi_polygon_type_fp temp =
                 bg_helpers::buffer(vectorial_surface->first.at(trace_index),
                                    tool_diameter/2 + isolator->offset - tolerance);
-            already_milled_shrunk = already_milled_shrunk + temp;
+            already_milled_shrunk.add(temp);
           }
         }
         auto new_trace_toolpath = get_single_toolpath(isolator, trace_index, mirror, tool.first, tool.second,
@@ -1018,7 +1292,7 @@ vector<pair<coordinate_type_fp, multi_linestring_type_fp>> Surface_vectorial::ge
         new_trace_toolpaths[trace_index] = new_trace_toolpath;
         if (tool_index + 1 == tool_count) {
           // No point in updating the already_milled.
-          continue;
+          return;
         }
         multi_linestring_type_fp combined_trace_toolpath;
         combined_trace_toolpath.reserve(new_trace_toolpath.size());
@@ -1027,14 +1301,14 @@ vector<pair<coordinate_type_fp, multi_linestring_type_fp>> Surface_vectorial::ge
         }
         multi_polygon_type_fp new_trace_toolpath_bufferred =
             bg_helpers::buffer(combined_trace_toolpath, tool_diameter/2);
-        already_milled[trace_index] = already_milled[trace_index] + new_trace_toolpath_bufferred;
-      }
+        already_milled[trace_index].add(new_trace_toolpath_bufferred);
+      });
 
       const string tool_suffix = tool_count > 1 ? "_" + std::to_string(tool_index) : "";
-      write_svgs(tool_suffix, tool_diameter, new_trace_toolpaths, isolator->tolerance, tool_index == tool_count - 1);
+      write_svgs(tool_suffix, tool_diameter, new_trace_toolpaths, tool_index == tool_count - 1 ? isolator : nullptr, false);
       auto new_toolpath = flatten(new_trace_toolpaths);
       multi_linestring_type_fp combined_toolpath = post_process_toolpath(mill, make_optional(&path_finding_surface), new_toolpath);
-      write_svgs("_final" + tool_suffix, tool_diameter, combined_toolpath, isolator->tolerance, tool_index == tool_count - 1);
+      write_svgs("_final" + tool_suffix, tool_diameter, combined_toolpath, tool_index == tool_count - 1 ? isolator : nullptr, true);
       results[tool_index] = make_pair(tool_diameter, mirror_toolpath(combined_toolpath, mirror, ymirror));
     }
     // Now process any lines that need drawing.
@@ -1044,15 +1318,17 @@ vector<pair<coordinate_type_fp, multi_linestring_type_fp>> Surface_vectorial::ge
       // Each linestring has a bool attached to it indicating if it is reversible.
       // true means reversal is still allowed.
       vector<pair<linestring_type_fp, bool>> new_trace_toolpath;
+      endpoint_index::EndpointIndex toolpath_ends;
       PathFinder path_finder =
           [&](const point_type_fp&, const point_type_fp&) -> optional<linestring_type_fp> {
             return boost::none;
           };
+      // The path finder never connects so don't look for connections.
       for (const auto& path : paths) {
-        attach_ls(path, new_trace_toolpath, MillFeedDirection::ANY, path_finder);
+        attach_ls(path, new_trace_toolpath, toolpath_ends, MillFeedDirection::ANY, path_finder, -1);
       }
       const string tool_suffix = "_lines_" + std::to_string(tool_diameter);
-      write_svgs(tool_suffix, tool_diameter, {new_trace_toolpath}, mill->tolerance, false);
+      write_svgs(tool_suffix, tool_diameter, {new_trace_toolpath}, nullptr, false);
       multi_linestring_type_fp combined_toolpath = post_process_toolpath(isolator, boost::none, new_trace_toolpath);
       results.push_back(make_pair(tool_diameter, mirror_toolpath(combined_toolpath, mirror, ymirror)));
     }
@@ -1060,15 +1336,14 @@ vector<pair<coordinate_type_fp, multi_linestring_type_fp>> Surface_vectorial::ge
   }
   auto cutter = dynamic_pointer_cast<Cutter>(mill);
   if (cutter) {
-    const auto path_finding_surface = path_finding::PathFindingSurface(multi_polygon_type_fp(), multi_polygon_type_fp(), cutter->tolerance);
+    const auto path_finding_surface = path_finding::PathFindingSurface(multi_polygon_type_fp(), multi_polygon_type_fp(), cutter->tolerance, search_options(cutter));
     const auto trace_count = vectorial_surface->first.size();
     vector<vector<pair<linestring_type_fp, bool>>> new_trace_toolpaths(trace_count);
 
-    for (size_t trace_index = 0; trace_index < trace_count; trace_index++) {
-      const auto new_trace_toolpath = get_single_toolpath(cutter, trace_index, mirror, cutter->tool_diameter, 0, multi_polygon_type_fp(), path_finding_surface);
-      new_trace_toolpaths[trace_index] = new_trace_toolpath;
-    }
-    write_svgs("", cutter->tool_diameter, new_trace_toolpaths, mill->tolerance, false);
+    thread_pool::parallel_for(trace_count, [&](size_t trace_index) {
+      new_trace_toolpaths[trace_index] = get_single_toolpath(cutter, trace_index, mirror, cutter->tool_diameter, 0, milled_regions::MilledRegions(), path_finding_surface);
+    });
+    write_svgs("", cutter->tool_diameter, new_trace_toolpaths, nullptr, true);
     auto new_toolpath = flatten(new_trace_toolpaths);
     multi_linestring_type_fp combined_toolpath = post_process_toolpath(cutter, boost::none, new_toolpath);
     return {make_pair(cutter->tool_diameter, mirror_toolpath(combined_toolpath, mirror, ymirror))};
@@ -1079,13 +1354,18 @@ vector<pair<coordinate_type_fp, multi_linestring_type_fp>> Surface_vectorial::ge
 void Surface_vectorial::save_debug_image(string message)
 {
     const string filename = (boost::format("outp%d_%s.svg") % debug_image_index % message).str();
-    svg_writer debug_image(build_filename(outputdir, filename), bounding_box);
-
-    srand(1);
-    debug_image.add(vectorial_surface->first, 1, true);
-    for (const auto& diameter_and_path : vectorial_surface->second) {
-      debug_image.add(diameter_and_path.second, diameter_and_path.first, true);
-    }
+    // The surface is copied because masking changes it.
+    write_svg_in_background(
+        [filename = build_filename(outputdir, filename), bounding_box = bounding_box,
+         surface = *vectorial_surface]() {
+          svg_writer debug_image(filename, bounding_box);
+
+          srand(1);
+          debug_image.add(surface.first, 1, true);
+          for (const auto& diameter_and_path : surface.second) {
+            debug_image.add(diameter_and_path.second, diameter_and_path.first, true);
+          }
+        });
 
     ++debug_image_index;
 }
@@ -1114,7 +1394,11 @@ void Surface_vectorial::add_mask(shared_ptr<Surface_vectorial> surface) {
 // from the trace outward.  The offset is how far to kee away from any
 // trace, useful if the milling bit has some diameter that it is
 // guaranteed to mill but also some slop that causes it to sometimes
-// mill beyond its diameter.  The return value is rings to be milled
+// mill beyond its diameter.  If incremental is true, each pass is made
+// by buffering the pass before it, which is much cheaper than buffering
+// the original shape once the passes have rounded off its detail, and
+// the passes are within the tolerance of the ones made from the
+// original shape.  The return value is rings to be milled
 // and the number of them matches the number of steps.  The first one
 // is always the one closest to the trace.  For both voronoi and for
 // regular milling, that means it's the one with the least area.  For
@@ -1125,7 +1409,8 @@ vector<multi_polygon_type_fp> Surface_vectorial::offset_polygon(
     coordinate_type_fp diameter,
     coordinate_type_fp overlap,
     unsigned int steps, bool do_voronoi,
-    coordinate_type_fp offset) const {
+    coordinate_type_fp offset, bool incremental,
+    coordinate_type_fp tolerance) const {
   // The polygons to add to the PNG debugging output files.
   // Mask the polygon that we need to mill.
   multi_polygon_type_fp milling_poly{do_voronoi ? voronoi_polygon : *input};  // Milling voronoi or trace?
@@ -1162,8 +1447,10 @@ vector<multi_polygon_type_fp> Surface_vectorial::offset_polygon(
     }
   }
 
-  vector<multi_polygon_type_fp> polygons;
-  // Convert the input shape into a bunch of rings that need to be milled.
+  // How far to expand for each step and how much to buffer the
+  // milling_poly by, or none if the step isn't needed.
+  vector<coordinate_type_fp> expand_bys(steps);
+  vector<optional<coordinate_type_fp>> grow_bys(steps);
   for (unsigned int i = 0; i < steps; i++) {
     coordinate_type_fp expand_by;
     if (!do_voronoi) {
@@ -1186,8 +1473,21 @@ vector<multi_polygon_type_fp> Surface_vectorial::offset_polygon(
       }
       expand_by = (diameter - overlap) * factor;
     }
+    expand_bys[i] = expand_by;
+    grow_bys[i] = expand_by + offset + thermal_offset;
+  }
 
-    multi_polygon_type_fp buffered_milling_poly = bg_helpers::buffer(milling_poly, expand_by + offset + thermal_offset);
+  // The milling_poly buffered for each step, made as they are needed.
+  bg_helpers::Offsets buffered(milling_poly, grow_bys, incremental, tolerance);
+
+  vector<multi_polygon_type_fp> polygons;
+  // Convert the input shape into a bunch of rings that need to be milled.
+  for (unsigned int i = 0; i < steps; i++) {
+    if (!grow_bys[i]) {
+      continue; // Don't need this step.
+    }
+    const coordinate_type_fp expand_by = expand_bys[i];
+    multi_polygon_type_fp buffered_milling_poly = buffered.get(i);
     if (expand_by + offset != 0) {
       if (!do_voronoi) {
         buffered_milling_poly = buffered_milling_poly & voronoi_shrunk;
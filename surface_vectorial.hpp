@@ -39,6 +39,7 @@
 #include "voronoi.hpp"
 #include "units.hpp"
 #include "path_finding.hpp"
+#include "milled_regions.hpp"
 
 /******************************************************************************/
 /*
@@ -48,15 +49,13 @@ class Surface_vectorial: private boost::noncopyable {
  public:
   // This function returns a linestring that connects two points if possible.
   typedef std::function<boost::optional<linestring_type_fp>(const point_type_fp& start, const point_type_fp& end)> PathFinder;
-  typedef std::function<boost::optional<linestring_type_fp>(const point_type_fp& start,
-                                                            const point_type_fp& end,
-                                                            path_finding::SearchKey search_key)> PathFinderRingIndices;
 
-  Surface_vectorial(unsigned int points_per_circle,
+  Surface_vectorial(const tessellation::Tessellation& circle_points,
                     const box_type_fp& bounding_box,
                     std::string name, std::string outputdir, bool tsp_2opt,
                     MillFeedDirection::MillFeedDirection mill_feed_direction,
-                    bool invert_gerbers, bool render_paths_to_shapes);
+                    bool invert_gerbers, bool render_paths_to_shapes,
+                    DebugImages::DebugImages debug_images);
 
   std::vector<std::pair<coordinate_type_fp, multi_linestring_type_fp>> get_toolpath(
       std::shared_ptr<RoutingMill> mill, bool mirror, bool ymirror);
@@ -65,8 +64,12 @@ class Surface_vectorial: private boost::noncopyable {
   void add_mask(std::shared_ptr<Surface_vectorial> surface);
   // The importer provides the path.  The tolerance is used for
   // removing some of the finer detail in the path, to save time on
-  // processing.
-  void render(std::shared_ptr<GerberImporter> importer, double tolerance);
+  // processing.  If check_self_intersections is set, warn about
+  // polygons that cross themselves.  If there is a crop box, shapes and
+  // paths outside of it are discarded.
+  void render(std::shared_ptr<GerberImporter> importer, double tolerance,
+              bool check_self_intersections = true,
+              const boost::optional<box_type_fp>& crop = boost::none);
 
   inline coordinate_type_fp get_width_in() {
     return bounding_box.max_corner().x() - bounding_box.min_corner().x();
@@ -77,7 +80,7 @@ class Surface_vectorial: private boost::noncopyable {
   }
 
 protected:
-  const unsigned int points_per_circle;
+  const tessellation::Tessellation circle_points;
   const box_type_fp bounding_box;
   const std::string name;
   const std::string outputdir;
@@ -88,6 +91,7 @@ protected:
   const MillFeedDirection::MillFeedDirection mill_feed_direction;
   const bool invert_gerbers;
   const bool render_paths_to_shapes;
+  const DebugImages::DebugImages debug_images;
 
   std::shared_ptr<std::pair<multi_polygon_type_fp,
                       std::map<coordinate_type_fp, multi_linestring_type_fp>>>
@@ -101,14 +105,17 @@ protected:
   std::vector<std::pair<linestring_type_fp, bool>> get_single_toolpath(
       std::shared_ptr<RoutingMill> mill, const size_t trace_index, bool mirror, const double tool_diameter,
       const double overlap_width,
-      const multi_polygon_type_fp& already_milled,
+      const milled_regions::MilledRegions& already_milled,
       const path_finding::PathFindingSurface& path_finding_surface) const;
+  // The longest path that is worth milling to get from a to b.
+  coordinate_type_fp max_path_length(std::shared_ptr<RoutingMill> mill,
+                                     const point_type_fp& a,
+                                     const point_type_fp& b) const;
   PathFinder make_path_finder(
       std::shared_ptr<RoutingMill> mill,
       const path_finding::PathFindingSurface& path_finding_surface) const;
-  PathFinderRingIndices make_path_finder_ring_indices(
-      std::shared_ptr<RoutingMill> mill,
-      const path_finding::PathFindingSurface& path_finding_surface) const;
+  // The furthest apart that the path finder might connect two points.
+  coordinate_type_fp path_finder_reach(std::shared_ptr<RoutingMill> mill) const;
   std::vector<std::pair<linestring_type_fp, bool>> final_path_finder(
       const std::shared_ptr<RoutingMill>& mill,
       const path_finding::PathFindingSurface& path_finding_surface,
@@ -119,17 +126,28 @@ protected:
       coordinate_type_fp diameter,
       coordinate_type_fp overlap,
       unsigned int steps, bool do_voronoi,
-      coordinate_type_fp offset) const;
+      coordinate_type_fp offset, bool incremental,
+      coordinate_type_fp tolerance) const;
   multi_linestring_type_fp post_process_toolpath(
       const std::shared_ptr<RoutingMill>& mill,
       const boost::optional<const path_finding::PathFindingSurface*>& path_finding_surface,
       std::vector<std::pair<linestring_type_fp, bool>> toolpath) const;
+  // Warns about toolpaths that are closer to their trace than the
+  // isolator allows and reports them if asked.  Returns the parts of
+  // the toolpaths that are too close if they are needed for the images.
+  std::vector<multi_linestring_type_fp> find_contentions(
+      const std::string& tool_suffix, coordinate_type_fp tool_diameter,
+      const std::vector<std::vector<std::pair<linestring_type_fp, bool>>>& new_trace_toolpaths,
+      const Isolator& isolator, bool write_images) const;
+  // Basic images are the toolpaths that get milled, the rest are only
+  // written for full debug images.  Contentions are only looked for if
+  // there is an isolator.
   void write_svgs(const std::string& tool_suffix, coordinate_type_fp tool_diameter,
                   const std::vector<std::vector<std::pair<linestring_type_fp, bool>>>& new_trace_toolpaths,
-                  coordinate_type_fp tolerance, bool find_contentions) const;
+                  const std::shared_ptr<Isolator>& contentions_isolator, bool basic) const;
   void write_svgs(const std::string& tool_suffix, coordinate_type_fp tool_diameter,
                   const multi_linestring_type_fp& toolpaths,
-                  coordinate_type_fp tolerance, bool find_contentions) const;
+                  const std::shared_ptr<Isolator>& contentions_isolator, bool basic) const;
 };
 
 #endif // SURFACE_VECTORIAL_H
@@ -1,9 +1,12 @@
 #include <string>
 #include <boost/format.hpp>
+#include <iostream>
 #include <memory>
+#include <mutex>
 #include "geometry.hpp"
 #include "bg_operators.hpp"
 #include "svg_writer.hpp"
+#include "thread_pool.hpp"
 
 using std::string;
 using std::unique_ptr;
@@ -115,3 +118,36 @@ void svg_writer::add(multi_linestring_type_fp path, coordinate_type_fp width, un
     add(p, width, r, g, b);
   }
 }
+
+namespace {
+
+std::mutex svg_writes_mutex;
+unique_ptr<thread_pool::ThreadPool> svg_writes;
+
+void draw_and_report(const std::function<void()>& draw) {
+  try {
+    draw();
+  } catch (const std::exception& e) {
+    std::cerr << "\nWarning: Failed to write a debug image: " << e.what() << "\n";
+  }
+}
+
+} // namespace
+
+void write_svg_in_background(std::function<void()> draw) {
+  if (thread_pool::get_jobs() <= 1) {
+    draw_and_report(draw);
+    return;
+  }
+  std::lock_guard<std::mutex> lock(svg_writes_mutex);
+  if (!svg_writes) {
+    svg_writes = make_unique<thread_pool::ThreadPool>(1);
+  }
+  svg_writes->submit([draw]() { draw_and_report(draw); });
+}
+
+void finish_svg_writes() {
+  std::lock_guard<std::mutex> lock(svg_writes_mutex);
+  // The pool finishes the queue before it stops.
+  svg_writes.reset();
+}
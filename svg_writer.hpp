@@ -2,6 +2,7 @@
 #define SVG_WRITER_HPP
 
 #include <fstream>
+#include <functional>
 
 class svg_writer {
  public:
@@ -18,4 +19,13 @@ class svg_writer {
   std::unique_ptr<bg::svg_mapper<point_type_fp> > mapper;
 };
 
+// Debug images are drawn on one background thread so that they don't
+// hold up the toolpaths.  They are drawn one at a time in the order
+// that they were queued so the random colours are the same on every
+// run.  The function must not use anything that might change after it
+// is queued.
+void write_svg_in_background(std::function<void()> draw);
+// Wait until all the queued images are written.
+void finish_svg_writes();
+
 #endif //SVG_WRITER_HPP
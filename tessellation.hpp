@@ -0,0 +1,85 @@
+#ifndef TESSELLATION_HPP
+#define TESSELLATION_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+
+#include "geometry.hpp"
+
+// Decides how many points to use when approximating circles and arcs
+// with straight segments.  With a fixed count, a tiny via gets as many
+// points as a large mounting hole.  With a maximum error, each circle
+// gets just enough points so that no chord is further than max_error
+// from the true circle: few for small features, more for large ones.
+namespace tessellation {
+
+// Counters of the points used, for reporting.  fixed_points is how many
+// there would have been with the fixed count per circle.
+struct Stats {
+  std::atomic<uint64_t> points{0};
+  std::atomic<uint64_t> fixed_points{0};
+  void reset() {
+    points = 0;
+    fixed_points = 0;
+  }
+};
+
+inline Stats& stats() {
+  static Stats stats;
+  return stats;
+}
+
+// Even the smallest circle keeps this many points.
+const unsigned int min_points = 8;
+const unsigned int max_points = 3600;
+
+class Tessellation {
+ public:
+  // If max_error is 0, every circle gets points_per_circle points.
+  explicit Tessellation(unsigned int points_per_circle, coordinate_type_fp max_error = 0) :
+      points_per_circle(points_per_circle),
+      max_error(max_error),
+      counts(&stats()) {}
+
+  // The same but use_points counts into counts instead of the global
+  // stats.
+  Tessellation counting_into(Stats& counts) const {
+    Tessellation ret(*this);
+    ret.counts = &counts;
+    return ret;
+  }
+
+  // The number of points for a full circle of this diameter.
+  unsigned int points(coordinate_type_fp diameter) const {
+    const coordinate_type_fp radius = diameter / 2;
+    if (max_error <= 0 || radius <= 0) {
+      return points_per_circle;
+    }
+    if (max_error >= radius) {
+      return min_points;
+    }
+    // A chord spanning angle a is radius * (1 - cos(a/2)) from the circle.
+    const double points = std::ceil(bg::math::pi<double>() / std::acos(1 - max_error / radius));
+    return std::max(min_points, std::min(max_points, static_cast<unsigned int>(points)));
+  }
+
+  // Same as above and count them in the stats, for when the points are
+  // actually made.  fraction is the part of the circle that is drawn.
+  unsigned int use_points(coordinate_type_fp diameter, double fraction = 1) const {
+    const unsigned int ret = points(diameter);
+    counts->points += std::ceil(ret * fraction);
+    counts->fixed_points += std::ceil(points_per_circle * fraction);
+    return ret;
+  }
+
+ private:
+  unsigned int points_per_circle;
+  coordinate_type_fp max_error;
+  Stats* counts;
+};
+
+} // namespace tessellation
+
+#endif // TESSELLATION_HPP
@@ -0,0 +1,54 @@
+#define BOOST_TEST_MODULE tessellation tests
+#include <boost/test/unit_test.hpp>
+
+#include <cmath>
+
+#include "tessellation.hpp"
+
+using namespace tessellation;
+
+// The distance from the middle of a chord to the circle.
+double chord_error(double diameter, unsigned int points) {
+  return diameter / 2 * (1 - std::cos(bg::math::pi<double>() / points));
+}
+
+BOOST_AUTO_TEST_SUITE(tessellation_tests)
+
+BOOST_AUTO_TEST_CASE(fixed) {
+  const Tessellation circle_points(30);
+  BOOST_CHECK_EQUAL(circle_points.points(0.001), 30);
+  BOOST_CHECK_EQUAL(circle_points.points(10), 30);
+}
+
+BOOST_AUTO_TEST_CASE(within_max_error) {
+  const Tessellation circle_points(30, 0.0004);
+  for (double diameter : {0.01, 0.02, 0.1, 0.4, 1.0}) {
+    const unsigned int points = circle_points.points(diameter);
+    BOOST_CHECK_LE(chord_error(diameter, points), 0.0004);
+    if (points > min_points) {
+      // One less wouldn't have been enough.
+      BOOST_CHECK_GT(chord_error(diameter, points - 1), 0.0004);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(scales_with_size) {
+  const Tessellation circle_points(30, 0.0004);
+  BOOST_CHECK_EQUAL(circle_points.points(0.0001), min_points);
+  BOOST_CHECK_LT(circle_points.points(0.008), 30);
+  BOOST_CHECK_GT(circle_points.points(0.4), 30);
+  BOOST_CHECK_EQUAL(circle_points.points(1e6), max_points);
+}
+
+BOOST_AUTO_TEST_CASE(counts) {
+  Stats counts;
+  const Tessellation circle_points = Tessellation(30, 0.0004).counting_into(counts);
+  const unsigned int points = circle_points.use_points(0.008);
+  circle_points.use_points(0.008, 0.5);
+  BOOST_CHECK_EQUAL(counts.points, points + std::ceil(points * 0.5));
+  BOOST_CHECK_EQUAL(counts.fixed_points, 45);
+  circle_points.points(0.008);
+  BOOST_CHECK_EQUAL(counts.fixed_points, 45);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
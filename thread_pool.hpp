@@ -0,0 +1,273 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+// A small pool of worker threads and helpers for running loops in
+// parallel.  The number of threads is set once, early, with
+// set_jobs().  All the helpers here make the calling thread do work,
+// too, so they may be nested without deadlocking: a parallel_for
+// inside of a parallel_for just runs serially if all the workers are
+// busy.
+namespace thread_pool {
+
+// Each worker has its own deque of tasks.  Tasks are handed to the
+// workers in turn and a worker runs its own tasks from the front.  A
+// worker with nothing to do steals from the back of the others' deques
+// before it goes to sleep.
+class ThreadPool : private boost::noncopyable {
+ public:
+  explicit ThreadPool(size_t threads) {
+    queues.reserve(threads);
+    for (size_t i = 0; i < threads; i++) {
+      queues.emplace_back(new Queue());
+    }
+    workers.reserve(threads);
+    for (size_t i = 0; i < threads; i++) {
+      workers.emplace_back([this, i]() { work(i); });
+    }
+  }
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers) {
+      worker.join();
+    }
+  }
+
+  void submit(std::function<void()> task) {
+    auto& queue = *queues[next_queue++ % queues.size()];
+    {
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      queue.tasks.push_back(std::move(task));
+    }
+    {
+      // Counted under the lock so that a worker can't miss it between
+      // looking for work and going to sleep.
+      std::lock_guard<std::mutex> lock(mutex);
+      pending++;
+    }
+    wake.notify_one();
+  }
+
+  size_t size() const { return workers.size(); }
+
+ private:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks;
+  };
+
+  // Take a task from the front of our own queue or else from the back
+  // of another one.
+  bool take(size_t self, std::function<void()>& task) {
+    for (size_t i = 0; i < queues.size(); i++) {
+      auto& queue = *queues[(self + i) % queues.size()];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      if (queue.tasks.empty()) {
+        continue;
+      }
+      if (i == 0) {
+        task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+      } else {
+        task = std::move(queue.tasks.back());
+        queue.tasks.pop_back();
+      }
+      return true;
+    }
+    return false;
+  }
+
+  void work(size_t self) {
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        wake.wait(lock, [this]() { return stopping || pending > 0; });
+        if (pending == 0) {
+          return; // Stopping and nothing left to do.
+        }
+        // Claim one of the tasks.  Only workers with a claim take
+        // tasks so there is always one left for us in some queue.
+        pending--;
+      }
+      std::function<void()> task;
+      take(self, task);
+      task();
+    }
+  }
+
+  std::vector<std::unique_ptr<Queue>> queues;
+  std::vector<std::thread> workers;
+  std::atomic<size_t> next_queue{0};
+  // Tasks that were submitted and not yet claimed by a worker.
+  size_t pending = 0;
+  std::mutex mutex;
+  std::condition_variable wake;
+  bool stopping = false;
+};
+
+// The number of threads to use, including the calling thread.
+inline size_t& jobs_storage() {
+  static size_t jobs = std::max(1u, std::thread::hardware_concurrency());
+  return jobs;
+}
+
+inline std::unique_ptr<ThreadPool>& pool_storage() {
+  static std::unique_ptr<ThreadPool> pool;
+  return pool;
+}
+
+inline size_t get_jobs() {
+  return jobs_storage();
+}
+
+// Set the number of threads to use.  0 means one per core.  This must
+// not be called while work is running in the pool.
+inline void set_jobs(size_t jobs) {
+  if (jobs == 0) {
+    jobs = std::max(1u, std::thread::hardware_concurrency());
+  }
+  if (jobs != jobs_storage()) {
+    pool_storage().reset();
+    jobs_storage() = jobs;
+  }
+}
+
+// The pool has one fewer thread than the jobs because the caller
+// always helps.
+inline ThreadPool& get_pool() {
+  auto& pool = pool_storage();
+  if (!pool) {
+    pool.reset(new ThreadPool(get_jobs() - 1));
+  }
+  return *pool;
+}
+
+// Run f(0) ... f(count-1), possibly in parallel and in any order.
+// Each thread starts with an even share of the indices and takes them
+// one at a time from the front.  A thread that runs out steals the back
+// half of what another thread has left, so one slow index doesn't hold
+// up the ones queued behind it.  If any call throws, the first
+// exception is rethrown after all the calls are finished.
+template <typename Function>
+void parallel_for(size_t count, const Function& f) {
+  const size_t threads = std::min(get_jobs(), count);
+  if (threads <= 1) {
+    for (size_t i = 0; i < count; i++) {
+      f(i);
+    }
+    return;
+  }
+  // The indices from begin to end that a thread hasn't done yet.
+  struct Range {
+    std::mutex mutex;
+    size_t begin;
+    size_t end;
+  };
+  // Helpers might only start after we have returned so the state that
+  // they share must outlive this function.  f is only used while
+  // there are indices left, which is always before we return.
+  struct State {
+    explicit State(size_t threads) : ranges(threads) {}
+    std::vector<Range> ranges;
+    std::atomic<size_t> next_thread{0};
+    std::atomic<size_t> done{0};
+    std::mutex mutex;
+    std::condition_variable finished;
+    std::exception_ptr error;
+  };
+  auto state = std::make_shared<State>(threads);
+  for (size_t i = 0; i < threads; i++) {
+    state->ranges[i].begin = count * i / threads;
+    state->ranges[i].end = count * (i + 1) / threads;
+  }
+  auto run = [state, threads, count, &f]() {
+    const size_t self = state->next_thread++;
+    auto& own = state->ranges[self];
+    while (true) {
+      size_t i = 0;
+      bool found = false;
+      {
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (own.begin < own.end) {
+          i = own.begin++;
+          found = true;
+        }
+      }
+      if (!found) {
+        // Out of work, so steal some.  Only the owner moves the begin
+        // and only thieves move the end.
+        size_t stolen_begin = 0;
+        size_t stolen_end = 0;
+        for (size_t t = 1; t < threads && stolen_begin == stolen_end; t++) {
+          auto& victim = state->ranges[(self + t) % threads];
+          std::lock_guard<std::mutex> lock(victim.mutex);
+          stolen_end = victim.end;
+          stolen_begin = victim.end - (victim.end - victim.begin + 1) / 2;
+          victim.end = stolen_begin;
+        }
+        if (stolen_begin == stolen_end) {
+          return; // Nothing left anywhere.
+        }
+        std::lock_guard<std::mutex> lock(own.mutex);
+        own.begin = stolen_begin;
+        own.end = stolen_end;
+        continue;
+      }
+      try {
+        f(i);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        if (!state->error) {
+          state->error = std::current_exception();
+        }
+      }
+      if (++state->done == count) {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->finished.notify_all();
+      }
+    }
+  };
+  auto& pool = get_pool();
+  for (size_t i = 1; i < threads; i++) {
+    pool.submit(run);
+  }
+  run();
+  std::unique_lock<std::mutex> lock(state->mutex);
+  state->finished.wait(lock, [&]() { return state->done == count; });
+  if (state->error) {
+    std::rethrow_exception(state->error);
+  }
+}
+
+// Run f on each element of inputs, possibly in parallel, and return
+// the results in the same order as the inputs.
+template <typename Input, typename Function>
+auto parallel_map(const std::vector<Input>& inputs, const Function& f)
+    -> std::vector<decltype(f(inputs.front()))> {
+  std::vector<decltype(f(inputs.front()))> outputs(inputs.size());
+  parallel_for(inputs.size(), [&](size_t i) {
+    outputs[i] = f(inputs[i]);
+  });
+  return outputs;
+}
+
+} // namespace thread_pool
+
+#endif // THREAD_POOL_HPP
@@ -0,0 +1,95 @@
+#define BOOST_TEST_MODULE thread pool tests
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "thread_pool.hpp"
+
+using namespace thread_pool;
+
+BOOST_AUTO_TEST_SUITE(thread_pool_tests)
+
+BOOST_AUTO_TEST_CASE(each_index_once) {
+  set_jobs(4);
+  std::vector<std::atomic<int>> counts(1000);
+  parallel_for(counts.size(), [&](size_t i) { counts[i]++; });
+  for (const auto& count : counts) {
+    BOOST_CHECK_EQUAL(count, 1);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(empty) {
+  set_jobs(4);
+  parallel_for(0, [](size_t) { BOOST_FAIL("Shouldn't be called"); });
+}
+
+BOOST_AUTO_TEST_CASE(exception) {
+  set_jobs(4);
+  std::atomic<int> calls{0};
+  BOOST_CHECK_THROW(parallel_for(100, [&](size_t i) {
+                                   calls++;
+                                   if (i == 50) {
+                                     throw std::runtime_error("fail");
+                                   }
+                                 }),
+                    std::runtime_error);
+  // All the others still ran.
+  BOOST_CHECK_EQUAL(calls, 100);
+}
+
+BOOST_AUTO_TEST_CASE(nested) {
+  set_jobs(3);
+  std::atomic<int> total{0};
+  parallel_for(10, [&](size_t) {
+    parallel_for(10, [&](size_t j) { total += j; });
+  });
+  BOOST_CHECK_EQUAL(total, 450);
+}
+
+BOOST_AUTO_TEST_CASE(steals_from_busy_thread) {
+  set_jobs(2);
+  // Index 0 waits for all the others, including the ones that started
+  // in its own share, so they must be stolen by the other thread.
+  const size_t count = 100;
+  std::atomic<size_t> others_done{0};
+  bool waited = false;
+  parallel_for(count, [&](size_t i) {
+    if (i == 0) {
+      const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+      while (others_done < count - 1 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+      waited = others_done == count - 1;
+    } else {
+      others_done++;
+    }
+  });
+  BOOST_CHECK(waited);
+}
+
+BOOST_AUTO_TEST_CASE(serial) {
+  set_jobs(1);
+  BOOST_CHECK_EQUAL(get_jobs(), 1);
+  std::vector<size_t> order;
+  parallel_for(5, [&](size_t i) { order.push_back(i); });
+  BOOST_CHECK(order == std::vector<size_t>({0, 1, 2, 3, 4}));
+}
+
+BOOST_AUTO_TEST_CASE(map_keeps_order) {
+  set_jobs(4);
+  std::vector<int> inputs;
+  for (int i = 0; i < 100; i++) {
+    inputs.push_back(i);
+  }
+  const auto outputs = parallel_map(inputs, [](int x) { return x * x; });
+  BOOST_REQUIRE_EQUAL(outputs.size(), inputs.size());
+  for (size_t i = 0; i < outputs.size(); i++) {
+    BOOST_CHECK_EQUAL(outputs[i], inputs[i] * inputs[i]);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
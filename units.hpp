@@ -620,4 +620,44 @@ inline std::istream& operator>>(std::istream& in, MillFeedDirection& millfeeddir
 }
 } // namespace MillFeedDirection
 
+namespace DebugImages {
+// Which SVGs to write for debugging.  BASIC is the input layers, the
+// final toolpaths and the contentions.  FULL adds the masked layers and
+// the toolpaths of each tool before they are joined.
+enum DebugImages {
+  NONE,
+  BASIC,
+  FULL
+};
+
+inline std::istream& operator>>(std::istream& in, DebugImages& debug_images) {
+  std::string token(std::istreambuf_iterator<char>(in), {});
+  if (boost::iequals(token, "none")) {
+    debug_images = DebugImages::NONE;
+  } else if (boost::iequals(token, "basic")) {
+    debug_images = DebugImages::BASIC;
+  } else if (boost::iequals(token, "full")) {
+    debug_images = DebugImages::FULL;
+  } else {
+    throw boost::program_options::invalid_option_value(token);
+  }
+  return in;
+}
+
+inline std::ostream& operator<<(std::ostream& out, const DebugImages& debug_images) {
+  switch (debug_images) {
+    case DebugImages::NONE:
+      out << "none";
+      break;
+    case DebugImages::BASIC:
+      out << "basic";
+      break;
+    case DebugImages::FULL:
+      out << "full";
+      break;
+  }
+  return out;
+}
+} // namespace DebugImages
+
 #endif // UNITS_HPP
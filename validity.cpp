@@ -0,0 +1,220 @@
+#include "validity.hpp"
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+#include <boost/optional.hpp>
+
+#include "geometry.hpp"
+#include "thread_pool.hpp"
+
+namespace validity {
+
+using std::vector;
+using boost::optional;
+
+namespace {
+
+struct Edge {
+  Edge(const point_type_fp& a, const point_type_fp& b,
+       size_t polygon, size_t ring, size_t index, size_t ring_size) :
+      a(a), b(b), polygon(polygon), ring(ring), index(index), ring_size(ring_size),
+      min_x(std::min(a.x(), b.x())), max_x(std::max(a.x(), b.x())),
+      min_y(std::min(a.y(), b.y())), max_y(std::max(a.y(), b.y())) {}
+  point_type_fp a;
+  point_type_fp b;
+  size_t polygon;
+  size_t ring;
+  size_t index; // Position in the ring.
+  size_t ring_size; // Number of edges in the ring.
+  coordinate_type_fp min_x;
+  coordinate_type_fp max_x;
+  coordinate_type_fp min_y;
+  coordinate_type_fp max_y;
+};
+
+// Positive if o, a, b turn counterclockwise, negative if clockwise and
+// 0 if they are collinear.
+double cross(const point_type_fp& o, const point_type_fp& a, const point_type_fp& b) {
+  return (a.x() - o.x()) * (b.y() - o.y()) - (a.y() - o.y()) * (b.x() - o.x());
+}
+
+// p is known to be collinear with the edge.
+bool on_edge(const Edge& e, const point_type_fp& p) {
+  return e.min_x <= p.x() && p.x() <= e.max_x &&
+         e.min_y <= p.y() && p.y() <= e.max_y;
+}
+
+// Where the edges meet, if they do.
+optional<point_type_fp> meet(const Edge& e0, const Edge& e1) {
+  const double d0 = cross(e1.a, e1.b, e0.a);
+  const double d1 = cross(e1.a, e1.b, e0.b);
+  const double d2 = cross(e0.a, e0.b, e1.a);
+  const double d3 = cross(e0.a, e0.b, e1.b);
+  if (((d0 > 0 && d1 < 0) || (d0 < 0 && d1 > 0)) &&
+      ((d2 > 0 && d3 < 0) || (d2 < 0 && d3 > 0))) {
+    const double t = d0 / (d0 - d1);
+    return point_type_fp(e0.a.x() + t * (e0.b.x() - e0.a.x()),
+                         e0.a.y() + t * (e0.b.y() - e0.a.y()));
+  }
+  if (d0 == 0 && on_edge(e1, e0.a)) {
+    return e0.a;
+  }
+  if (d1 == 0 && on_edge(e1, e0.b)) {
+    return e0.b;
+  }
+  if (d2 == 0 && on_edge(e0, e1.a)) {
+    return e1.a;
+  }
+  if (d3 == 0 && on_edge(e0, e1.b)) {
+    return e1.b;
+  }
+  return boost::none;
+}
+
+// second follows first in the ring.  They share a vertex so they only
+// intersect if second doubles back over first.
+bool doubles_back(const Edge& first, const Edge& second) {
+  return cross(first.a, first.b, second.b) == 0 &&
+         (first.b.x() - first.a.x()) * (second.b.x() - second.a.x()) +
+         (first.b.y() - first.a.y()) * (second.b.y() - second.a.y()) < 0;
+}
+
+optional<point_type_fp> intersection(const Edge& e0, const Edge& e1) {
+  if (e0.polygon == e1.polygon && e0.ring == e1.ring) {
+    const bool e1_follows = (e0.index + 1) % e0.ring_size == e1.index;
+    const bool e0_follows = (e1.index + 1) % e1.ring_size == e0.index;
+    if (e1_follows && doubles_back(e0, e1)) {
+      return e0.b;
+    }
+    if (e0_follows && doubles_back(e1, e0)) {
+      return e1.b;
+    }
+    if (e1_follows || e0_follows) {
+      return boost::none;
+    }
+  }
+  return meet(e0, e1);
+}
+
+// Adds the edges of the ring, skipping repeated points.
+void add_edges(const ring_type_fp& ring, size_t polygon_index, size_t ring_index,
+               vector<Edge>& edges) {
+  vector<point_type_fp> points;
+  points.reserve(ring.size());
+  for (const auto& point : ring) {
+    if (points.empty() || !bg::equals(point, points.back())) {
+      points.push_back(point);
+    }
+  }
+  while (points.size() > 1 && bg::equals(points.front(), points.back())) {
+    points.pop_back();
+  }
+  if (points.size() < 2) {
+    return;
+  }
+  for (size_t i = 0; i < points.size(); i++) {
+    edges.emplace_back(points[i], points[(i + 1) % points.size()],
+                       polygon_index, ring_index, i, points.size());
+  }
+}
+
+void add_edges(const polygon_type_fp& poly, size_t polygon_index, vector<Edge>& edges) {
+  add_edges(poly.outer(), polygon_index, 0, edges);
+  for (size_t i = 0; i < poly.inners().size(); i++) {
+    add_edges(poly.inners()[i], polygon_index, i + 1, edges);
+  }
+}
+
+// The first place found where an edge of each polygon meets another
+// edge, keyed by polygon.
+typedef std::map<size_t, point_type_fp> Locations;
+
+// Sweeps the edges in [begin, end) of the edges, which are sorted by
+// min_x.  Each one is compared with the edges before it in the whole
+// list that overlap it in x, so every pair that overlaps in x is
+// compared in exactly one slab: the one with the later of the two.
+// Stops early once all polygon_count polygons have a location.
+Locations sweep(const vector<Edge>& edges, size_t begin, size_t end, size_t polygon_count) {
+  Locations locations;
+  // The edges that might still overlap the sweep line.  It starts with
+  // the edges of the earlier slabs that reach into this one.
+  vector<const Edge*> active;
+  for (size_t i = 0; i < begin; i++) {
+    if (edges[i].max_x >= edges[begin].min_x) {
+      active.push_back(&edges[i]);
+    }
+  }
+  for (size_t i = begin; i < end && locations.size() < polygon_count; i++) {
+    const Edge& edge = edges[i];
+    auto new_end = std::remove_if(
+        active.begin(), active.end(),
+        [&](const Edge* other) { return other->max_x < edge.min_x; });
+    active.erase(new_end, active.end());
+    for (const Edge* other : active) {
+      if (other->max_y < edge.min_y || edge.max_y < other->min_y) {
+        continue;
+      }
+      if (locations.count(edge.polygon) > 0 && locations.count(other->polygon) > 0) {
+        continue; // Nothing new to learn.
+      }
+      const auto location = intersection(*other, edge);
+      if (location) {
+        locations.emplace(edge.polygon, *location);
+        locations.emplace(other->polygon, *location);
+      }
+    }
+    active.push_back(&edge);
+  }
+  return locations;
+}
+
+// Finds a location for each polygon whose edges meet.  The edges are
+// sorted by min_x and split into slabs with the same number of edges,
+// which are swept in parallel.  The slabs only depend on the number of
+// edges so the result doesn't depend on the number of threads.
+Locations find_locations(vector<Edge>& edges, size_t polygon_count) {
+  std::sort(edges.begin(), edges.end(),
+            [](const Edge& lhs, const Edge& rhs) { return lhs.min_x < rhs.min_x; });
+  const size_t slab_count = std::max(size_t(1), std::min(size_t(64), edges.size() / 1024));
+  vector<Locations> slab_locations(slab_count);
+  thread_pool::parallel_for(slab_count, [&](size_t slab) {
+    slab_locations[slab] = sweep(edges,
+                                 edges.size() * slab / slab_count,
+                                 edges.size() * (slab + 1) / slab_count,
+                                 polygon_count);
+  });
+  // The leftmost slab wins.
+  Locations locations;
+  for (const auto& slab : slab_locations) {
+    locations.insert(slab.cbegin(), slab.cend());
+  }
+  return locations;
+}
+
+} // namespace
+
+optional<point_type_fp> self_intersection(const polygon_type_fp& poly) {
+  vector<Edge> edges;
+  add_edges(poly, 0, edges);
+  const auto locations = find_locations(edges, 1);
+  if (locations.empty()) {
+    return boost::none;
+  }
+  return locations.cbegin()->second;
+}
+
+vector<SelfIntersection> self_intersections(const multi_polygon_type_fp& mpoly) {
+  vector<Edge> edges;
+  for (size_t i = 0; i < mpoly.size(); i++) {
+    add_edges(mpoly[i], i, edges);
+  }
+  vector<SelfIntersection> ret;
+  for (const auto& location : find_locations(edges, mpoly.size())) {
+    ret.push_back({location.first, location.second});
+  }
+  return ret;
+}
+
+} // namespace validity
@@ -0,0 +1,34 @@
+#ifndef VALIDITY_HPP
+#define VALIDITY_HPP
+
+#include <vector>
+
+#include <boost/optional.hpp>
+
+#include "geometry.hpp"
+
+// Finds where polygons cross or touch themselves or each other.  The
+// edges of all the polygons are sorted by their smallest x and swept
+// from left to right so that each edge is only compared with the edges
+// that overlap it in x.  The sweep is split into slabs of x that are
+// swept in parallel.
+namespace validity {
+
+struct SelfIntersection {
+  size_t polygon; // Index into the multi_polygon.
+  point_type_fp location;
+};
+
+// Returns a place where two edges of the polygon meet, other than the
+// shared vertex of consecutive edges in a ring.  The edges can be in
+// the same ring or in different rings.
+boost::optional<point_type_fp> self_intersection(const polygon_type_fp& poly);
+
+// Returns a place for each polygon that has an edge that meets another
+// edge, in order of the polygons.  The other edge can be in the same
+// polygon or in another one, so polygons that overlap are found, too.
+std::vector<SelfIntersection> self_intersections(const multi_polygon_type_fp& mpoly);
+
+} // namespace validity
+
+#endif // VALIDITY_HPP
@@ -0,0 +1,96 @@
+#define BOOST_TEST_MODULE validity tests
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+
+#include "geometry.hpp"
+#include "validity.hpp"
+
+using namespace validity;
+
+polygon_type_fp read_polygon(const std::string& wkt) {
+  polygon_type_fp poly;
+  bg::read_wkt(wkt, poly);
+  return poly;
+}
+
+BOOST_AUTO_TEST_SUITE(validity_tests)
+
+BOOST_AUTO_TEST_CASE(valid) {
+  BOOST_CHECK(!self_intersection(read_polygon(
+      "POLYGON((0 0,0 10,10 10,10 0,0 0),(2 2,4 2,4 4,2 4,2 2))")));
+  // Repeated points and collinear edges are fine.
+  BOOST_CHECK(!self_intersection(read_polygon(
+      "POLYGON((0 0,0 5,0 5,0 10,10 10,10 0,0 0))")));
+}
+
+BOOST_AUTO_TEST_CASE(bowtie) {
+  const auto location = self_intersection(read_polygon(
+      "POLYGON((0 0,0 10,10 0,10 10,0 0))"));
+  BOOST_REQUIRE(location);
+  BOOST_CHECK_CLOSE(location->x(), 5, 1e-9);
+  BOOST_CHECK_CLOSE(location->y(), 5, 1e-9);
+}
+
+BOOST_AUTO_TEST_CASE(spike) {
+  const auto location = self_intersection(read_polygon(
+      "POLYGON((0 0,0 10,10 10,10 0,15 0,0 0))"));
+  BOOST_REQUIRE(location);
+  BOOST_CHECK_EQUAL(location->y(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(hole_crosses_outer) {
+  const auto location = self_intersection(read_polygon(
+      "POLYGON((0 0,0 10,10 10,10 0,0 0),(8 2,12 2,12 4,8 4,8 2))"));
+  BOOST_REQUIRE(location);
+  BOOST_CHECK_EQUAL(location->x(), 10);
+}
+
+BOOST_AUTO_TEST_CASE(multi_polygon) {
+  multi_polygon_type_fp mpoly;
+  bg::read_wkt("MULTIPOLYGON(((0 0,0 1,1 1,1 0,0 0)),"
+               "((5 0,5 1,6 0,6 1,5 0)),"
+               "((10 0,10 1,11 1,11 0,10 0)),"
+               "((20 0,20 1,21 0,21 1,20 0)))", mpoly);
+  const auto found = self_intersections(mpoly);
+  BOOST_REQUIRE_EQUAL(found.size(), 2);
+  BOOST_CHECK_EQUAL(found[0].polygon, 1);
+  BOOST_CHECK_CLOSE(found[0].location.x(), 5.5, 1e-9);
+  BOOST_CHECK_EQUAL(found[1].polygon, 3);
+  BOOST_CHECK_CLOSE(found[1].location.x(), 20.5, 1e-9);
+}
+
+BOOST_AUTO_TEST_CASE(overlapping_polygons) {
+  // Each polygon is fine on its own but they cross each other.
+  multi_polygon_type_fp mpoly;
+  bg::read_wkt("MULTIPOLYGON(((0 0,0 10,10 10,10 0,0 0)),"
+               "((20 0,20 1,21 1,21 0,20 0)),"
+               "((5 5,5 15,15 15,15 5,5 5)))", mpoly);
+  const auto found = self_intersections(mpoly);
+  BOOST_REQUIRE_EQUAL(found.size(), 2);
+  BOOST_CHECK_EQUAL(found[0].polygon, 0);
+  BOOST_CHECK_EQUAL(found[1].polygon, 2);
+  BOOST_CHECK_EQUAL(found[0].location.x(), found[1].location.x());
+  BOOST_CHECK_EQUAL(found[0].location.y(), found[1].location.y());
+}
+
+BOOST_AUTO_TEST_CASE(many_slabs) {
+  // Enough edges for several slabs, with a long polygon that reaches
+  // across all of them and crosses the last square.
+  multi_polygon_type_fp mpoly;
+  for (int i = 0; i < 2000; i++) {
+    polygon_type_fp square;
+    bg::read_wkt("POLYGON((0 0,0 1,1 1,1 0,0 0))", square);
+    bg::for_each_point(square, [&](point_type_fp& p) { p.x(p.x() + 2 * i); });
+    mpoly.push_back(square);
+  }
+  polygon_type_fp bar;
+  bg::read_wkt("POLYGON((-1 -1,-1 -0.5,3998.5 -0.5,3998.5 0.5,3999 0.5,3999 -1,-1 -1))", bar);
+  mpoly.push_back(bar);
+  const auto found = self_intersections(mpoly);
+  BOOST_REQUIRE_EQUAL(found.size(), 2);
+  BOOST_CHECK_EQUAL(found[0].polygon, 1999);
+  BOOST_CHECK_EQUAL(found[1].polygon, 2000);
+}
+
+BOOST_AUTO_TEST_SUITE_END()